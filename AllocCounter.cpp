@@ -0,0 +1,209 @@
+/*
+* AllocCounter class
+*
+* counts the heap allocations of the whole program and of named stages of the
+* game loop
+*
+*/
+#include "AllocCounter.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// the counters are zero before any constructor runs, so allocations made during
+// static initialization are counted safely
+static std::atomic<uint64_t> s_count(0);
+static std::atomic<uint64_t> s_bytes(0);
+
+static std::atomic<const char *> s_stageNames[AllocCounter::MAX_STAGES];
+static std::atomic<uint64_t> s_stageCounts[AllocCounter::MAX_STAGES];
+static std::atomic<uint64_t> s_stageBytes[AllocCounter::MAX_STAGES];
+
+/*
+* findStage
+*
+* preconditions:	none
+* postconditions:	returns the slot of stage, claiming a free slot for it when claim is
+*					set. returns -1 if stage has no slot.
+*/
+static int findStage(const char *stage, bool claim) {
+	for(int i = 0; i < AllocCounter::MAX_STAGES; i++) {
+		const char *name = s_stageNames[i].load();
+		if(name == nullptr) {
+			if(!claim) return(-1);
+			if(s_stageNames[i].compare_exchange_strong(name, stage)) return(i);
+			// another thread claimed the slot first, name is now its stage
+		}
+		if(name == stage || strcmp(name, stage) == 0) return(i);
+	}
+	return(-1);
+}
+
+/*
+* enabled
+*
+* preconditions:	none
+* postconditions:	returns true if counting was built in with CVPONG_COUNT_ALLOCS
+*/
+bool AllocCounter::enabled() {
+#ifdef CVPONG_COUNT_ALLOCS
+	return(true);
+#else
+	return(false);
+#endif
+}
+
+/*
+* total
+*
+* preconditions:	none
+* postconditions:	returns the allocations made by every thread since the start of
+*					the program
+*/
+AllocStats AllocCounter::total() {
+	AllocStats stats = {s_count.load(std::memory_order_relaxed), s_bytes.load(std::memory_order_relaxed)};
+	return(stats);
+}
+
+/*
+* record
+*
+* preconditions:	none
+* postconditions:	counts one allocation of bytes. called by the replaced allocators.
+*/
+void AllocCounter::record(size_t bytes) {
+	s_count.fetch_add(1, std::memory_order_relaxed);
+	s_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/*
+* addToStage
+*
+* preconditions:	stage must be a string which outlives the program, a literal
+* postconditions:	adds stats to the allocations counted for stage
+*/
+void AllocCounter::addToStage(const char *stage, const AllocStats &stats) {
+	int slot = findStage(stage, true);
+	if(slot < 0) return;
+	s_stageCounts[slot].fetch_add(stats.count, std::memory_order_relaxed);
+	s_stageBytes[slot].fetch_add(stats.bytes, std::memory_order_relaxed);
+}
+
+/*
+* getStage
+*
+* preconditions:	none
+* postconditions:	returns the allocations counted for stage, zero if it never ran
+*/
+AllocStats AllocCounter::getStage(const char *stage) {
+	AllocStats stats = {0, 0};
+	int slot = findStage(stage, false);
+	if(slot >= 0) {
+		stats.count = s_stageCounts[slot].load(std::memory_order_relaxed);
+		stats.bytes = s_stageBytes[slot].load(std::memory_order_relaxed);
+	}
+	return(stats);
+}
+
+/*
+* resetStages
+*
+* preconditions:	no AllocScope may be open
+* postconditions:	sets the allocations counted for every stage back to zero
+*/
+void AllocCounter::resetStages() {
+	for(int i = 0; i < MAX_STAGES; i++) {
+		s_stageCounts[i] = 0;
+		s_stageBytes[i] = 0;
+	}
+}
+
+/*
+* report
+*
+* preconditions:	none
+* postconditions:	writes the allocations and bytes counted for each stage to out,
+*					one stage per line
+*/
+void AllocCounter::report(ostream &out) {
+	for(int i = 0; i < MAX_STAGES; i++) {
+		const char *name = s_stageNames[i].load();
+		if(name == nullptr) break;
+		out << name << ": " << s_stageCounts[i].load() << " allocations, ";
+		out << s_stageBytes[i].load() << " bytes" << endl;
+	}
+}
+
+#ifdef CVPONG_COUNT_ALLOCS
+#if defined(__GLIBC__)
+// glibc's own allocators, which the replacements below forward to
+extern "C" {
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void *__libc_memalign(size_t alignment, size_t size);
+}
+
+// replacing malloc in the executable also catches operator new and OpenCV's
+// fastMalloc, which both allocate through it
+extern "C" void *malloc(size_t size) {
+	AllocCounter::record(size);
+	return(__libc_malloc(size));
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+	AllocCounter::record(count * size);
+	return(__libc_calloc(count, size));
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+	AllocCounter::record(size);
+	return(__libc_realloc(ptr, size));
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	AllocCounter::record(size);
+	*ptr = __libc_memalign(alignment, size);
+	return(*ptr != nullptr ? 0 : ENOMEM);
+}
+#else
+// without glibc only the allocations of operator new are counted
+void *operator new(size_t size) {
+	AllocCounter::record(size);
+	void *ptr = malloc(size == 0 ? 1 : size);
+	if(ptr == nullptr) throw std::bad_alloc();
+	return(ptr);
+}
+
+void *operator new[](size_t size) {
+	return(operator new(size));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) throw() {
+	AllocCounter::record(size);
+	return(malloc(size == 0 ? 1 : size));
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) throw() {
+	return(operator new(size, tag));
+}
+
+void operator delete(void *ptr) throw() {
+	free(ptr);
+}
+
+void operator delete[](void *ptr) throw() {
+	free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) throw() {
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) throw() {
+	free(ptr);
+}
+#endif
+#endif
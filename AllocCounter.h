@@ -0,0 +1,141 @@
+/*
+* AllocCounter class
+*
+* counts the heap allocations, and the bytes allocated, of the whole program and of
+* named stages of the game loop. Counting is only built in with CVPONG_COUNT_ALLOCS
+* defined, which replaces the global operator new and, with glibc, malloc, calloc and
+* realloc, so the allocations made inside of OpenCV are counted too. Without it the
+* ALLOC_SCOPE macro compiles to nothing and every count stays zero.
+*
+*/
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+#include <iostream>
+#include <stdint.h>
+
+using namespace std;
+
+/*
+* AllocStats
+*
+* a number of heap allocations and the bytes they asked for
+*/
+struct AllocStats {
+	uint64_t count;
+	uint64_t bytes;
+};
+
+class AllocCounter {
+public:
+	// stages beyond this many are counted in the totals only
+	const static int MAX_STAGES = 32;
+
+	/*
+	* enabled
+	*
+	* preconditions:	none
+	* postconditions:	returns true if counting was built in with CVPONG_COUNT_ALLOCS
+	*/
+	static bool enabled();
+
+	/*
+	* total
+	*
+	* preconditions:	none
+	* postconditions:	returns the allocations made by every thread since the start of
+	*					the program
+	*/
+	static AllocStats total();
+
+	/*
+	* record
+	*
+	* preconditions:	none
+	* postconditions:	counts one allocation of bytes. called by the replaced allocators.
+	*/
+	static void record(size_t bytes);
+
+	/*
+	* addToStage
+	*
+	* preconditions:	stage must be a string which outlives the program, a literal
+	* postconditions:	adds stats to the allocations counted for stage
+	*/
+	static void addToStage(const char *stage, const AllocStats &stats);
+
+	/*
+	* getStage
+	*
+	* preconditions:	none
+	* postconditions:	returns the allocations counted for stage, zero if it never ran
+	*/
+	static AllocStats getStage(const char *stage);
+
+	/*
+	* resetStages
+	*
+	* preconditions:	no AllocScope may be open
+	* postconditions:	sets the allocations counted for every stage back to zero
+	*/
+	static void resetStages();
+
+	/*
+	* report
+	*
+	* preconditions:	none
+	* postconditions:	writes the allocations and bytes counted for each stage to out,
+	*					one stage per line
+	*/
+	static void report(ostream &out);
+};
+
+/*
+* AllocScope class
+*
+* counts the allocations made from its construction to its destruction towards a
+* stage. Allocations made by other threads in the meantime, the workers of a
+* parallel_for_ for one, are counted too. Nested scopes count towards every stage
+* they are nested in.
+*
+*/
+class AllocScope {
+public:
+	/*
+	* AllocScope constructor
+	*
+	* preconditions:	stage must be a string which outlives the program, a literal
+	* postconditions:	starts counting towards stage
+	*/
+	explicit AllocScope(const char *stage) : m_stage(stage), m_start(AllocCounter::total()) {}
+
+	/*
+	* AllocScope destructor
+	*
+	* preconditions:	none
+	* postconditions:	adds the allocations made since construction to the stage
+	*/
+	~AllocScope() {
+		AllocStats now = AllocCounter::total();
+		AllocStats made = {now.count - m_start.count, now.bytes - m_start.bytes};
+		AllocCounter::addToStage(m_stage, made);
+	}
+
+private:
+	AllocScope(const AllocScope &);
+	AllocScope &operator=(const AllocScope &);
+
+	const char *m_stage;
+	AllocStats m_start;
+};
+
+#define ALLOC_SCOPE_CONCAT2(a, b) a##b
+#define ALLOC_SCOPE_CONCAT(a, b) ALLOC_SCOPE_CONCAT2(a, b)
+
+#ifdef CVPONG_COUNT_ALLOCS
+// counts the allocations from here to the end of the enclosing block towards stage
+#define ALLOC_SCOPE(stage) AllocScope ALLOC_SCOPE_CONCAT(allocScope, __LINE__)(stage)
+#else
+#define ALLOC_SCOPE(stage)
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "GameBoard.h"
+#include "MotionPaddleDetector.h"
+#include "OpticalFlowPaddleDetector.h"
+#include "HybridPaddleDetector.h"
+#include "AsyncPaddleDetector.h"
+#include "AllocCounter.h"
+using namespace std;
+
+// ticks played before the buffers are expected to have settled
+const int WARMUP_TICKS = 30;
+const int MEASURED_TICKS = 200;
+// frames of the synthetic video, which loops
+const int LOOP_FRAMES = 32;
+const int BLOCK_SIZE = 60;
+// the blocks are green so the color detectors can track them with a made up profile
+const Scalar BLOCK_COLOR(0, 255, 0);
+const string GATE_PROFILE = "allocgate";
+
+/*
+* ToleratedStage
+*
+* a stage which allocates inside of OpenCV on every call, and why. Their
+* allocations are counted and reported but do not fail the gate unless --strict
+* is given.
+*/
+struct ToleratedStage {
+	const char *stage;
+	const char *reason;
+};
+
+const ToleratedStage TOLERATED[] = {
+	{"findContours", "OpenCV 2.4 builds a CvMemStorage for the contours on every call"},
+	{"flow.pyramid", "pyrDown allocates its row buffers on every call"},
+	{"flow.track", "calcOpticalFlowPyrLK copies the levels of both pyramids into vectors of its own"},
+	{"flow.reseed", "goodFeaturesToTrack allocates its eigenvalue image, only when a track was lost"}
+};
+
+/*
+* Inbox
+*
+* the results the detection thread hands back, as the game's loop collects them. A
+* callback capturing only this fits in std::function without allocating.
+*/
+struct Inbox {
+	mutex lock;
+	condition_variable arrived;
+	vector<PaddleResult> results;
+};
+
+/*
+* countAllowed
+*
+* preconditions:	none
+* postconditions:	returns the allocations counted so far in the stages of allowed
+*/
+static uint64_t countAllowed(const vector<const char *> &allowed) {
+	uint64_t count = 0;
+	for(size_t i = 0; i < allowed.size(); i++) {
+		count += AllocCounter::getStage(allowed[i]).count;
+	}
+	return(count);
+}
+
+/*
+* makeFrames
+*
+* preconditions:	none
+* postconditions:	returns a loop of frames with a block moving up and down in each
+*					half, in opposite directions, over a static textured background
+*/
+static vector<Mat> makeFrames() {
+	Mat background(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+	randu(background, Scalar(0, 0, 0), Scalar(64, 64, 64));
+
+	vector<Mat> frames;
+	for(int i = 0; i < LOOP_FRAMES; i++) {
+		double phase = static_cast<double>(i) / LOOP_FRAMES;
+		int travel = DEFAULT_Y - BLOCK_SIZE;
+		int leftY = static_cast<int>(travel * (phase < 0.5 ? phase * 2 : 2 - phase * 2));
+		int rightY = travel - leftY;
+
+		Mat frame = background.clone();
+		rectangle(frame, Rect(DEFAULT_X / 4, leftY, BLOCK_SIZE, BLOCK_SIZE), BLOCK_COLOR, -1);
+		rectangle(frame, Rect(DEFAULT_X * 3 / 4, rightY, BLOCK_SIZE, BLOCK_SIZE), BLOCK_COLOR, -1);
+		frames.push_back(frame);
+	}
+	return(frames);
+}
+
+/*
+* saveGateProfile
+*
+* preconditions:	none
+* postconditions:	saves a color profile under GATE_PROFILE which tracks the green of
+*					the blocks and none of the background
+*/
+static void saveGateProfile() {
+	FileStorage fs(GATE_PROFILE + PROFILE_EXTENSION, FileStorage::WRITE);
+	fs << "lowHue" << 50;
+	fs << "highHue" << 70;
+	fs << "lowSat" << 100;
+	fs << "highSat" << 255;
+	fs << "lowVal" << 100;
+	fs << "highVal" << 255;
+}
+
+/*
+* main
+*
+* plays a game on synthetic frames with no camera and no window, and fails if any
+* tick after the warmup allocates on the heap. Only meaningful in a build with
+* CVPONG_COUNT_ALLOCS defined. The game runs the loop of a camera game: each frame
+* is submitted to an AsyncPaddleDetector, the results its thread calls back with are
+* fed to the board with detect, and the board is advanced and rendered. Each tick
+* waits for its frame's result, as the camera paces a real game. --sync plays the
+* lockstep loop of the bot and shared games instead, processFrame and play on one
+* thread. Allocations are counted on every thread. Ticks on which the score changes
+* render the score text again and are not counted as steady state. Allocations
+* inside of a stage named with --allow, or listed in TOLERATED, are tolerated, so a
+* known allocation does not hide new ones. --strict tolerates only the stages named
+* with --allow. The color detectors track the blocks with a profile the gate saves
+* and removes.
+*
+* usage: allocgate [move|color|hybrid|flow] [--sync] [--strict] [--allow stage]...
+*
+*/
+int main(int argc, char *argv[]) {
+	if(!AllocCounter::enabled()) {
+		cout << "Allocation counting is not built in, rebuild with CVPONG_COUNT_ALLOCS defined." << endl;
+		return(-1);
+	}
+
+	string tracking = MPD_FLAG;
+	bool strict = false;
+	bool sync = false;
+	vector<const char *> allowed;
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--allow") == 0 && i + 1 < argc) {
+			allowed.push_back(argv[++i]);
+		} else if(strcmp(argv[i], "--strict") == 0) {
+			strict = true;
+		} else if(strcmp(argv[i], "--sync") == 0) {
+			sync = true;
+		} else {
+			tracking = argv[i];
+		}
+	}
+
+	if(!strict) {
+		for(size_t i = 0; i < sizeof(TOLERATED) / sizeof(TOLERATED[0]); i++) {
+			cout << "tolerating " << TOLERATED[i].stage << ": " << TOLERATED[i].reason << endl;
+			allowed.push_back(TOLERATED[i].stage);
+		}
+	}
+
+	// the color detectors have no capture to calibrate from, they load the gate's profile
+	VideoCapture noCapture;
+	PaddleDetector *detector;
+	if(tracking == OFPD_FLAG) {
+		detector = new OpticalFlowPaddleDetector();
+	} else if(tracking == CPD_FLAG || tracking == HPD_FLAG) {
+		saveGateProfile();
+		if(tracking == CPD_FLAG) {
+			detector = new ColorPaddleDetector(&noCapture, GATE_PROFILE);
+		} else {
+			detector = new HybridPaddleDetector(&noCapture, GATE_PROFILE);
+		}
+		remove((GATE_PROFILE + PROFILE_EXTENSION).c_str());
+	} else {
+		// no capture, each frame is compared with the frame before it
+		detector = new MotionPaddleDetector();
+	}
+
+	vector<Mat> frames = makeFrames();
+	GameBoard pong;
+	Mat frame;
+	int allocatingTicks = 0;
+	int steadyTicks = 0;
+
+	// the state of the camera game's loop, as in Driver
+	AsyncPaddleDetector *async = sync ? nullptr : new AsyncPaddleDetector(detector);
+	Inbox inbox;
+	vector<PaddleResult> ready;
+	Mat shown;
+	Mat background;
+
+	// each tick is measured from where the last one ended, so nothing the detection
+	// thread allocates between ticks goes unseen
+	AllocStats start = AllocCounter::total();
+	uint64_t allowedBefore = countAllowed(allowed);
+
+	for(int tick = 0; tick < WARMUP_TICKS + MEASURED_TICKS; tick++) {
+		bool measured = tick >= WARMUP_TICKS;
+		if(tick == WARMUP_TICKS) {
+			AllocCounter::resetStages();
+			allowedBefore = 0;
+		}
+		GameState before = pong.getState();
+
+		if(sync) {
+			// the detectors mirror the frame they are given, so each tick works on a copy
+			frames[tick % LOOP_FRAMES].copyTo(frame);
+			{
+				ALLOC_SCOPE("processFrame");
+				detector->processFrame(frame);
+			}
+			{
+				ALLOC_SCOPE("play");
+				pong.play(frame, detector->getLeftPaddleLoc(), detector->getRightPaddleLoc());
+			}
+		} else {
+			{
+				ALLOC_SCOPE("submit");
+				async->submit(frames[tick % LOOP_FRAMES], pong.getTick(), AsyncPaddleDetector::nowUs(),
+							  [&inbox](const PaddleResult &result) {
+					lock_guard<mutex> lock(inbox.lock);
+					inbox.results.push_back(result);
+					inbox.arrived.notify_one();
+				});
+			}
+			{
+				unique_lock<mutex> lock(inbox.lock);
+				while(inbox.results.empty()) {
+					inbox.arrived.wait(lock);
+				}
+				ready.swap(inbox.results);
+			}
+			{
+				ALLOC_SCOPE("detect");
+				for(size_t i = 0; i < ready.size(); i++) {
+					const PaddleResult &result = ready[i];
+					if(result.skipped) continue;
+					if(result.left.found) pong.detect(result.frameId, IS_RED, result.left.pos);
+					if(result.right.found) pong.detect(result.frameId, IS_BLUE, result.right.pos);
+					shown = result.frame;
+				}
+				ready.clear();
+			}
+			{
+				ALLOC_SCOPE("play");
+				if(shown.empty()) {
+					background = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+				} else {
+					shown.copyTo(background);
+				}
+				pong.advance();
+				pong.render(background);
+			}
+		}
+
+		AllocStats end = AllocCounter::total();
+		uint64_t allowedAfter = countAllowed(allowed);
+		uint64_t made = end.count - start.count - (allowedAfter - allowedBefore);
+		start = end;
+		allowedBefore = allowedAfter;
+
+		GameState after = pong.getState();
+		bool scored = before.score[0] != after.score[0] || before.score[1] != after.score[1];
+		if(!measured || scored) continue;
+
+		steadyTicks++;
+		if(made > 0) {
+			if(allocatingTicks == 0) {
+				cout << "tick " << tick << " allocated " << made << " times" << endl;
+			}
+			allocatingTicks++;
+		}
+	}
+
+	cout << "heap allocations per stage after the warmup:" << endl;
+	AllocCounter::report(cout);
+	cout << allocatingTicks << " of " << steadyTicks << " steady-state ticks allocated" << endl;
+
+	// the detection thread is stopped before its detector goes
+	delete async;
+	delete detector;
+	return(allocatingTicks == 0 ? 0 : 1);
+}
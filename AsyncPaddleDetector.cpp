@@ -0,0 +1,251 @@
+/*
+* AsyncPaddleDetector class
+*
+* runs a PaddleDetector on its own thread. Callers submit frames with the time they
+* were captured and get the result back through a future or a callback, so capture,
+* detection and rendering can overlap.
+*
+*/
+#include <chrono>
+#include "AsyncPaddleDetector.h"
+#include "Trace.h"
+
+/*
+* AsyncPaddleDetector constructor
+*
+* preconditions:	detector must process the frames it is given instead of reading
+*					its own from a capture, and must not be used by anything else
+*					while it is wrapped. maxPending must be greater than 0.
+* postconditions:	starts the detection thread. at most maxPending frames wait for
+*					detection, older frames are skipped for newer ones.
+*/
+AsyncPaddleDetector::AsyncPaddleDetector(PaddleDetector *detector, int maxPending) {
+	m_detector = detector;
+	m_maxPending = maxPending;
+	m_jobs.resize(maxPending);
+	m_firstJob = 0;
+	m_jobCount = 0;
+	m_settings = detector->getSettings();
+	m_settingsChanged = false;
+	m_stopping = false;
+	m_worker = std::thread(&AsyncPaddleDetector::run, this);
+}
+
+/*
+* AsyncPaddleDetector destructor
+*
+* preconditions:	none
+* postconditions:	finishes the frame being detected, skips the frames still waiting
+*					and stops the detection thread. detector is not deleted.
+*/
+AsyncPaddleDetector::~AsyncPaddleDetector() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_one();
+	m_worker.join();
+
+	for(; m_jobCount > 0; m_jobCount--) {
+		skip(m_jobs[m_firstJob]);
+		m_firstJob = (m_firstJob + 1) % m_jobs.size();
+	}
+}
+
+/*
+* submit
+*
+* preconditions:	frame must be a BGR frame of video
+* postconditions:	queues a copy of frame for detection and returns the future result
+*/
+std::future<PaddleResult> AsyncPaddleDetector::submit(const Mat &frame, uint64_t frameId, int64_t captureUs) {
+	Job job;
+	copyFrame(frame, job.frame);
+	job.frameId = frameId;
+	job.captureUs = captureUs;
+	job.promise.reset(new std::promise<PaddleResult>());
+	std::future<PaddleResult> result = job.promise->get_future();
+	enqueue(job);
+	return(result);
+}
+
+/*
+* submit
+*
+* preconditions:	frame must be a BGR frame of video. callback must be safe to call
+*					from the detection thread.
+* postconditions:	queues a copy of frame for detection. callback is called with the
+*					result on the detection thread.
+*/
+void AsyncPaddleDetector::submit(const Mat &frame, uint64_t frameId, int64_t captureUs, Callback callback) {
+	Job job;
+	copyFrame(frame, job.frame);
+	job.frameId = frameId;
+	job.captureUs = captureUs;
+	job.callback = callback;
+	enqueue(job);
+}
+
+/*
+* setSettings
+*
+* preconditions:	settings must hold values valid for the detector
+* postconditions:	the detector uses settings from the next frame detected on
+*/
+void AsyncPaddleDetector::setSettings(const DetectorSettings &settings) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_settings = settings;
+	m_settingsChanged = true;
+}
+
+/*
+* nowUs
+*
+* preconditions:	none
+* postconditions:	returns the time on the steady clock in microseconds, the clock
+*					capture times are measured on
+*/
+int64_t AsyncPaddleDetector::nowUs() {
+	return(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/*
+* copyFrame
+*
+* preconditions:	none
+* postconditions:	sets copy to a copy of frame in a frame of the pool nothing else
+*					refers to, adding a frame to the pool if every one is in use
+*/
+void AsyncPaddleDetector::copyFrame(const Mat &frame, Mat &copy) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(size_t i = 0; i < m_pool.size(); i++) {
+			// the results holding a frame may be dropped on any thread, but once the
+			// pool holds the only reference nothing else can take one
+			if(m_pool[i].refcount == nullptr || *m_pool[i].refcount == 1) {
+				m_pool[i].create(frame.size(), frame.type());
+				copy = m_pool[i];
+				break;
+			}
+		}
+		if(copy.empty()) {
+			m_pool.push_back(Mat(frame.size(), frame.type()));
+			copy = m_pool.back();
+		}
+	}
+	frame.copyTo(copy);
+}
+
+/*
+* enqueue
+*
+* preconditions:	none
+* postconditions:	moves job to the back of the queue. if too many frames are waiting
+*					the oldest is skipped, detecting it would only add latency.
+*/
+void AsyncPaddleDetector::enqueue(Job &job) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Job skipped;
+	bool full = m_jobCount == m_jobs.size();
+	if(full) {
+		Job &oldest = m_jobs[m_firstJob];
+		skipped = std::move(oldest);
+		oldest.frame.release();
+		m_firstJob = (m_firstJob + 1) % m_jobs.size();
+		m_jobCount--;
+	}
+	m_jobs[(m_firstJob + m_jobCount) % m_jobs.size()] = std::move(job);
+	job.frame.release();
+	m_jobCount++;
+	lock.unlock();
+	m_wake.notify_one();
+
+	// results are handed out without the lock held, a callback may submit again
+	if(full) {
+		skip(skipped);
+	}
+}
+
+/*
+* run
+*
+* preconditions:	none
+* postconditions:	detects the queued frames in order until the detector is stopped
+*/
+void AsyncPaddleDetector::run() {
+	Trace::setThreadName("detector");
+	while(true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while(m_jobCount == 0 && !m_stopping) {
+				m_wake.wait(lock);
+			}
+			if(m_stopping) return;
+
+			// Mat is copied rather than moved, the ring lets go of the frame by hand so
+			// it goes back to the pool with the job's results
+			Job &first = m_jobs[m_firstJob];
+			job = std::move(first);
+			first.frame.release();
+			m_firstJob = (m_firstJob + 1) % m_jobs.size();
+			m_jobCount--;
+
+			if(m_settingsChanged) {
+				m_detector->setSettings(m_settings);
+				m_settingsChanged = false;
+			}
+		}
+
+		Trace::setFrame(job.frameId);
+		{
+			TRACE_SCOPE("processFrame");
+			m_detector->processFrame(job.frame);
+		}
+
+		PaddleResult result;
+		result.frameId = job.frameId;
+		result.captureUs = job.captureUs;
+		result.latencyUs = nowUs() - job.captureUs;
+		result.left = m_detector->getLeftPaddle();
+		result.right = m_detector->getRightPaddle();
+		result.skipped = false;
+		result.frame = job.frame;
+		complete(job, result);
+	}
+}
+
+/*
+* complete
+*
+* preconditions:	none
+* postconditions:	hands result to the callback of job, or to its future
+*/
+void AsyncPaddleDetector::complete(Job &job, PaddleResult &result) {
+	if(job.callback) {
+		job.callback(result);
+	} else {
+		job.promise->set_value(result);
+	}
+}
+
+/*
+* skip
+*
+* preconditions:	none
+* postconditions:	completes job with a result in which neither paddle was found
+*/
+void AsyncPaddleDetector::skip(Job &job) {
+	PaddleReading lost = {PaddleDetector::DEFAULT_PADDLE_POSITION, 0, false};
+
+	PaddleResult result;
+	result.frameId = job.frameId;
+	result.captureUs = job.captureUs;
+	result.latencyUs = nowUs() - job.captureUs;
+	result.left = lost;
+	result.right = lost;
+	result.skipped = true;
+	result.frame = job.frame;
+	complete(job, result);
+}
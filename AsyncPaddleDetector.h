@@ -0,0 +1,123 @@
+/*
+* AsyncPaddleDetector class
+*
+* runs a PaddleDetector on its own thread. Callers submit frames with the time they
+* were captured and get the result back through a future or a callback, so capture,
+* detection and rendering can overlap. Each result carries the frame id, capture
+* time and latency of the detection and the position, confidence and found state
+* of each paddle, so stale or missing detections can be told apart.
+*
+* Submitted frames are copied into a pool of frames which are reused once every
+* result handed out with them is gone, and the waiting jobs are kept in a ring, so
+* a steady stream of frames submitted with callbacks does not allocate.
+*
+*/
+#ifndef ASYNCPADDLEDETECTOR_H
+#define ASYNCPADDLEDETECTOR_H
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "PaddleDetector.h"
+
+const int DEFAULT_MAX_PENDING = 2;
+
+class AsyncPaddleDetector {
+public:
+	typedef std::function<void(const PaddleResult &)> Callback;
+
+	/*
+	* AsyncPaddleDetector constructor
+	*
+	* preconditions:	detector must process the frames it is given instead of reading
+	*					its own from a capture, and must not be used by anything else
+	*					while it is wrapped. maxPending must be greater than 0.
+	* postconditions:	starts the detection thread. at most maxPending frames wait for
+	*					detection, older frames are skipped for newer ones.
+	*/
+	AsyncPaddleDetector(PaddleDetector *detector, int maxPending = DEFAULT_MAX_PENDING);
+
+	/*
+	* AsyncPaddleDetector destructor
+	*
+	* preconditions:	none
+	* postconditions:	finishes the frame being detected, skips the frames still waiting
+	*					and stops the detection thread. detector is not deleted.
+	*/
+	~AsyncPaddleDetector();
+
+	/*
+	* submit
+	*
+	* preconditions:	frame must be a BGR frame of video
+	* postconditions:	queues a copy of frame for detection and returns the future result
+	*/
+	std::future<PaddleResult> submit(const Mat &frame, uint64_t frameId, int64_t captureUs);
+
+	/*
+	* submit
+	*
+	* preconditions:	frame must be a BGR frame of video. callback must be safe to call
+	*					from the detection thread.
+	* postconditions:	queues a copy of frame for detection. callback is called with the
+	*					result on the detection thread.
+	*/
+	void submit(const Mat &frame, uint64_t frameId, int64_t captureUs, Callback callback);
+
+	/*
+	* setSettings
+	*
+	* preconditions:	settings must hold values valid for the detector
+	* postconditions:	the detector uses settings from the next frame detected on
+	*/
+	void setSettings(const DetectorSettings &settings);
+
+	/*
+	* nowUs
+	*
+	* preconditions:	none
+	* postconditions:	returns the time on the steady clock in microseconds, the clock
+	*					capture times are measured on
+	*/
+	static int64_t nowUs();
+
+private:
+	struct Job {
+		Mat frame;
+		uint64_t frameId;
+		int64_t captureUs;
+		// only a job whose result is returned through a future has a promise
+		std::unique_ptr<std::promise<PaddleResult> > promise;
+		Callback callback;
+	};
+
+	AsyncPaddleDetector(const AsyncPaddleDetector &);
+	AsyncPaddleDetector &operator=(const AsyncPaddleDetector &);
+
+	void copyFrame(const Mat &frame, Mat &copy);
+	void enqueue(Job &job);
+	void run();
+	static void complete(Job &job, PaddleResult &result);
+	static void skip(Job &job);
+
+	PaddleDetector *m_detector;
+	int m_maxPending;
+	// the waiting jobs, m_jobCount of them from m_firstJob on in a ring of m_maxPending
+	std::vector<Job> m_jobs;
+	size_t m_firstJob;
+	size_t m_jobCount;
+	// the frames copied for jobs. a frame is free again once only the pool refers to it
+	std::vector<Mat> m_pool;
+	DetectorSettings m_settings;
+	bool m_settingsChanged;
+	bool m_stopping;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::thread m_worker;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "MotionPaddleDetector.h"
+#include "ColorPaddleDetector.h"
+#include "OpticalFlowPaddleDetector.h"
+#include "RawFrameFile.h"
+using namespace std;
+
+// frames decoded and held in memory at once, each batch is detected over all cores
+const int DEFAULT_BATCH_FRAMES = 512;
+
+/*
+* readFrame
+*
+* preconditions:	raw must be open if the recording is a raw frame file
+* postconditions:	reads the next frame of the recording into frame and returns true, or
+*					returns false at its end. Frames of a raw frame file are views into
+*					its mapping rather than copies, the Y plane of YUV frames when
+*					grayOnly is set; frames decoded by cap are copied so the next read
+*					does not overwrite them.
+*/
+static bool readFrame(VideoCapture &cap, const RawFrameReader *raw, bool grayOnly, uint64_t &next, Mat &frame) {
+	if(raw != nullptr) {
+		if(next >= raw->getFrameCount()) return(false);
+		Mat converted;
+		frame = raw->detectable(next++, grayOnly, converted);
+		return(true);
+	}
+	Mat decoded;
+	if(!cap.read(decoded)) return(false);
+	frame = decoded.clone();
+	return(true);
+}
+
+/*
+* main
+*
+* detects the paddles in every frame of a recorded session as fast as the cores
+* allow, rather than at the speed of the camera, and prints one CSV line per frame.
+* The first three columns are in the same format as the labels read by sweep.
+* A recording ending in RAW_EXTENSION is mapped rather than decoded, so the time
+* taken is the time of detection alone. Detectors which only read a frame take it
+* straight from the mapping.
+*
+* usage: batch <recording> <move|color|flow> [profile] [batch frames]
+*
+*/
+int main(int argc, char *argv[]) {
+	if(argc < 3) {
+		cout << "usage: batch <recording> <move|color|flow> [profile] [batch frames]" << endl;
+		return(-1);
+	}
+
+	string recording = argv[1];
+	string tracking = argv[2];
+	string profile = argc > 3 ? argv[3] : "default";
+	int batchFrames = argc > 4 ? atoi(argv[4]) : DEFAULT_BATCH_FRAMES;
+	if(batchFrames < 1) {
+		batchFrames = DEFAULT_BATCH_FRAMES;
+	}
+
+	VideoCapture cap;
+	RawFrameReader *raw = nullptr;
+	bool opened;
+	if(isRawFrameFile(recording)) {
+		raw = new RawFrameReader(recording);
+		opened = raw->isOpen();
+	} else {
+		opened = cap.open(recording);
+	}
+	if(!opened) {
+		delete raw;
+		cout << "Could not open " << recording << endl;
+		return(-1);
+	}
+
+	// a batch can not stop for calibration, the profile has to be saved already
+	if(tracking == CPD_FLAG && !ifstream((profile + PROFILE_EXTENSION).c_str()).good()) {
+		cout << "No color profile \"" << profile << "\", calibrate it by playing first." << endl;
+		return(-1);
+	}
+
+	PaddleDetector *detector;
+	if(tracking == CPD_FLAG) {
+		detector = new ColorPaddleDetector(&cap, profile);
+	} else if(tracking == OFPD_FLAG) {
+		detector = new OpticalFlowPaddleDetector();
+	} else {
+		// no capture, each frame is compared with the frame before it
+		detector = new MotionPaddleDetector();
+	}
+
+	// detectors which only read the grayscale image are given the Y plane of YUV frames
+	bool grayOnly = detector->readsOnly() && detector->readsGray();
+
+	cout << "frame,leftY,rightY,leftFound,leftConfidence,rightFound,rightConfidence,us" << endl;
+
+	vector<Mat> frames;
+	vector<PaddleResult> results;
+	uint64_t firstFrameId = 0;
+	uint64_t nextRawFrame = 0;
+	Mat carried;
+
+	while(true) {
+		// the last frame of the previous batch is the warmup frame of this one
+		frames.clear();
+		if(!carried.empty()) {
+			frames.push_back(carried);
+		}
+		Mat frame;
+		while(static_cast<int>(frames.size()) < batchFrames && readFrame(cap, raw, grayOnly, nextRawFrame, frame)) {
+			frames.push_back(frame);
+		}
+		int warmup = carried.empty() ? 0 : 1;
+		if(static_cast<int>(frames.size()) <= warmup) break;
+
+		detector->processFrames(frames, results, firstFrameId - warmup);
+		for(size_t i = warmup; i < results.size(); i++) {
+			const PaddleResult &result = results[i];
+			cout << result.frameId << "," << result.left.pos << "," << result.right.pos;
+			cout << "," << (result.left.found ? 1 : 0) << "," << result.left.confidence;
+			cout << "," << (result.right.found ? 1 : 0) << "," << result.right.confidence;
+			cout << "," << result.latencyUs << endl;
+		}
+
+		firstFrameId += frames.size() - warmup;
+		carried = frames.back();
+	}
+
+	// the frames may be views into the mapping, they are released before it
+	frames.clear();
+	carried.release();
+	delete detector;
+	delete raw;
+	return(0);
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "GameBoard.h"
+#include "PaddleDetector.h"
+#include "BitMask.h"
+#include "TileEnergy.h"
+using namespace std;
+
+// each kernel is timed for at least this long at each resolution
+const int DEFAULT_MIN_MS = 300;
+const int MIN_SAMPLES = 5;
+const int MAX_SAMPLES = 2000;
+// a sample repeats a fast kernel until it takes this long, so the timer's
+// resolution does not swamp it
+const double TARGET_SAMPLE_US = 500;
+
+/*
+* Resolution
+*
+* a frame size the kernels are timed at
+*/
+struct Resolution {
+	const char *name;
+	int width;
+	int height;
+};
+
+const Resolution RESOLUTIONS[] = {
+	{"480p", 640, 480},
+	{"720p", 1280, 720},
+	{"1080p", 1920, 1080},
+	{"4K", 3840, 2160},
+};
+
+/*
+* Kernel
+*
+* a building block of the game loop. setup, if set, runs untimed before each run,
+* for kernels which change their input.
+*/
+struct Kernel {
+	string name;
+	int pixels;
+	function<void()> setup;
+	function<void()> run;
+};
+
+/*
+* KernelTiming
+*
+* the time one run of a kernel took, in microseconds
+*/
+struct KernelTiming {
+	double medianUs;
+	double minUs;
+	int samples;
+	int reps;
+};
+
+/*
+* nowUs
+*
+* preconditions:	none
+* postconditions:	returns a monotonic time in microseconds
+*/
+static double nowUs() {
+	return(getTickCount() * 1000000.0 / getTickFrequency());
+}
+
+/*
+* timeKernel
+*
+* preconditions:	minMs must be positive
+* postconditions:	runs kernel for at least minMs and returns the median and fastest
+*					time of a run
+*/
+static KernelTiming timeKernel(const Kernel &kernel, int minMs) {
+	// the first run warms the caches and sizes the outputs, and is not counted
+	if(kernel.setup) kernel.setup();
+	double start = nowUs();
+	kernel.run();
+	double once = std::max(nowUs() - start, 0.01);
+
+	int reps = 1;
+	if(!kernel.setup) {
+		reps = std::max(1, static_cast<int>(TARGET_SAMPLE_US / once));
+	}
+
+	vector<double> samples;
+	double end = nowUs() + minMs * 1000.0;
+	while((nowUs() < end || static_cast<int>(samples.size()) < MIN_SAMPLES) &&
+		  static_cast<int>(samples.size()) < MAX_SAMPLES) {
+		if(kernel.setup) kernel.setup();
+		start = nowUs();
+		for(int i = 0; i < reps; i++) {
+			kernel.run();
+		}
+		samples.push_back((nowUs() - start) / reps);
+	}
+
+	sort(samples.begin(), samples.end());
+	KernelTiming timing;
+	timing.medianUs = samples[samples.size() / 2];
+	timing.minUs = samples[0];
+	timing.samples = static_cast<int>(samples.size());
+	timing.reps = reps;
+	return(timing);
+}
+
+/*
+* main
+*
+* times each image processing and drawing primitive the detectors and the gameboard
+* are built from, at 480p, 720p, 1080p and 4K, and prints the timings as JSON so two
+* builds can be compared primitive by primitive. Kernels can be picked by name.
+*
+* usage: benchmark [min ms per kernel] [kernel]...
+*
+*/
+int main(int argc, char *argv[]) {
+	int minMs = argc > 1 ? atoi(argv[1]) : DEFAULT_MIN_MS;
+	if(minMs < 1) {
+		minMs = DEFAULT_MIN_MS;
+	}
+	vector<string> picked(argv + std::min(argc, 2), argv + argc);
+
+	DetectorSettings settings;
+	Size gaussSize(7, 7);
+	Size blurSize(10, 10);
+	Rect ball(0, 0, BALL_SIZE, BALL_SIZE);
+	Rect paddle(0, 0, PADDLE_X, PADDLE_Y);
+
+	cout << "{" << endl;
+	cout << "  \"minMs\": " << minMs << "," << endl;
+	cout << "  \"threads\": " << getNumThreads() << "," << endl;
+	cout << "  \"results\": [";
+	bool first = true;
+
+	for(size_t r = 0; r < sizeof(RESOLUTIONS) / sizeof(RESOLUTIONS[0]); r++) {
+		const Resolution &res = RESOLUTIONS[r];
+		int pixels = res.width * res.height;
+
+		// a noisy static background with a block in each half which moves between
+		// the two frames, like a player's paddle
+		Mat frame(res.height, res.width, CV_8UC3);
+		randu(frame, Scalar(0, 0, 0), Scalar(32, 32, 32));
+		Mat frame2 = frame.clone();
+		int block = res.height / 8;
+		rectangle(frame, Rect(res.width / 4, res.height / 3, block, block), Scalar(255, 255, 255), -1);
+		rectangle(frame, Rect(res.width * 3 / 4, res.height / 3, block, block), Scalar(255, 255, 255), -1);
+		rectangle(frame2, Rect(res.width / 4, res.height / 2, block, block), Scalar(255, 255, 255), -1);
+		rectangle(frame2, Rect(res.width * 3 / 4, res.height / 2, block, block), Scalar(255, 255, 255), -1);
+
+		Mat flipped, gray, gray2, hsv, diff, thres, blurred, gauss, inRangeMask, contourInput, board;
+		cvtColor(frame, gray, COLOR_BGR2GRAY);
+		cvtColor(frame2, gray2, COLOR_BGR2GRAY);
+		cvtColor(frame, hsv, COLOR_BGR2HSV);
+		absdiff(gray, gray2, diff);
+		threshold(diff, thres, settings.thresholdSensitivity, 255, THRESH_BINARY);
+		board = frame.clone();
+		vector<vector<Point> > contours;
+		vector<Vec4i> hierarchy;
+		TileEnergy tiles;
+		vector<Rect> runs;
+		BitMask mask;
+		mask.fromMat(thres);
+		Rect ballAt = ball + Point(res.width / 2, res.height / 2);
+		Rect paddleAt = paddle + Point(BOARDER_WIDTH * 2, res.height / 2);
+
+		vector<Kernel> kernels;
+		kernels.push_back({"flip", pixels, nullptr, [&]() { flip(frame, flipped, 1); }});
+		kernels.push_back({"bgr2gray", pixels, nullptr, [&]() { cvtColor(frame, gray, COLOR_BGR2GRAY); }});
+		kernels.push_back({"bgr2hsv", pixels, nullptr, [&]() { cvtColor(frame, hsv, COLOR_BGR2HSV); }});
+		kernels.push_back({"absdiff", pixels, nullptr, [&]() { absdiff(gray, gray2, diff); }});
+		kernels.push_back({"threshold", pixels, nullptr, [&]() {
+			threshold(diff, thres, settings.thresholdSensitivity, 255, THRESH_BINARY);
+		}});
+		kernels.push_back({"blur10x10", pixels, nullptr, [&]() { blur(thres, blurred, blurSize); }});
+		kernels.push_back({"gaussian7x7x2", pixels, nullptr, [&]() {
+			GaussianBlur(hsv, gauss, gaussSize, settings.gaussSigma, settings.gaussSigma);
+			GaussianBlur(gauss, gauss, gaussSize, settings.gaussSigma, settings.gaussSigma);
+		}});
+		kernels.push_back({"inRange", pixels, nullptr, [&]() {
+			inRange(hsv, Scalar(0, 0, 200), Scalar(180, 60, 255), inRangeMask);
+		}});
+		// findContours changes its input, so it is given a fresh copy before each run
+		kernels.push_back({"findContours", pixels, [&]() { thres.copyTo(contourInput); }, [&]() {
+			findContours(contourInput, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+		}});
+		kernels.push_back({"moments", pixels, nullptr, [&]() { moments(thres, true); }});
+		kernels.push_back({"tileEnergy", pixels, nullptr, [&]() {
+			tiles.compute(gray, gray2, diff);
+			tiles.getActiveRuns(settings.thresholdSensitivity, runs);
+		}});
+		kernels.push_back({"bitMaskOpen", pixels, nullptr, [&]() { mask.open(1); }});
+		kernels.push_back({"fillBall", ball.area(), nullptr, [&]() {
+			GameBoard::fillRect(board, ballAt, BALL_COLOR);
+		}});
+		kernels.push_back({"fillPaddle", paddle.area(), nullptr, [&]() {
+			GameBoard::fillRect(board, paddleAt, L_PADDLE_COLOR);
+		}});
+
+		for(size_t k = 0; k < kernels.size(); k++) {
+			const Kernel &kernel = kernels[k];
+			if(!picked.empty() && find(picked.begin(), picked.end(), kernel.name) == picked.end()) continue;
+
+			KernelTiming timing = timeKernel(kernel, minMs);
+			cout << (first ? "" : ",") << endl;
+			cout << "    {\"kernel\": \"" << kernel.name << "\", \"resolution\": \"" << res.name << "\"";
+			cout << ", \"width\": " << res.width << ", \"height\": " << res.height;
+			cout << ", \"pixels\": " << kernel.pixels;
+			cout << ", \"medianUs\": " << timing.medianUs << ", \"minUs\": " << timing.minUs;
+			cout << ", \"mpixPerSec\": " << kernel.pixels / timing.medianUs;
+			cout << ", \"samples\": " << timing.samples << ", \"reps\": " << timing.reps << "}";
+			first = false;
+		}
+	}
+
+	cout << endl << "  ]" << endl;
+	cout << "}" << endl;
+	return(0);
+}
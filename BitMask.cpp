@@ -0,0 +1,319 @@
+/*
+* BitMask class
+*
+* a binary mask stored as one bit per pixel in 64-bit words, eight times smaller
+* than an 8-bit Mat mask. Erosion, dilation, opening and closing with a square
+* structuring element work on whole words at a time, and the area and first order
+* moments are counted with popcount.
+*
+*/
+#include <algorithm>
+#include <cstring>
+#include "BitMask.h"
+#include "ZoneMoments.h"
+#ifdef CVPONG_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+static const uint64 ALL_SET = ~static_cast<uint64>(0);
+
+// the bits of a word whose index (0 - 63) has bit b set, used to sum the indices of
+// the set bits of a word with six popcounts
+static const uint64 INDEX_BITS[6] = {
+	0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+	0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+};
+
+// the eight 8-bit pixels of every byte of a mask
+struct BytePixels {
+	uint64 pixels[256];
+
+	BytePixels() {
+		for(int b = 0; b < 256; b++) {
+			pixels[b] = 0;
+			for(int i = 0; i < 8; i++) {
+				if(b & (1 << i)) pixels[b] |= static_cast<uint64>(0xFF) << (i * 8);
+			}
+		}
+	}
+};
+
+/*
+* create
+*
+* preconditions:	rows and cols must not be negative
+* postconditions:	resizes the mask to rows by cols and clears every pixel
+*/
+void BitMask::create(int rows, int cols) {
+	m_rows = rows;
+	m_cols = cols;
+	m_wordsPerRow = (cols + 63) / 64;
+	m_bits.assign(static_cast<size_t>(rows) * m_wordsPerRow, 0);
+}
+
+/*
+* fromMat
+*
+* preconditions:	mask must be a single channel 8-bit image
+* postconditions:	resizes the mask to mask and sets every pixel which is not 0 in mask
+*/
+void BitMask::fromMat(const Mat &mask) {
+	create(mask.rows, mask.cols);
+
+	for(int y = 0; y < m_rows; y++) {
+		const uchar *src = mask.ptr<uchar>(y);
+		uint64 *dst = ptr(y);
+		int x = 0;
+
+#ifdef CVPONG_SSE2
+		// pmovmskb packs the comparison of 16 pixels with 0 into 16 bits
+		const __m128i zero = _mm_setzero_si128();
+		for(; x + 16 <= m_cols; x += 16) {
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+			uint64 bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, zero)) & 0xFFFF;
+			dst[x >> 6] |= bits << (x & 63);
+		}
+#endif
+
+		for(; x < m_cols; x++) {
+			if(src[x] != 0) {
+				dst[x >> 6] |= static_cast<uint64>(1) << (x & 63);
+			}
+		}
+	}
+}
+
+/*
+* toMat
+*
+* preconditions:	none
+* postconditions:	returns the mask in dest as a single channel 8-bit image which is
+*					255 where the mask is set and 0 elsewhere
+*/
+void BitMask::toMat(Mat &dest) const {
+	static const BytePixels bytePixels;
+
+	dest.create(m_rows, m_cols, CV_8UC1);
+	for(int y = 0; y < m_rows; y++) {
+		const uint64 *src = ptr(y);
+		uchar *dst = dest.ptr<uchar>(y);
+		int x = 0;
+
+		for(; x + 8 <= m_cols; x += 8) {
+			uint64 pixels = bytePixels.pixels[(src[x >> 6] >> (x & 63)) & 0xFF];
+			memcpy(dst + x, &pixels, 8);
+		}
+		for(; x < m_cols; x++) {
+			dst[x] = (src[x >> 6] >> (x & 63)) & 1 ? 255 : 0;
+		}
+	}
+}
+
+/*
+* erode
+*
+* preconditions:	radius must not be negative
+* postconditions:	erodes the mask with a square of (2 * radius + 1) pixels. pixels
+*					outside of the mask count as set, as they do for erode().
+*/
+void BitMask::erode(int radius) {
+	morph(radius, true);
+}
+
+/*
+* dilate
+*
+* preconditions:	radius must not be negative
+* postconditions:	dilates the mask with a square of (2 * radius + 1) pixels
+*/
+void BitMask::dilate(int radius) {
+	morph(radius, false);
+}
+
+/*
+* morph
+*
+* the square is separable, so the rows are eroded or dilated and then the columns.
+* Each direction grows a reach of c pixels by s with a single shift by s either way,
+* which leaves no gaps while s is at most 2c + 1, so a radius takes log2(radius)
+* passes instead of radius passes.
+*
+* preconditions:	radius must not be negative
+* postconditions:	erodes the mask if isErode is true, otherwise dilates it
+*/
+void BitMask::morph(int radius, bool isErode) {
+	if(radius <= 0 || m_bits.empty()) return;
+
+	// the unused bits at the end of each row count as outside of the mask
+	setPadding(isErode);
+	for(int reach = 0; reach < radius; ) {
+		int shift = std::min(2 * reach + 1, radius - reach);
+		shiftCols(shift, isErode);
+		reach += shift;
+	}
+	setPadding(false);
+
+	for(int reach = 0; reach < radius; ) {
+		int shift = std::min(2 * reach + 1, radius - reach);
+		shiftRows(shift, isErode);
+		reach += shift;
+	}
+}
+
+/*
+* shiftCols
+*
+* preconditions:	shift must be greater than 0
+* postconditions:	combines every pixel with the pixels shift columns to either side
+*					of it, with AND if isErode is true, otherwise with OR
+*/
+void BitMask::shiftCols(int shift, bool isErode) {
+	uint64 fill = isErode ? ALL_SET : 0;
+	int words = m_wordsPerRow;
+	int q = shift >> 6;
+	int r = shift & 63;
+	m_scratch.resize(words);
+
+	for(int y = 0; y < m_rows; y++) {
+		uint64 *row = ptr(y);
+		const uint64 *src = &m_scratch[0];
+		std::copy(row, row + words, m_scratch.begin());
+
+		// word j of the row, or the fill outside of it
+		auto word = [&](int j) {return(j < 0 || j >= words ? fill : src[j]);};
+
+		for(int k = 0; k < words; k++) {
+			uint64 fromLeft, fromRight;
+			if(r == 0) {
+				fromLeft = word(k - q);
+				fromRight = word(k + q);
+			} else {
+				fromLeft = (word(k - q) << r) | (word(k - q - 1) >> (64 - r));
+				fromRight = (word(k + q) >> r) | (word(k + q + 1) << (64 - r));
+			}
+
+			row[k] = isErode ? src[k] & fromLeft & fromRight : src[k] | fromLeft | fromRight;
+		}
+	}
+}
+
+/*
+* shiftRows
+*
+* preconditions:	shift must be greater than 0
+* postconditions:	combines every pixel with the pixels shift rows above and below it,
+*					with AND if isErode is true, otherwise with OR
+*/
+void BitMask::shiftRows(int shift, bool isErode) {
+	m_scratch = m_bits;
+	int words = m_wordsPerRow;
+
+	for(int y = 0; y < m_rows; y++) {
+		uint64 *row = ptr(y);
+		const uint64 *src = &m_scratch[static_cast<size_t>(y) * words];
+		const uint64 *above = y - shift >= 0 ? src - static_cast<size_t>(shift) * words : nullptr;
+		const uint64 *below = y + shift < m_rows ? src + static_cast<size_t>(shift) * words : nullptr;
+
+		for(int k = 0; k < words; k++) {
+			if(isErode) {
+				row[k] = src[k] & (above ? above[k] : ALL_SET) & (below ? below[k] : ALL_SET);
+			} else {
+				row[k] = src[k] | (above ? above[k] : 0) | (below ? below[k] : 0);
+			}
+		}
+	}
+}
+
+/*
+* setPadding
+*
+* preconditions:	none
+* postconditions:	sets or clears the bits after the last column of every row
+*/
+void BitMask::setPadding(bool value) {
+	int used = m_cols & 63;
+	if(used == 0) return;
+
+	uint64 padding = ALL_SET << used;
+	for(int y = 0; y < m_rows; y++) {
+		uint64 &last = ptr(y)[m_wordsPerRow - 1];
+		last = value ? last | padding : last & ~padding;
+	}
+}
+
+/*
+* area
+*
+* preconditions:	none
+* postconditions:	returns the number of pixels set
+*/
+uint64 BitMask::area() const {
+	uint64 count = 0;
+	for(size_t i = 0; i < m_bits.size(); i++) {
+		count += popcount(m_bits[i]);
+	}
+	return(count);
+}
+
+/*
+* sumRow
+*
+* the sum of the indices of the set bits of a word is built from six popcounts, one
+* for each bit of the index: sum(i) = sum over b of 2^b * popcount(word & INDEX_BITS[b])
+*
+* preconditions:	x and width must lie within the columns of the mask and y must be
+*					a row of the mask
+* postconditions:	returns the number of pixels set in the width pixels of row y from
+*					x on in count, and the sum of their offsets from x in sumX
+*/
+void BitMask::sumRow(int y, int x, int width, uint64 &count, uint64 &sumX) const {
+	count = 0;
+	sumX = 0;
+	if(width <= 0) return;
+
+	const uint64 *row = ptr(y);
+	int end = x + width;
+	int64 offsets = 0;
+
+	for(int k = x >> 6; k <= (end - 1) >> 6; k++) {
+		uint64 word = row[k];
+		int start = k * 64;
+
+		// keep only the bits from x to end
+		if(x > start) word &= ALL_SET << (x - start);
+		if(end < start + 64) word &= ~(ALL_SET << (end - start));
+		if(word == 0) continue;
+
+		int bits = popcount(word);
+		uint64 indices = 0;
+		for(int b = 0; b < 6; b++) {
+			indices += static_cast<uint64>(popcount(word & INDEX_BITS[b])) << b;
+		}
+
+		count += bits;
+		offsets += static_cast<int64>(indices) + static_cast<int64>(start - x) * bits;
+	}
+	sumX = static_cast<uint64>(offsets);
+}
+
+/*
+* popcount
+*
+* preconditions:	none
+* postconditions:	returns the number of bits set in word
+*/
+int BitMask::popcount(uint64 word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return(static_cast<int>(__popcnt64(word)));
+#elif defined(__GNUC__)
+	return(__builtin_popcountll(word));
+#else
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return(static_cast<int>((word * 0x0101010101010101ULL) >> 56));
+#endif
+}
@@ -0,0 +1,136 @@
+/*
+* BitMask class
+*
+* a binary mask stored as one bit per pixel in 64-bit words, eight times smaller
+* than an 8-bit Mat mask. Erosion, dilation, opening and closing with a square
+* structuring element work on whole words at a time, and the area and first order
+* moments are counted with popcount.
+*
+*/
+#ifndef BITMASK_H
+#define BITMASK_H
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+class BitMask {
+public:
+	/*
+	* BitMask default constructor
+	*
+	* preconditions:	none
+	* postconditions:	creates an empty mask
+	*/
+	BitMask() : m_rows(0), m_cols(0), m_wordsPerRow(0) {}
+
+	/*
+	* create
+	*
+	* preconditions:	rows and cols must not be negative
+	* postconditions:	resizes the mask to rows by cols and clears every pixel
+	*/
+	void create(int rows, int cols);
+
+	int rows() const {return(m_rows);}
+	int cols() const {return(m_cols);}
+	int wordsPerRow() const {return(m_wordsPerRow);}
+
+	/*
+	* ptr
+	*
+	* preconditions:	y must be a row of the mask
+	* postconditions:	returns the words of row y. pixel x is bit x % 64 of word x / 64.
+	*/
+	uint64 *ptr(int y) {return(&m_bits[static_cast<size_t>(y) * m_wordsPerRow]);}
+	const uint64 *ptr(int y) const {return(&m_bits[static_cast<size_t>(y) * m_wordsPerRow]);}
+
+	/*
+	* fromMat
+	*
+	* preconditions:	mask must be a single channel 8-bit image
+	* postconditions:	resizes the mask to mask and sets every pixel which is not 0 in mask
+	*/
+	void fromMat(const Mat &mask);
+
+	/*
+	* toMat
+	*
+	* preconditions:	none
+	* postconditions:	returns the mask in dest as a single channel 8-bit image which is
+	*					255 where the mask is set and 0 elsewhere
+	*/
+	void toMat(Mat &dest) const;
+
+	/*
+	* erode
+	*
+	* preconditions:	radius must not be negative
+	* postconditions:	erodes the mask with a square of (2 * radius + 1) pixels. pixels
+	*					outside of the mask count as set, as they do for erode().
+	*/
+	void erode(int radius);
+
+	/*
+	* dilate
+	*
+	* preconditions:	radius must not be negative
+	* postconditions:	dilates the mask with a square of (2 * radius + 1) pixels
+	*/
+	void dilate(int radius);
+
+	/*
+	* open
+	*
+	* preconditions:	radius must not be negative
+	* postconditions:	removes objects smaller than the square of (2 * radius + 1) pixels
+	*/
+	void open(int radius) {erode(radius); dilate(radius);}
+
+	/*
+	* close
+	*
+	* preconditions:	radius must not be negative
+	* postconditions:	fills holes smaller than the square of (2 * radius + 1) pixels
+	*/
+	void close(int radius) {dilate(radius); erode(radius);}
+
+	/*
+	* area
+	*
+	* preconditions:	none
+	* postconditions:	returns the number of pixels set
+	*/
+	uint64 area() const;
+
+	/*
+	* sumRow
+	*
+	* preconditions:	x and width must lie within the columns of the mask and y must be
+	*					a row of the mask
+	* postconditions:	returns the number of pixels set in the width pixels of row y from
+	*					x on in count, and the sum of their offsets from x in sumX
+	*/
+	void sumRow(int y, int x, int width, uint64 &count, uint64 &sumX) const;
+
+	/*
+	* popcount
+	*
+	* preconditions:	none
+	* postconditions:	returns the number of bits set in word
+	*/
+	static int popcount(uint64 word);
+
+private:
+	void morph(int radius, bool isErode);
+	void shiftRows(int shift, bool isErode);
+	void shiftCols(int shift, bool isErode);
+	void setPadding(bool value);
+
+	int m_rows;
+	int m_cols;
+	int m_wordsPerRow;
+	vector<uint64> m_bits;
+	vector<uint64> m_scratch;
+};
+
+#endif
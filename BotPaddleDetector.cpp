@@ -0,0 +1,135 @@
+/*
+* BotPaddleDetector class
+*
+* a detector with no camera which plays both paddles itself from the state of
+* the game
+*
+*/
+#include <algorithm>
+#include <cmath>
+#include "BotPaddleDetector.h"
+
+/*
+* BotPaddleDetector constructor
+*
+* preconditions:	board must outlive the detector
+* postconditions:	plays both paddles of board as a player of settings
+*/
+BotPaddleDetector::BotPaddleDetector(const GameBoard *board, const BotSettings &settings)
+	: PaddleDetector(), m_board(board), m_botSettings(settings), m_rng(settings.seed) {
+	m_botSettings.skill = std::min(std::max(m_botSettings.skill, 0.0), 1.0);
+	m_botSettings.delayFrames = std::max(m_botSettings.delayFrames, 0);
+
+	for(int side = 0; side < 2; side++) {
+		m_aimError[side] = 0;
+		m_approaching[side] = false;
+		m_paddleY[side] = (DEFAULT_Y / 2) - (PADDLE_Y / 2);
+		setPaddle(side == 1, static_cast<int>(m_paddleY[side]), 1.0);
+	}
+}
+
+/*
+* processFrame
+*
+* preconditions:	frame must be the background of the gameboard, or empty for the
+*					default board size. frame is not changed.
+* postconditions:	moves the left and right paddles towards where the ball will
+*					reach them, as seen delayFrames ago
+*/
+void BotPaddleDetector::processFrame(Mat& frame) {
+	int height = frame.empty() ? DEFAULT_Y : frame.rows;
+
+	// the bot reacts to the game as it was delayFrames ago
+	m_seen.push_back(m_board->getState());
+	while(static_cast<int>(m_seen.size()) > m_botSettings.delayFrames + 1) {
+		m_seen.pop_front();
+	}
+	const GameState &state = m_seen.front();
+
+	playPaddle(state, height, false);
+	playPaddle(state, height, true);
+}
+
+/*
+* clone
+*
+* preconditions:	none
+* postconditions:	returns a new bot playing the same board with the same settings
+*					which has seen no frames
+*/
+PaddleDetector *BotPaddleDetector::clone() const {
+	BotPaddleDetector *copy = new BotPaddleDetector(m_board, m_botSettings);
+	copy->setSettings(m_settings);
+	return(copy);
+}
+
+/*
+* predictBallY
+*
+* the ball moves in a straight line between bounces, so its height when it reaches
+* x is found by moving it there in one step and folding the height back into the
+* board at the top and bottom walls.
+*
+* preconditions:	height must be greater than BALL_SIZE
+* postconditions:	returns the top of the ball when it reaches the column x moving
+*					from state, bouncing off the top and bottom of a board height pixels
+*					high, or the ball's current top if it is moving away from x
+*/
+int BotPaddleDetector::predictBallY(const GameState &state, int x, int height) {
+	if(state.ballXmov == 0) {
+		return(state.ballY);
+	}
+	double frames = static_cast<double>(x - state.ballX) / state.ballXmov;
+	if(frames < 0) {
+		return(state.ballY);
+	}
+
+	// the ball bounces when its top reaches 0 or its bottom the last row
+	double range = height - 1 - BALL_SIZE;
+	if(range <= 0) {
+		return(0);
+	}
+	double y = fmod(state.ballY + state.ballYmov * frames, 2 * range);
+	if(y < 0) {
+		y += 2 * range;
+	}
+	if(y > range) {
+		y = 2 * range - y;
+	}
+	return(cvRound(y));
+}
+
+/*
+* playPaddle
+*
+* preconditions:	state must be the game as the bot sees it
+* postconditions:	moves the paddle indicated by isRight towards where it should be
+*/
+void BotPaddleDetector::playPaddle(const GameState &state, int height, bool isRight) {
+	int side = isRight ? 1 : 0;
+
+	// the column the ball's leading edge reaches the paddle's face at
+	int x = isRight ? DEFAULT_X - PADDLE_X - (BOARDER_WIDTH * 2) - 1 - BALL_SIZE : (BOARDER_WIDTH * 2) + PADDLE_X;
+	bool approaching = isRight ? state.ballXmov > 0 : state.ballXmov < 0;
+
+	// a new aim for each rally, the worse the player the further off
+	if(approaching && !m_approaching[side]) {
+		m_aimError[side] = m_rng.uniform(-1.0, 1.0) * (1.0 - m_botSettings.skill) * MAX_AIM_ERROR;
+	}
+	m_approaching[side] = approaching;
+
+	// meet the ball with the middle of the paddle, or wait in the middle of the board
+	double target = (height / 2) - (PADDLE_Y / 2);
+	if(approaching) {
+		target = predictBallY(state, x, height) + (BALL_SIZE / 2) - (PADDLE_Y / 2) + m_aimError[side];
+	}
+
+	double speed = MIN_SPEED + m_botSettings.skill * (MAX_SPEED - MIN_SPEED);
+	m_paddleY[side] += std::min(std::max(target - m_paddleY[side], -speed), speed);
+
+	double y = m_paddleY[side];
+	if(m_botSettings.jitter > 0) {
+		y += m_rng.gaussian(m_botSettings.jitter);
+	}
+	setPaddle(isRight, cvRound(y), 1.0);
+}
@@ -0,0 +1,122 @@
+/*
+* BotPaddleDetector class
+*
+* a detector with no camera which plays both paddles itself. Each frame it reads
+* the state of the game, works out where the ball will cross each paddle's line in
+* closed form, folding the path at the top and bottom walls, and moves the paddles
+* towards it like a player of a given skill: seeing the game late, aiming off and
+* not holding their hand quite still. It lets the whole game loop run as fast as
+* the machine allows, for as long as needed, with nobody in front of a camera.
+*
+*/
+#ifndef BOTPADDLEDETECTOR_H
+#define BOTPADDLEDETECTOR_H
+#include <deque>
+#include "PaddleDetector.h"
+#include "GameBoard.h"
+
+const string BPD_FLAG = "bot";
+
+/*
+* BotSettings
+*
+* how well the bot plays
+*/
+struct BotSettings {
+	/*
+	* BotSettings default constructor
+	*
+	* preconditions:	none
+	* postconditions:	sets a good player who reacts in two frames
+	*/
+	BotSettings() : skill(0.8), delayFrames(2), jitter(2.0), seed(0) {}
+
+	double skill;			// 0 - 1: how close the aim is and how fast the paddle moves
+	int delayFrames;		// frames the bot sees the game late by
+	double jitter;			// standard deviation of the shake of the paddle, in pixels
+	uint64_t seed;			// seed of the aim errors and jitter, so runs can be repeated
+};
+
+class BotPaddleDetector : public PaddleDetector {
+	// how far the paddle moves in a frame at full skill, and at no skill
+	static const int MAX_SPEED = 40;
+	static const int MIN_SPEED = 8;
+	// how far the aim can be off at no skill
+	static const int MAX_AIM_ERROR = PADDLE_Y;
+
+public:
+	/*
+	* BotPaddleDetector constructor
+	*
+	* preconditions:	board must outlive the detector
+	* postconditions:	plays both paddles of board as a player of settings
+	*/
+	BotPaddleDetector(const GameBoard *board, const BotSettings &settings = BotSettings());
+
+	/*
+	* BotPaddleDetector destructor
+	*
+	* preconditions:	none
+	* postconditions:	none
+	*/
+	~BotPaddleDetector() {}
+
+	/*
+	* processFrame
+	*
+	* preconditions:	frame must be the background of the gameboard, or empty for the
+	*					default board size. frame is not changed.
+	* postconditions:	moves the left and right paddles towards where the ball will
+	*					reach them, as seen delayFrames ago
+	*/
+	virtual void processFrame(Mat& frame);
+
+	/*
+	* clone
+	*
+	* preconditions:	none
+	* postconditions:	returns a new bot playing the same board with the same settings
+	*					which has seen no frames
+	*/
+	virtual PaddleDetector *clone() const;
+
+	/*
+	* predictBallY
+	*
+	* preconditions:	height must be greater than BALL_SIZE
+	* postconditions:	returns the top of the ball when it reaches the column x moving
+	*					from state, bouncing off the top and bottom of a board height pixels
+	*					high, or the ball's current top if it is moving away from x
+	*/
+	static int predictBallY(const GameState &state, int x, int height);
+
+private:
+	/*
+	* playPaddle
+	*
+	* preconditions:	state must be the game as the bot sees it
+	* postconditions:	moves the paddle indicated by isRight towards where it should be
+	*/
+	void playPaddle(const GameState &state, int height, bool isRight);
+
+	/*
+	* detectMotion
+	*
+	* the bot reads the game instead of detecting motion, there is nothing to do here
+	*/
+	void detectMotion(Mat &, Mat &, bool) {}
+
+	const GameBoard *m_board;
+	BotSettings m_botSettings;
+	RNG m_rng;
+
+	// the states of the game seen over the last delayFrames frames, oldest first
+	deque<GameState> m_seen;
+
+	// the aim error of each paddle, drawn again whenever the ball turns towards it
+	double m_aimError[2];
+	bool m_approaching[2];
+	double m_paddleY[2];
+};
+
+#endif
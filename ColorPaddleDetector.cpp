@@ -6,7 +6,14 @@
 * is tracked seperately in the left and right halves of the video frame.
 *
 */
+#include <algorithm>
+#include <fstream>
 #include "ColorPaddleDetector.h"
+#include "AllocCounter.h"
+#include "Trace.h"
+
+// passed by reference to std::max, so it needs a definition
+const int ColorPaddleDetector::MIN_STRIP_ROWS;
 
 /*
 * ColorPaddleDetector VideoCapture constructor
@@ -25,6 +32,42 @@ ColorPaddleDetector::ColorPaddleDetector(VideoCapture *vid)
 	configure();
 }
 
+/*
+* ColorPaddleDetector profile constructor
+*
+* preconditions:	vid must be a valid VideoCapture object point not equal to
+*					nullptr
+* postconditions:	sets the left and right paddles equal to the default position,
+*					sets this->vid equal to vid, and loads the tracking color from
+*					the profile saved under profile. If there is no such profile, or
+*					mode asks for it, the color is calibrated and saved under profile.
+*					A calibration which sampled nothing is not saved.
+*/
+ColorPaddleDetector::ColorPaddleDetector(VideoCapture *vid, const string &profile, ProfileMode mode)
+{
+	m_leftPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_rightPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_vid = vid;
+	if (mode == LOAD_PROFILE && loadProfile(profile)) return;
+
+	bool configured;
+	if (mode == CONFIGURE_PROFILE)
+	{
+		configure();
+		configured = true;
+	}
+	else
+	{
+		configured = autoConfigure();
+	}
+
+	// saving an empty range would track nothing on every later launch
+	if (configured)
+	{
+		saveProfile(profile);
+	}
+}
+
 /*
 * ColorPaddleDetector destructor
 *
@@ -40,7 +83,8 @@ ColorPaddleDetector::~ColorPaddleDetector() {}
 *
 * preconditions:	none
 * postconditions:	sets the values of lowHue, highHue, lowSat, highSat, lowVal, highVal
-*					according to the input from the scroll bars in the configuration window
+*					according to the input from the scroll bars in the configuration window.
+*					a low hue above the high hue is a range which wraps around red.
 */
 void ColorPaddleDetector::configure()
 {
@@ -73,6 +117,187 @@ void ColorPaddleDetector::configure()
 	cvDestroyAllWindows();
 }
 
+/*
+* autoConfigure
+*
+* launches a calibration window with a box marked in the middle of the frame. The
+* player holds the object to be tracked in the box and the color is configured from
+* the histograms of the pixels sampled in the box.
+*
+* preconditions:	m_vid must be a valid VideoCapture object
+* postconditions:	sets the values of lowHue, highHue, lowSat, highSat, lowVal, highVal
+*					to the range covering most of the pixels sampled in the box and
+*					returns true, or returns false if no pixels could be sampled. The
+*					hue range wraps, with lowHue above highHue, for red objects.
+*/
+bool ColorPaddleDetector::autoConfigure()
+{
+	Mat frame, HSV;
+
+	// histograms of the hue, saturation and value of every pixel sampled
+	int hist[3][256] = {};
+	int samples = 0;
+
+	namedWindow("Calibrate", CV_WINDOW_AUTOSIZE);
+	int64 start = getTickCount();
+	while (true)
+	{
+		*m_vid >> frame;
+		flip(frame, frame, 1);
+
+		double elapsed = (getTickCount() - start) * 1000.0 / getTickFrequency();
+		if (elapsed > CALIBRATION_READY_MS + CALIBRATION_MS) break;
+
+		Rect box((frame.cols - CALIBRATION_BOX) / 2, (frame.rows - CALIBRATION_BOX) / 2,
+				 CALIBRATION_BOX, CALIBRATION_BOX);
+		bool sampling = elapsed > CALIBRATION_READY_MS;
+
+		if (sampling)
+		{
+			// sample the box with the same preprocessing used for tracking
+			Size gaussSize(m_settings.gaussSize, m_settings.gaussSize);
+			cvtColor(Mat(frame, box), HSV, COLOR_BGR2HSV);
+			for (int pass = 0; pass < m_settings.gaussPasses; pass++)
+			{
+				GaussianBlur(HSV, HSV, gaussSize, m_settings.gaussSigma, m_settings.gaussSigma);
+			}
+
+			for (int i = 0; i < HSV.rows; i++)
+			{
+				for (int j = 0; j < HSV.cols; j++)
+				{
+					Vec3b pixel = HSV.at<Vec3b>(i, j);
+					hist[0][pixel[0]]++;
+					hist[1][pixel[1]]++;
+					hist[2][pixel[2]]++;
+				}
+			}
+			samples += HSV.rows * HSV.cols;
+		}
+
+		// yellow box while the player gets ready, green while sampling
+		Scalar boxColor = sampling ? Scalar(0, 255, 0) : Scalar(0, 255, 255);
+		rectangle(frame, box, boxColor, 2);
+		putText(frame, "Hold your object in the box", Point(box.x - 100, box.y - 15),
+				FONT_HERSHEY_COMPLEX_SMALL, 1, boxColor, 1, CV_AA);
+
+		imshow("Calibrate", frame);
+		waitKey(1);
+	}
+	destroyWindow("Calibrate");
+
+	if (samples == 0) return false;
+
+	// take the range between the low and high percentiles of each channel so a
+	// few stray background pixels in the box do not widen the range
+	int low[3];
+	int high[3];
+	for (int c = 0; c < 3; c++)
+	{
+		percentileRange(hist[c], 256, samples, low[c], high[c]);
+	}
+
+	// the hues of a red object sit either side of 0, so their percentiles would span
+	// nearly every hue. The range of the hues turned half way round is taken too,
+	// and if it is narrower the range wraps around red instead.
+	int turned[HUE_RANGE];
+	for (int bin = 0; bin < HUE_RANGE; bin++)
+	{
+		turned[(bin + HUE_RANGE / 2) % HUE_RANGE] = hist[0][bin];
+	}
+	int turnedLow, turnedHigh;
+	percentileRange(turned, HUE_RANGE, samples, turnedLow, turnedHigh);
+	if (turnedHigh - turnedLow < high[0] - low[0])
+	{
+		low[0] = (turnedLow + HUE_RANGE / 2) % HUE_RANGE;
+		high[0] = (turnedHigh + HUE_RANGE / 2) % HUE_RANGE;
+	}
+
+	// widen the range by a margin for changes in lighting while playing
+	int hueWidth = (high[0] - low[0] + HUE_RANGE) % HUE_RANGE;
+	if (hueWidth + 2 * HUE_MARGIN >= HUE_RANGE - 1)
+	{
+		m_lowHue = 0;
+		m_highHue = HUE_RANGE - 1;
+	}
+	else
+	{
+		m_lowHue = (low[0] - HUE_MARGIN + HUE_RANGE) % HUE_RANGE;
+		m_highHue = (high[0] + HUE_MARGIN) % HUE_RANGE;
+	}
+	m_lowSat = std::max(0, low[1] - SAT_VAL_MARGIN);
+	m_highSat = std::min(255, high[1] + SAT_VAL_MARGIN);
+	m_lowVal = std::max(0, low[2] - SAT_VAL_MARGIN);
+	m_highVal = std::min(255, high[2] + SAT_VAL_MARGIN);
+	return true;
+}
+
+/*
+* percentileRange
+*
+* preconditions:	hist must hold bins counts adding up to samples, samples > 0
+* postconditions:	sets low and high to the bins of the low and high calibration
+*					percentiles of hist
+*/
+void ColorPaddleDetector::percentileRange(const int *hist, int bins, int samples, int &low, int &high)
+{
+	int count = 0;
+	low = -1;
+	high = bins - 1;
+	for (int bin = 0; bin < bins; bin++)
+	{
+		count += hist[bin];
+		if (low < 0 && count * 100 > samples * CALIBRATION_LOW_PERCENT) low = bin;
+		if (count * 100 >= samples * CALIBRATION_HIGH_PERCENT)
+		{
+			high = bin;
+			break;
+		}
+	}
+}
+
+/*
+* loadProfile
+*
+* preconditions:	none
+* postconditions:	sets the tracking color from the profile saved under name and
+*					returns true, or returns false if no such profile was saved
+*/
+bool ColorPaddleDetector::loadProfile(const string &name)
+{
+	string path = name + PROFILE_EXTENSION;
+	if (!std::ifstream(path.c_str()).good()) return false;
+
+	FileStorage fs(path, FileStorage::READ);
+	if (!fs.isOpened()) return false;
+
+	fs["lowHue"] >> m_lowHue;
+	fs["highHue"] >> m_highHue;
+	fs["lowSat"] >> m_lowSat;
+	fs["highSat"] >> m_highSat;
+	fs["lowVal"] >> m_lowVal;
+	fs["highVal"] >> m_highVal;
+	return true;
+}
+
+/*
+* saveProfile
+*
+* preconditions:	none
+* postconditions:	saves the tracking color under name so it can be loaded on the
+*					next launch
+*/
+void ColorPaddleDetector::saveProfile(const string &name)
+{
+	FileStorage fs(name + PROFILE_EXTENSION, FileStorage::WRITE);
+	fs << "lowHue" << m_lowHue;
+	fs << "highHue" << m_highHue;
+	fs << "lowSat" << m_lowSat;
+	fs << "highSat" << m_highSat;
+	fs << "lowVal" << m_lowVal;
+	fs << "highVal" << m_highVal;
+}
+
 void ColorPaddleDetector::configureSettings(int e, int x, int y, int flags, void *userData)
 {
 
@@ -81,102 +306,407 @@ void ColorPaddleDetector::configureSettings(int e, int x, int y, int flags, void
 /*
 * createThresholdImg
 *
-* creates a threshold image from frame, removes small objects from the foreground
-* of the thresholded image and then fills the removed holes. The thresholded 
-* image is returned in destination.
+* creates a threshold image from frame. The thresholded image is returned in
+* destination.
+*
+* The frame is processed in horizontal bands small enough to stay in the L2 cache,
+* running every stage on a band before moving on to the next, and the bands are
+* processed in parallel. Each band is converted and blurred with the rows the
+* blurs reach above and below it, so the mask is the same as thresholding the
+* whole frame at once.
 *
 * preconditions:	frame must be the frame of video currently being processed. 
 * postconditions:	creates a thresholded image from frame and returns it in destination
 */
 void ColorPaddleDetector::createThresholdImg(Mat frame, Mat &dest)
 {
-	Mat HSV;
+	// shrink the frame to the processing resolution, into a view of the kept buffer so
+	// the rows scanned can change without allocating
+	if (m_settings.scale != 1.0)
+	{
+		Size scaled(cvRound(frame.cols * m_settings.scale), cvRound(frame.rows * m_settings.scale));
+		Mat small = bufferView(m_buffers.small, scaled, frame.type());
+		resize(frame, small, scaled, 0, 0, INTER_AREA);
+		frame = small;
+	}
+
+	dest.create(frame.rows, frame.cols, CV_8UC1);
+	if (frame.empty())
+	{
+		return;
+	}
+
+	// every gaussian blur reaches half its kernel into the next band
+	int halo = m_settings.gaussPasses * (m_settings.gaussSize / 2);
+
+	// the BGR band, the HSV band and the blur's buffer of each row are kept in cache
+	int rowBytes = frame.cols * 3 * 3;
+	int bandRows = std::max(std::max(STRIP_BYTES / rowBytes - 2 * halo, 4 * halo), MIN_STRIP_ROWS);
+	int bands = (frame.rows + bandRows - 1) / bandRows;
+	if (static_cast<int>(m_buffers.bands.size()) < bands)
+	{
+		m_buffers.bands.resize(bands);
+	}
+
+	ThresholdBands body(frame, dest, m_settings, bandRows, halo,
+						pipeline::HsvInRange(getLowBound(), getHighBound()), m_buffers.bands);
+	parallel_for_(Range(0, bands), body);
+}
+
+/*
+* ThresholdBands
+*
+* preconditions:	frame must be a BGR frame at the processing resolution and dest a
+*					single channel 8-bit image of the same size. buffers must have one
+*					entry for each band.
+* postconditions:	thresholds the bands in range of frame into the same rows of dest
+*/
+ColorPaddleDetector::ThresholdBands::ThresholdBands(const Mat &frame, Mat &dest, const DetectorSettings &settings,
+													 int bandRows, int halo, const pipeline::HsvInRange &range,
+													 vector<BandBuffers> &buffers)
+	: m_frame(frame), m_dest(dest), m_settings(settings), m_bandRows(bandRows), m_halo(halo),
+	  m_range(range), m_buffers(buffers), m_frameId(Trace::getFrame())
+{
+}
+
+void ColorPaddleDetector::ThresholdBands::operator()(const Range &range) const
+{
+	Trace::setFrame(m_frameId);
+	TRACE_SCOPE("color.bands");
+	Size gaussSize(m_settings.gaussSize, m_settings.gaussSize);
+
+	for (int band = range.start; band < range.end; band++)
+	{
+		BandBuffers &buffers = m_buffers[band];
+		int top = band * m_bandRows;
+		int bottom = std::min(top + m_bandRows, m_frame.rows);
+
+		// the rows of the band and the rows the blurs reach. At the top and bottom of
+		// the frame the band stops at the frame's border like a blur of the whole frame
+		int haloTop = std::max(top - m_halo, 0);
+		int haloBottom = std::min(bottom + m_halo, m_frame.rows);
+
+		// convert the band from BGR to HSV
+		Mat HSV = bufferView(buffers.hsv, Size(m_frame.cols, haloBottom - haloTop), CV_8UC3);
+		pipeline::BgrToHsv::apply(m_frame.rowRange(haloTop, haloBottom), HSV);
+
+		// the filter GaussianBlur would build on every call is only built when the blur
+		// changes. HSV is a view, so the blur is isolated to it like a whole image.
+		if (buffers.gauss.empty() || buffers.gaussSize != gaussSize || buffers.gaussSigma != m_settings.gaussSigma)
+		{
+			buffers.gauss = createGaussianFilter(CV_8UC3, gaussSize, m_settings.gaussSigma, m_settings.gaussSigma);
+			buffers.gaussSize = gaussSize;
+			buffers.gaussSigma = m_settings.gaussSigma;
+		}
+		for (int pass = 0; pass < m_settings.gaussPasses; pass++)
+		{
+			buffers.gauss->apply(HSV, HSV, Rect(0, 0, -1, -1), Point(0, 0), true);
+		}
+
+		// threshold the rows of the band itself into dest
+		Mat destRows = m_dest.rowRange(top, bottom);
+		Mat bandHSV = HSV.rowRange(top - haloTop, bottom - haloTop);
+		Mat wrapped = bufferView(buffers.wrapped, bandHSV.size(), CV_8UC1);
+		m_range.apply(bandHSV, destRows, wrapped);
+	}
+}
+
+/*
+* cleanMask
+*
+* packs a threshold image into a bit mask, removes small objects from its
+* foreground and then fills the holes left in the objects.
+*
+* preconditions:	thres must be a threshold image at the processing resolution
+* postconditions:	returns the cleaned threshold image in mask
+*/
+void ColorPaddleDetector::cleanMask(const Mat &thres, BitMask &mask)
+{
+	int radius = std::max(1, cvRound(CLEANUP_RADIUS * m_settings.scale));
+	mask.fromMat(thres);
+	mask.open(radius);
+	mask.close(radius);
+}
+
+/*
+* bufferView
+*
+* preconditions:	none
+* postconditions:	returns a view of size and type into the top left of buffer,
+*					growing buffer first if it is too small or of another type
+*/
+Mat ColorPaddleDetector::bufferView(Mat &buffer, Size size, int type)
+{
+	if (buffer.type() != type || buffer.cols < size.width || buffer.rows < size.height)
+	{
+		buffer.create(std::max(buffer.rows, size.height), std::max(buffer.cols, size.width), type);
+	}
+	return Mat(buffer, Rect(0, 0, size.width, size.height));
+}
+
+/*
+* halfZones
+*
+* preconditions:	none
+* postconditions:	returns the left and right halves of the frame as zones
+*/
+vector<Rect_<double> > ColorPaddleDetector::halfZones()
+{
+	vector<Rect_<double> > zones;
+	zones.push_back(Rect_<double>(0, 0, 0.5, 1));
+	zones.push_back(Rect_<double>(0.5, 0, 0.5, 1));
+	return zones;
+}
+
+/*
+* setZones
+*
+* preconditions:	each zone must be given as fractions (0 - 1) of the frame
+* postconditions:	tracks one object in each zone from the next frame on. The first
+*					two zones set the left and right paddles.
+*/
+void ColorPaddleDetector::setZones(const vector<Rect_<double> > &zones)
+{
+	m_zones = zones;
+	m_zonePos.assign(zones.size(), DEFAULT_PADDLE_POSITION);
+	m_zoneFound.assign(zones.size(), false);
+}
+
+/*
+* createRoiThresholdImg
+*
+* creates a threshold image of only the active zones. With roiOnly set only the rows
+* around the object found in each zone on the last frame are thresholded, zones
+* whose object was lost are thresholded in full.
+*
+* preconditions:	frame must be the frame of video currently being processed and
+*					zones must be the zones at the processing resolution. active must
+*					have one flag for each zone.
+* postconditions:	creates a thresholded image at the processing resolution which
+*					is empty outside of the scanned rows and returns it in dest
+*/
+void ColorPaddleDetector::createRoiThresholdImg(Mat &frame, const vector<Rect> &zones,
+												const vector<bool> &active, Mat &dest)
+{
+	double scale = m_settings.scale;
+	Rect bounds(0, 0, cvRound(frame.cols * scale), cvRound(frame.rows * scale));
+	Rect frameBounds(0, 0, frame.cols, frame.rows);
+	dest.create(bounds.size(), CV_8UC1);
+	dest.setTo(Scalar(0));
 
-	// convert frame from BGR to HSV
-	cvtColor(frame, HSV, COLOR_BGR2HSV);
+	for (size_t i = 0; i < zones.size(); i++)
+	{
+		if (!active[i]) continue;
 
-	GaussianBlur(HSV, HSV, Size(7, 7), 2, 2);
-	GaussianBlur(HSV, HSV, Size(7, 7), 2, 2);
+		Rect roi = zones[i];
+		if (m_settings.roiOnly && m_zoneFound[i])
+		{
+			int center = cvRound(m_zonePos[i] * scale);
+			int margin = cvRound(m_settings.roiMargin * scale);
+			roi = Rect(roi.x, center - margin, roi.width, margin * 2) & zones[i];
+		}
+		if (roi.area() == 0) continue;
 
-	// create threshold image using HSV frame and save in dest
-	inRange(HSV, Scalar(m_lowHue, m_lowSat, m_lowVal), Scalar(m_highHue, m_highSat, m_highVal), dest);
+		// threshold the rows of the frame under roi and place them in dest
+		Rect source(cvRound(roi.x / scale), cvRound(roi.y / scale),
+					cvRound(roi.width / scale), cvRound(roi.height / scale));
+		source = source & frameBounds;
+		Size scaled = scale != 1.0 ? Size(cvRound(source.width * scale), cvRound(source.height * scale))
+								   : source.size();
+		Mat roiThres = bufferView(m_buffers.roiThres, scaled, CV_8UC1);
+		createThresholdImg(Mat(frame, source), roiThres);
 
-	
-	
+		Rect target = Rect(roi.x, roi.y, roiThres.cols, roiThres.rows) & bounds;
+		Mat destRoi(dest, target);
+		Mat(roiThres, Rect(0, 0, target.width, target.height)).copyTo(destRoi);
+	}
 }
 
 /*
 * processFrame
 *
-* creates a threshold image of frame, splits the thresholded image into left and
-* right halves and then tracks for the configured color in each half, setting the
-* left and right paddle positions accordingly
+* creates a threshold image of frame, accumulates the moments of every zone of the
+* thresholded image in one pass and then tracks for the configured color in each
+* zone, setting the left and right paddle positions from the first two zones
 *
 * preconditions:	frame must be a valid Mat object representing a single frame from
 *					from a VideoCapture object
-* postconditions:	sets left and right paddles according to color detected in the
-*					left and right halves of the frame, respectively
+* postconditions:	sets the position of each zone according to color detected in it,
+*					the first two zones being the left and right paddles
 */
 void ColorPaddleDetector::processFrame(Mat &frame)
 {
 	flip(frame, frame, 1);
+	m_buffers.allActive.assign(m_zones.size(), true);
+	segmentZones(frame, m_buffers.allActive);
+}
+
+/*
+* clone
+*
+* preconditions:	none
+* postconditions:	returns a new detector with the same settings, color and zones which
+*					has processed no frames
+*/
+PaddleDetector *ColorPaddleDetector::clone() const
+{
+	ColorPaddleDetector *copy = new ColorPaddleDetector(*this);
+	copy->resetZones();
+	return copy;
+}
+
+/*
+* trackWholeFrame
+*
+* preconditions:	none
+* postconditions:	tracks the color in a single zone covering the whole frame, the
+*					left paddle, from the next frame on and returns true
+*/
+bool ColorPaddleDetector::trackWholeFrame()
+{
+	setZones(vector<Rect_<double> >(1, Rect_<double>(0, 0, 1, 1)));
+	return true;
+}
+
+/*
+* zoneRects
+*
+* preconditions:	none
+* postconditions:	sets zones to the zones in pixels of an image of size
+*/
+void ColorPaddleDetector::zoneRects(Size size, vector<Rect> &zones) const
+{
+	Rect bounds(0, 0, size.width, size.height);
+	zones.resize(m_zones.size());
+	for (size_t i = 0; i < m_zones.size(); i++)
+	{
+		int x = cvRound(m_zones[i].x * size.width);
+		int y = cvRound(m_zones[i].y * size.height);
+		int width = cvRound((m_zones[i].x + m_zones[i].width) * size.width) - x;
+		int height = cvRound((m_zones[i].y + m_zones[i].height) * size.height) - y;
+		zones[i] = Rect(x, y, width, height) & bounds;
+	}
+}
+
+/*
+* segmentZones
+*
+* creates a threshold image of the active zones of frame, accumulates their moments
+* in one pass and then tracks for the configured color in each of them.
+*
+* preconditions:	frame must be the mirrored frame of video currently being
+*					processed. active must have one flag for each zone.
+* postconditions:	sets the position of each active zone according to color detected
+*					in it. the other zones keep their last position.
+*/
+void ColorPaddleDetector::segmentZones(Mat &frame, const vector<bool> &active)
+{
+	// size the zones to the processing resolution
+	vector<Rect> &zones = m_buffers.zones;
+	zoneRects(Size(cvRound(frame.cols * m_settings.scale), cvRound(frame.rows * m_settings.scale)), zones);
+	bool allActive = std::find(active.begin(), active.end(), false) == active.end();
+
+	Mat &thres = m_buffers.thres;
+	{
+		TRACE_SCOPE("color.threshold");
+		if (m_settings.roiOnly || !allActive)
+		{
+			createRoiThresholdImg(frame, zones, active, thres);
+		}
+		else
+		{
+			createThresholdImg(frame, thres);
+		}
+	}
 
-	Mat thres;
-	createThresholdImg(frame, thres);
+	// only reset the accumulator when the zones or the processing resolution change
+	if (zones != m_zoneMoments.getZones())
+	{
+		m_zoneMoments.setZones(zones);
+	}
 
-	// create left and right threshold images for seperate color detection in
-	// left and right sides of the frame
-	int x = thres.cols / 2;
-	int y = thres.rows;
-	Mat thresholdLeft(thres, Rect(0, 0, 320, 480));
-	Mat thresholdRight(thres, Rect(320, 0, 320, 480));
+	// one pass over the cleaned threshold image for every zone
+	{
+		TRACE_SCOPE("color.mask");
+		cleanMask(thres, m_mask);
+	}
+	{
+		TRACE_SCOPE("color.moments");
+		ALLOC_SCOPE("moments");
+		m_zoneMoments.accumulate(m_mask);
+	}
 
-	// detect motion in the left and right frames 
-	detectMotion(thresholdLeft, frame, IS_RED);
-	detectMotion(thresholdRight, frame, IS_BLUE);
+	TRACE_SCOPE("color.track");
+	for (int i = 0; i < getZoneCount(); i++)
+	{
+		if (active[i])
+		{
+			trackZone(i, frame);
+		}
+	}
 }
 
 /*
 * detectMotion
 *
-* detects motion in a thresholded image
+* detects motion in a thresholded image. The moments of every zone are accumulated
+* in one pass by processFrame, so this tracks the first (left) or second (right)
+* zone from those moments and thres is not read again.
 *
-* preconditions:	thres must be one half (left or right) of the threshold image of the
-*					difference image from the sequential frames. frame must be the video
-*					frame being processed. isRight should be set true if we are detecting
+* preconditions:	processFrame must have accumulated the moments of the threshold
+*					image of frame. isRight should be set true if we are detecting
 *					motion in the right frame, otherwise it should be false as we are
 *					tracking motion in the left frame.
 * postconditions:	sets the paddle position of the paddle indicated by isRight and draws
 *					a crosshair around the object being tracked
 */
 void ColorPaddleDetector::detectMotion(Mat &thres, Mat &frame, bool isRight) {
-	
-	Moments Moms = moments(thres);
-
-	double m01 = Moms.m01;
-	double m10 = Moms.m10;
-	double area = Moms.m00;
-
-	if(area > AREA_THRES)
-	{
-		// calculate the position of the color being tracke in the left frame
-		int x = static_cast<int>(m10 / area);
-		int y = static_cast<int>(m01 / area);
-
-		Scalar color;
-		if(isRight) {
-			m_rightPaddlePos = y;
-			// position the right object appears in the entire frame
-			x = (frame.cols / 2) + x;
-			color = BLUE;
-		} else {
-			m_leftPaddlePos = y;
-			color = RED;
+	trackZone(isRight ? 1 : 0, frame);
+}
+
+/*
+* trackZone
+*
+* preconditions:	processFrame must have accumulated the moments of the threshold
+*					image of frame
+* postconditions:	sets the position of zone if enough of the color was found in it
+*					and draws a crosshair around the object being tracked
+*/
+void ColorPaddleDetector::trackZone(int zone, Mat &frame) {
+	const ZoneMoment &moms = m_zoneMoments.getMoment(zone);
+	const Rect &bounds = m_zoneMoments.getZones()[zone];
+
+	double m01 = moms.m01;
+	double m10 = moms.m10;
+	double area = moms.m00;
+
+	// the area shrinks with the square of the processing resolution
+	double areaThres = m_settings.areaThres * m_settings.scale * m_settings.scale;
+
+	m_zoneFound[zone] = false;
+
+	if(area > areaThres)
+	{
+		// calculate the position of the color being tracked in the frame and scale
+		// it from the processing resolution back up to the frame
+		int x = static_cast<int>((m10 / area + bounds.x) / m_settings.scale);
+		int y = static_cast<int>((m01 / area + bounds.y) / m_settings.scale);
+
+		m_zonePos[zone] = y;
+		m_zoneFound[zone] = true;
+		if(zone < 2) {
+			// twice the smallest area tracked is fully trusted
+			setPaddle(zone == 1, y, std::min(1.0, area / (2 * areaThres)));
 		}
 
-		// draw crosshairs through the point being tracked in the left frame
-		circle(frame, Point(x, y), 10, color, 2);
-		line(frame, Point(x, y + 15), Point(x, y - 15), color, 2);
-		line(frame, Point(x + 15, y), Point(x - 15, y), color, 2);
+		// even zones belong to the red side and odd zones to the blue side
+		Scalar color = zone % 2 == 0 ? RED : BLUE;
+
+		// draw crosshairs through the point being tracked in the zone
+		drawCrosshair(frame, Point(x, y), color);
+	}
+	else if(zone < 2)
+	{
+		losePaddle(zone == 1);
 	}
 }
\ No newline at end of file
@@ -3,15 +3,111 @@
 *
 * a class which detects motion in a video frame using color. The color
 * used for tracking is configured by the user before tracking beings. Motion
-* is tracked seperately in the left and right halves of the video frame.
+* is tracked seperately in each zone of the video frame, by default the left
+* and right halves.
 *
 */
 #pragma once
 #include "PaddleDetector.h"
+#include "DetectorPipeline.h"
+#include "ZoneMoments.h"
+
+const string PROFILE_EXTENSION = ".profile.yml";
+
+/*
+* ProfileMode
+*
+* how the profile constructor gets the tracking color
+*/
+enum ProfileMode {
+	LOAD_PROFILE,			// load the saved profile, calibrating it if there is none
+	RECALIBRATE_PROFILE,	// calibrate automatically again and replace the profile
+	CONFIGURE_PROFILE		// configure by hand with the scroll bars and replace the profile
+};
+
 class ColorPaddleDetector :
 	public PaddleDetector
 {
-	const static int AREA_THRES = 10000;
+	// auto calibration samples a box in the middle of the frame for CALIBRATION_MS
+	// after giving the player CALIBRATION_READY_MS to get the object into the box
+	const static int CALIBRATION_BOX = 60;
+	const static int CALIBRATION_READY_MS = 2000;
+	const static int CALIBRATION_MS = 1000;
+	const static int CALIBRATION_LOW_PERCENT = 5;
+	const static int CALIBRATION_HIGH_PERCENT = 95;
+	const static int HUE_MARGIN = 5;
+	// hue is an angle, 0 - 179, so red wraps around from 179 to 0
+	const static int HUE_RANGE = 180;
+	const static int SAT_VAL_MARGIN = 40;
+
+	// radius, in frame pixels, of the square used to clean up the threshold image
+	const static int CLEANUP_RADIUS = 2;
+
+	// the threshold image is made in bands of about STRIP_BYTES, sized for the L2 cache
+	const static int STRIP_BYTES = 256 * 1024;
+	const static int MIN_STRIP_ROWS = 16;
+
+	/*
+	* BandBuffers
+	*
+	* the images one band of the threshold image is converted and blurred in, and the
+	* blur itself, kept between frames. A band is only thresholded by one thread at a
+	* time. The images grow to the largest band seen and bands are processed in a view
+	* of them, so bands of changing height do not allocate.
+	*/
+	struct BandBuffers {
+		Mat hsv;
+		Mat wrapped;
+		Ptr<FilterEngine> gauss;
+		Size gaussSize;
+		double gaussSigma = 0;
+	};
+
+	/*
+	* FrameBuffers
+	*
+	* the images and lists each frame is processed into, kept between frames so a
+	* stream of frames of the same size does not allocate. A copy starts out empty, so a
+	* clone never writes into the buffers of the detector it was cloned from.
+	*/
+	struct FrameBuffers {
+		FrameBuffers() {}
+		FrameBuffers(const FrameBuffers &) {}
+		FrameBuffers &operator=(const FrameBuffers &) {return(*this);}
+
+		Mat small;
+		Mat thres;
+		Mat roiThres;
+		vector<Rect> zones;
+		vector<bool> allActive;
+		vector<BandBuffers> bands;
+	};
+
+	/*
+	* ThresholdBands
+	*
+	* thresholds a range of the horizontal bands of a frame, so the bands can be
+	* processed in parallel by parallel_for_. The bands are converted and thresholded
+	* by the stages of the fused color pipeline.
+	*/
+	class ThresholdBands : public ParallelLoopBody {
+	public:
+		ThresholdBands(const Mat &frame, Mat &dest, const DetectorSettings &settings,
+					   int bandRows, int halo, const pipeline::HsvInRange &range,
+					   vector<BandBuffers> &buffers);
+		void operator()(const Range &range) const;
+
+	private:
+		const Mat &m_frame;
+		Mat &m_dest;
+		const DetectorSettings &m_settings;
+		int m_bandRows;
+		int m_halo;
+		pipeline::HsvInRange m_range;
+		vector<BandBuffers> &m_buffers;
+		// the frame being processed, for tagging the trace events of the workers
+		uint64_t m_frameId;
+	};
 
 private:
 
@@ -26,6 +122,31 @@ private:
 
 	VideoCapture *m_vid;
 
+	// the zones tracked, as fractions of the frame, and the position found in each
+	vector<Rect_<double> > m_zones = halfZones();
+	vector<int> m_zonePos = vector<int>(m_zones.size(), DEFAULT_PADDLE_POSITION);
+	vector<bool> m_zoneFound = vector<bool>(m_zones.size(), false);
+	ZoneMoments m_zoneMoments;
+	BitMask m_mask;
+	FrameBuffers m_buffers;
+
+	/*
+	* bufferView
+	*
+	* preconditions:	none
+	* postconditions:	returns a view of size and type into the top left of buffer,
+	*					growing buffer first if it is too small or of another type
+	*/
+	static Mat bufferView(Mat &buffer, Size size, int type);
+
+	/*
+	* halfZones
+	*
+	* preconditions:	none
+	* postconditions:	returns the left and right halves of the frame as zones
+	*/
+	static vector<Rect_<double> > halfZones();
+
 	/*
 	* configure
 	*
@@ -33,30 +154,99 @@ private:
 	*
 	* preconditions:	none
 	* postconditions:	sets the values of lowHue, highHue, lowSat, highSat, lowVal, highVal
-	*					according to the input from the scroll bars in the configuration window
+	*					according to the input from the scroll bars in the configuration window.
+	*					a low hue above the high hue is a range which wraps around red.
 	*/
 	void configure();
 
+	/*
+	* autoConfigure
+	*
+	* launches a calibration window with a box marked in the middle of the frame. The
+	* player holds the object to be tracked in the box and the color is configured from
+	* the histograms of the pixels sampled in the box.
+	*
+	* preconditions:	m_vid must be a valid VideoCapture object
+	* postconditions:	sets the values of lowHue, highHue, lowSat, highSat, lowVal, highVal
+	*					to the range covering most of the pixels sampled in the box and
+	*					returns true, or returns false if no pixels could be sampled. The
+	*					hue range wraps, with lowHue above highHue, for red objects.
+	*/
+	bool autoConfigure();
+
+	/*
+	* percentileRange
+	*
+	* preconditions:	hist must hold bins counts adding up to samples, samples > 0
+	* postconditions:	sets low and high to the bins of the low and high calibration
+	*					percentiles of hist
+	*/
+	static void percentileRange(const int *hist, int bins, int samples, int &low, int &high);
+
+	/*
+	* loadProfile
+	*
+	* preconditions:	none
+	* postconditions:	sets the tracking color from the profile saved under name and
+	*					returns true, or returns false if no such profile was saved
+	*/
+	bool loadProfile(const string &name);
+
+	/*
+	* saveProfile
+	*
+	* preconditions:	none
+	* postconditions:	saves the tracking color under name so it can be loaded on the
+	*					next launch
+	*/
+	void saveProfile(const string &name);
+
 	/*
 	* createThresholdImg
 	*
-	* creates a threshold image from frame, removes small objects from the foreground
-	* of the thresholded image and then fills the removed holes. The thresholded
-	* image is returned in destination.
+	* creates a threshold image from frame. The thresholded image is returned in
+	* destination.
 	*
 	* preconditions:	frame must be the frame of video currently being processed.
 	* postconditions:	creates a thresholded image from frame and returns it in destination
 	*/
 	void createThresholdImg(Mat frame, Mat &destination);
 
+	/*
+	* cleanMask
+	*
+	* packs a threshold image into a bit mask, removes small objects from its
+	* foreground and then fills the holes left in the objects.
+	*
+	* preconditions:	thres must be a threshold image at the processing resolution
+	* postconditions:	returns the cleaned threshold image in mask
+	*/
+	void cleanMask(const Mat &thres, BitMask &mask);
+
+	/*
+	* createRoiThresholdImg
+	*
+	* creates a threshold image of only the active zones. With roiOnly set only the rows
+	* around the object found in each zone on the last frame are thresholded, zones
+	* whose object was lost are thresholded in full.
+	*
+	* preconditions:	frame must be the frame of video currently being processed and
+	*					zones must be the zones at the processing resolution. active must
+	*					have one flag for each zone.
+	* postconditions:	creates a thresholded image at the processing resolution which
+	*					is empty outside of the scanned rows and returns it in dest
+	*/
+	void createRoiThresholdImg(Mat &frame, const vector<Rect> &zones, const vector<bool> &active, Mat &dest);
+
 	/*
 	* detectMotion
 	*
-	* detects motion in a thresholded image
+	* detects motion in a thresholded image. The moments of every zone are accumulated
+	* in one pass by processFrame, so this tracks the first (left) or second (right)
+	* zone from those moments and thres is not read again.
 	*
-	* preconditions:	thres must be one half (left or right) of the threshold image of the
-	*					difference image from the sequential frames. frame must be the video
-	*					frame being processed. isRight should be set true if we are detecting
+	* preconditions:	processFrame must have accumulated the moments of the threshold
+	*					image of frame. isRight should be set true if we are detecting
 	*					motion in the right frame, otherwise it should be false as we are
 	*					tracking motion in the left frame.
 	* postconditions:	sets the paddle position of the paddle indicated by isRight and draws
@@ -64,8 +254,48 @@ private:
 	*/
 	void detectMotion(Mat &thres, Mat &frame, bool isRight);
 
+	/*
+	* trackZone
+	*
+	* preconditions:	processFrame must have accumulated the moments of the threshold
+	*					image of frame
+	* postconditions:	sets the position of zone if enough of the color was found in it
+	*					and draws a crosshair around the object being tracked
+	*/
+	void trackZone(int zone, Mat &frame);
+
 	void configureSettings(int e, int x, int y, int flags, void *userData);
 
+protected:
+	/*
+	* resetZones
+	*
+	* preconditions:	none
+	* postconditions:	forgets the position found in each zone, keeping the zones
+	*/
+	void resetZones() {setZones(vector<Rect_<double> >(m_zones));}
+
+	/*
+	* zoneRects
+	*
+	* preconditions:	none
+	* postconditions:	sets zones to the zones in pixels of an image of size
+	*/
+	void zoneRects(Size size, vector<Rect> &zones) const;
+
+	/*
+	* segmentZones
+	*
+	* creates a threshold image of the active zones of frame, accumulates their moments
+	* in one pass and then tracks for the configured color in each of them.
+	*
+	* preconditions:	frame must be the mirrored frame of video currently being
+	*					processed. active must have one flag for each zone.
+	* postconditions:	sets the position of each active zone according to color detected
+	*					in it. the other zones keep their last position.
+	*/
+	void segmentZones(Mat &frame, const vector<bool> &active);
+
 public:
 	/*
 	* ColorPaddleDetector default constructor
@@ -86,6 +316,19 @@ public:
 	*/
 	ColorPaddleDetector(VideoCapture *vid);
 
+	/*
+	* ColorPaddleDetector profile constructor
+	*
+	* preconditions:	vid must be a valid VideoCapture object point not equal to
+	*					nullptr
+	* postconditions:	sets the left and right paddles equal to the default position,
+	*					sets this->vid equal to vid, and loads the tracking color from
+	*					the profile saved under profile. If there is no such profile, or
+	*					mode asks for it, the color is calibrated and saved under profile.
+	*					A calibration which sampled nothing is not saved.
+	*/
+	ColorPaddleDetector(VideoCapture *vid, const string &profile, ProfileMode mode = LOAD_PROFILE);
+
 	/*
 	* ColorPaddleDetector destructor
 	*
@@ -97,16 +340,83 @@ public:
 	/*
 	* processFrame
 	*
-	* creates a threshold image of frame, splits the thresholded image into left and
-	* right halves and then tracks for the configured color in each half, setting the
-	* left and right paddle positions accordingly
+	* creates a threshold image of frame, accumulates the moments of every zone of the
+	* thresholded image in one pass and then tracks for the configured color in each
+	* zone, setting the left and right paddle positions from the first two zones
 	*
 	* preconditions:	frame must be a valid Mat object representing a single frame from
 	*					from a VideoCapture object
-	* postconditions:	sets left and right paddles according to color detected in the
-	*					left and right halves of the frame, respectively
+	* postconditions:	sets the position of each zone according to color detected in it,
+	*					the first two zones being the left and right paddles
 	*/
 	void ColorPaddleDetector::processFrame(Mat &frame);
+
+	/*
+	* clone
+	*
+	* preconditions:	none
+	* postconditions:	returns a new detector with the same settings, color and zones which has
+	*					processed no frames
+	*/
+	virtual PaddleDetector *clone() const;
+
+	/*
+	* scansRoi
+	*
+	* preconditions:	none
+	* postconditions:	returns true, segmentZones reads roiOnly
+	*/
+	virtual bool scansRoi() const {return(true);}
+
+	/*
+	* trackWholeFrame
+	*
+	* preconditions:	none
+	* postconditions:	tracks the color in a single zone covering the whole frame, the
+	*					left paddle, from the next frame on and returns true
+	*/
+	virtual bool trackWholeFrame();
+
+	/*
+	* setZones
+	*
+	* preconditions:	each zone must be given as fractions (0 - 1) of the frame
+	* postconditions:	tracks one object in each zone from the next frame on. The first
+	*					two zones set the left and right paddles.
+	*/
+	void setZones(const vector<Rect_<double> > &zones);
+
+	/*
+	* getZoneCount
+	*
+	* preconditions:	none
+	* postconditions:	returns the number of zones being tracked
+	*/
+	int getZoneCount() const {return(static_cast<int>(m_zones.size()));}
+
+	/*
+	* getZoneLoc
+	*
+	* preconditions:	zone must be less than getZoneCount()
+	* postconditions:	returns the y-value of the object tracked in zone
+	*/
+	int getZoneLoc(int zone) const {return(m_zonePos[zone]);}
+
+	/*
+	* getLowBound
+	*
+	* preconditions:	none
+	* postconditions:	returns the lowest hue, saturation and value tracked
+	*/
+	Vec3b getLowBound() const {return(Vec3b(m_lowHue, m_lowSat, m_lowVal));}
+
+	/*
+	* getHighBound
+	*
+	* preconditions:	none
+	* postconditions:	returns the highest hue, saturation and value tracked
+	*/
+	Vec3b getHighBound() const {return(Vec3b(m_highHue, m_highSat, m_highVal));}
 	
 };
 
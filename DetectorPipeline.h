@@ -0,0 +1,663 @@
+/*
+* DetectorPipeline
+*
+* a library of detector stages which are assembled into a detector at compile time:
+*
+*		source -> mirror -> convert -> threshold -> filter -> locate
+*
+* Every stage is a small class whose per-pixel operation is an inline member, and the
+* Pipeline template calls them in one loop over the frame. The compiler inlines the
+* stages into that loop, so a pixel goes from the source to the locator without any
+* virtual calls or intermediate Mats. Only one row of the threshold image (plus the
+* rows a filter needs) is ever stored.
+*
+* Every stage takes the detector settings which apply to it in configure(), which the
+* Pipeline calls before each frame. The stages which the motion and color detectors
+* share also have an apply() form working on a whole Mat, so those detectors, which
+* process their frames in tiles and bands rather than in one pass, are built from
+* the same stages and threshold exactly as the pipelines do.
+*
+*/
+#ifndef DETECTORPIPELINE_H
+#define DETECTORPIPELINE_H
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include "PaddleDetector.h"
+
+namespace pipeline {
+
+/*
+* stepOf
+*
+* the pipelines sample every step-th pixel of every step-th row in place of shrinking
+* the frame to the processing resolution
+*/
+inline int stepOf(const DetectorSettings &settings) {
+	return(std::max(1, cvRound(1.0 / settings.scale)));
+}
+
+/* ---------------------------------------------------------------------------------
+* sources
+*
+* a source provides the rows of the frames being processed. acquire() is called once
+* per frame and prepare() once per row; prepare() applies the mirror stage to the row
+* while it is in cache and returns the row to be converted.
+* --------------------------------------------------------------------------------*/
+
+/*
+* FrameSource
+*
+* the frame passed to processFrame
+*/
+struct FrameSource {
+	typedef const uchar *Row;
+
+	bool acquire(Mat &frame, VideoCapture *) {
+		m_frame = frame;
+		return(!m_frame.empty());
+	}
+
+	int rows() const {return(m_frame.rows);}
+	int cols() const {return(m_frame.cols);}
+
+	template<class Mirror>
+	Row prepare(int y) {
+		uchar *row = m_frame.ptr<uchar>(y);
+		Mirror::apply(row, m_frame.cols);
+		return(row);
+	}
+
+	Mat m_frame;
+};
+
+/*
+* FramePairSource
+*
+* two sequential frames. With a VideoCapture both are read from it, the first being
+* returned in the frame passed to processFrame. Without one the frame passed to
+* processFrame is paired with the frame passed before it, which is kept mirrored
+* as each of its rows is prepared. The first frame is paired with itself.
+*/
+struct FramePairSource {
+	struct Row {
+		const uchar *first;
+		const uchar *second;
+	};
+
+	FramePairSource() : m_read(false), m_paired(false) {}
+
+	bool acquire(Mat &frame, VideoCapture *vid) {
+		m_read = vid != nullptr;
+		if(m_read) {
+			vid->read(frame);
+			vid->read(m_second);
+			m_first = frame;
+			return(!m_first.empty() && !m_second.empty() && m_first.size() == m_second.size());
+		}
+
+		// the frame kept last time is the one before this one
+		std::swap(m_kept, m_second);
+		m_first = frame;
+		if(m_first.empty()) return(false);
+		m_paired = m_second.size() == m_first.size() && m_second.type() == m_first.type();
+		m_kept.create(m_first.size(), m_first.type());
+		return(true);
+	}
+
+	int rows() const {return(m_first.rows);}
+	int cols() const {return(m_first.cols);}
+
+	template<class Mirror>
+	Row prepare(int y) {
+		Row row;
+		uchar *first = m_first.ptr<uchar>(y);
+		Mirror::apply(first, m_first.cols);
+		row.first = first;
+		if(m_read) {
+			uchar *second = m_second.ptr<uchar>(y);
+			Mirror::apply(second, m_second.cols);
+			row.second = second;
+		} else {
+			// keep the row for the next frame while it is in cache, the frame itself is
+			// drawn on after the pipeline ran
+			uchar *kept = m_kept.ptr<uchar>(y);
+			std::copy(first, first + m_first.cols * m_first.elemSize(), kept);
+			row.second = m_paired ? m_second.ptr<uchar>(y) : kept;
+		}
+		return(row);
+	}
+
+	bool m_read;
+	bool m_paired;
+	Mat m_first;
+	Mat m_second;
+	Mat m_kept;
+};
+
+/* ---------------------------------------------------------------------------------
+* mirror stages
+*
+* apply() is handed a BGR row of the source before anything reads it
+* --------------------------------------------------------------------------------*/
+
+/*
+* NoMirror
+*
+* leaves the frame as it was captured
+*/
+struct NoMirror {
+	static void apply(uchar *, int) {}
+	static void apply(Mat &) {}
+};
+
+/*
+* FlipMirror
+*
+* mirrors the row in place, the same as flip(frame, frame, 1), so both the detector
+* and the frame displayed behind the game see the player as in a mirror
+*/
+struct FlipMirror {
+	static void apply(uchar *row, int cols) {
+		uchar *left = row;
+		uchar *right = row + (cols - 1) * 3;
+		while(left < right) {
+			std::swap(left[0], right[0]);
+			std::swap(left[1], right[1]);
+			std::swap(left[2], right[2]);
+			left += 3;
+			right -= 3;
+		}
+	}
+
+	static void apply(Mat &frame) {flip(frame, frame, 1);}
+};
+
+/* ---------------------------------------------------------------------------------
+* convert stages
+*
+* convert the pixel in column x of a source row to the value being thresholded
+* --------------------------------------------------------------------------------*/
+
+/*
+* gray
+*
+* BGR to gray with the same fixed point weights as cvtColor(COLOR_BGR2GRAY)
+*/
+inline int gray(const uchar *pixel) {
+	return((pixel[0] * 1868 + pixel[1] * 9617 + pixel[2] * 4899 + (1 << 13)) >> 14);
+}
+
+/*
+* BgrToGray
+*/
+struct BgrToGray {
+	typedef int Value;
+
+	void configure(const DetectorSettings &) {}
+	static void apply(const Mat &bgr, Mat &dst) {cvtColor(bgr, dst, COLOR_BGR2GRAY);}
+
+	Value operator()(FrameSource::Row row, int x) const {
+		return(gray(row + x * 3));
+	}
+};
+
+/*
+* GrayDiff
+*
+* the absolute difference of the gray values of two sequential frames. apply()
+* takes the frames already converted to gray.
+*/
+struct GrayDiff {
+	typedef int Value;
+
+	void configure(const DetectorSettings &) {}
+	static void apply(const Mat &first, const Mat &second, Mat &dst) {absdiff(first, second, dst);}
+
+	Value operator()(const FramePairSource::Row &row, int x) const {
+		return(std::abs(gray(row.first + x * 3) - gray(row.second + x * 3)));
+	}
+};
+
+/*
+* BgrToHsv
+*
+* BGR to the 8-bit HSV of cvtColor(COLOR_BGR2HSV): hue in 0 - 179, saturation and
+* value in 0 - 255
+*/
+struct BgrToHsv {
+	typedef Vec3b Value;
+
+	void configure(const DetectorSettings &) {}
+	static void apply(const Mat &bgr, Mat &dst) {cvtColor(bgr, dst, COLOR_BGR2HSV);}
+
+	Value operator()(FrameSource::Row row, int x) const {
+		const uchar *pixel = row + x * 3;
+		int b = pixel[0];
+		int g = pixel[1];
+		int r = pixel[2];
+		int v = std::max(b, std::max(g, r));
+		int diff = v - std::min(b, std::min(g, r));
+
+		int s = v == 0 ? 0 : (diff * 255 + v / 2) / v;
+		int h = 0;
+		if(diff != 0) {
+			float scale = 30.0f / diff;
+			float hue;
+			if(v == r) {
+				hue = (g - b) * scale;
+			} else if(v == g) {
+				hue = (b - r) * scale + 60;
+			} else {
+				hue = (r - g) * scale + 120;
+			}
+			h = static_cast<int>(hue + (hue < 0 ? 180.5f : 0.5f));
+			if(h >= 180) h -= 180;
+		}
+		return(Value(static_cast<uchar>(h), static_cast<uchar>(s), static_cast<uchar>(v)));
+	}
+};
+
+/* ---------------------------------------------------------------------------------
+* threshold stages
+*
+* decide whether a converted value belongs to the tracked object
+* --------------------------------------------------------------------------------*/
+
+/*
+* Above
+*
+* the same as threshold(src, dst, thres, 255, THRESH_BINARY)
+*/
+struct Above {
+	explicit Above(int thres = DEFAULT_THRESHOLD_SENSITIVITY) : m_thres(thres) {}
+
+	void configure(const DetectorSettings &settings) {m_thres = settings.thresholdSensitivity;}
+
+	bool operator()(int value) const {return(value > m_thres);}
+
+	void apply(const Mat &src, Mat &dst) const {threshold(src, dst, m_thres, 255, THRESH_BINARY);}
+
+	int m_thres;
+};
+
+/*
+* HsvInRange
+*
+* the same as inRange(src, low, high, dst) on an HSV image, except that a low hue
+* above the high hue is a range which wraps around red. The range is calibrated, not
+* set by the settings.
+*/
+struct HsvInRange {
+	HsvInRange() : m_low(0, 0, 0), m_high(0, 0, 0) {}
+	HsvInRange(const Vec3b &low, const Vec3b &high) : m_low(low), m_high(high) {}
+
+	void configure(const DetectorSettings &) {}
+
+	bool operator()(const Vec3b &value) const {
+		bool hue = m_low[0] <= m_high[0] ? value[0] >= m_low[0] && value[0] <= m_high[0]
+										 : value[0] >= m_low[0] || value[0] <= m_high[0];
+		return(hue &&
+			   value[1] >= m_low[1] && value[1] <= m_high[1] &&
+			   value[2] >= m_low[2] && value[2] <= m_high[2]);
+	}
+
+	// wrapped is the buffer for the second half of a range which wraps around red
+	void apply(const Mat &hsv, Mat &dst, Mat &wrapped) const {
+		Scalar low(m_low[0], m_low[1], m_low[2]);
+		Scalar high(m_high[0], m_high[1], m_high[2]);
+		if(m_low[0] <= m_high[0]) {
+			inRange(hsv, low, high, dst);
+			return;
+		}
+		// the hues from low up to the top of the range (179) and from 0 up to high
+		inRange(hsv, low, Scalar(179, m_high[1], m_high[2]), dst);
+		inRange(hsv, Scalar(0, m_low[1], m_low[2]), high, wrapped);
+		bitwise_or(dst, wrapped, dst);
+	}
+
+	Vec3b m_low;
+	Vec3b m_high;
+};
+
+/* ---------------------------------------------------------------------------------
+* filter stages
+*
+* filters receive each row of the threshold image as 0/1 values as soon as it is
+* thresholded and pass filtered rows on to the locator with row(y, bits, cols).
+* --------------------------------------------------------------------------------*/
+
+/*
+* NoFilter
+*
+* passes every row straight through to the locator
+*/
+struct NoFilter {
+	void configure(const DetectorSettings &) {}
+
+	void begin(int, int) {}
+
+	template<class Locate>
+	void push(int y, const uchar *bits, int cols, Locate &locate) {
+		locate.row(y, bits, cols);
+	}
+
+	template<class Locate>
+	void end(Locate &) {}
+};
+
+/*
+* BoxFilter
+*
+* the same as blur(thres, thres, Size(size, size)) followed by
+* threshold(thres, thres, sensitivity, 255, THRESH_BINARY), which joins the pixels
+* of a moving object into one blob. It keeps the running column sums of the last
+* size rows so every row is only added and removed once. Unlike blur, which reflects
+* the frame at its border, pixels outside of the frame count as empty.
+*/
+class BoxFilter {
+public:
+	explicit BoxFilter(int size = DEFAULT_BLUR_SIZE, int sensitivity = DEFAULT_THRESHOLD_SENSITIVITY) :
+		m_size(size), m_anchor(size / 2), m_minCount(minCount(size, sensitivity)), m_rows(0), m_cols(0) {}
+
+	void configure(const DetectorSettings &settings) {
+		m_size = std::max(1, settings.blurSize);
+		m_anchor = m_size / 2;
+		m_minCount = minCount(m_size, settings.thresholdSensitivity);
+	}
+
+	void begin(int rows, int cols) {
+		m_rows = rows;
+		m_cols = cols;
+		m_ring.assign(m_size * cols, 0);
+		m_colSums.assign(cols, 0);
+		m_out.resize(cols);
+	}
+
+	template<class Locate>
+	void push(int y, const uchar *bits, int cols, Locate &locate) {
+		// replace the oldest row of the window with the new row
+		uchar *slot = &m_ring[(y % m_size) * m_cols];
+		for(int x = 0; x < cols; x++) {
+			m_colSums[x] += bits[x] - slot[x];
+			slot[x] = bits[x];
+		}
+		emit(y - (m_size - 1) + m_anchor, locate);
+	}
+
+	template<class Locate>
+	void end(Locate &locate) {
+		// push empty rows below the frame to flush the rows still in the window
+		for(int y = m_rows; y < m_rows + m_size - 1 - m_anchor; y++) {
+			uchar *slot = &m_ring[(y % m_size) * m_cols];
+			for(int x = 0; x < m_cols; x++) {
+				m_colSums[x] -= slot[x];
+				slot[x] = 0;
+			}
+			emit(y - (m_size - 1) + m_anchor, locate);
+		}
+	}
+
+private:
+	/*
+	* minCount
+	*
+	* blur rounds the mean of the window, count * 255 / (size * size), to the nearest
+	* value and threshold keeps it only above sensitivity. Returns the fewest pixels
+	* set in the window which survive both, or more than the window holds if none do.
+	*/
+	static int minCount(int size, int sensitivity) {
+		int area = size * size;
+		int count = 0;
+		while(count <= area && cvRound(count * 255.0 / area) <= sensitivity) {
+			count++;
+		}
+		return(count);
+	}
+
+	template<class Locate>
+	void emit(int y, Locate &locate) {
+		if(y < 0) return;
+
+		// slide the window along the column sums of the row
+		int sum = 0;
+		int lead = m_size - 1 - m_anchor;
+		for(int x = 0; x < lead && x < m_cols; x++) {
+			sum += m_colSums[x];
+		}
+		for(int x = 0; x < m_cols; x++) {
+			if(x + lead < m_cols) sum += m_colSums[x + lead];
+			if(x - m_anchor - 1 >= 0) sum -= m_colSums[x - m_anchor - 1];
+			m_out[x] = sum >= m_minCount ? 1 : 0;
+		}
+		locate.row(y, &m_out[0], m_cols);
+	}
+
+	int m_size;
+	int m_anchor;
+	int m_minCount;
+	int m_rows;
+	int m_cols;
+	vector<uchar> m_ring;
+	vector<int> m_colSums;
+	vector<uchar> m_out;
+};
+
+/* ---------------------------------------------------------------------------------
+* locate stages
+*
+* locators gather the filtered rows of the left and right halves of the frame and
+* report where the object is in each half. zone 0 is the left half (red player) and
+* zone 1 is the right half (blue player). The rows are sampled every step pixels, the
+* locators report their positions in the pixels of the frame.
+* --------------------------------------------------------------------------------*/
+
+/*
+* MomentLocator
+*
+* the center of mass of each half, the same as the m10 / m00 and m01 / m00 of
+* moments() on each half of the threshold image
+*/
+class MomentLocator {
+public:
+	explicit MomentLocator(int areaThres = DEFAULT_AREA_THRES) : m_areaThres(areaThres), m_step(1), m_half(0) {}
+
+	void configure(const DetectorSettings &settings) {
+		m_areaThres = settings.areaThres;
+		m_step = stepOf(settings);
+	}
+
+	void begin(int, int cols) {
+		m_half = cols / 2;
+		for(int i = 0; i < 2; i++) {
+			m_m00[i] = m_m10[i] = m_m01[i] = 0;
+		}
+	}
+
+	void row(int y, const uchar *bits, int cols) {
+		int limit[2] = {m_half, std::min(cols, m_half * 2)};
+		int x = 0;
+		for(int zone = 0; zone < 2; zone++) {
+			int count = 0;
+			double sumX = 0;
+			int origin = zone * m_half;
+			for(; x < limit[zone]; x++) {
+				if(bits[x]) {
+					count++;
+					sumX += x - origin;
+				}
+			}
+			m_m00[zone] += count;
+			m_m10[zone] += sumX;
+			m_m01[zone] += static_cast<double>(count) * y;
+		}
+	}
+
+	// moments() of a 0/255 image weighs every pixel by 255, and every pixel sampled
+	// stands for step * step pixels of the frame
+	bool found(int zone) const {return(m_m00[zone] * 255 * m_step * m_step > m_areaThres);}
+
+	Point center(int zone) const {
+		return(Point((static_cast<int>(m_m10[zone] / m_m00[zone]) + zone * m_half) * m_step,
+					 static_cast<int>(m_m01[zone] / m_m00[zone]) * m_step));
+	}
+
+	int m_areaThres;
+
+private:
+	int m_step;
+	int m_half;
+	double m_m00[2];
+	double m_m10[2];
+	double m_m01[2];
+};
+
+/*
+* BoundsLocator
+*
+* the center of the bounding rectangle of everything found in each half
+*/
+class BoundsLocator {
+public:
+	BoundsLocator() : m_step(1), m_half(0) {}
+
+	void configure(const DetectorSettings &settings) {m_step = stepOf(settings);}
+
+	void begin(int, int cols) {
+		m_half = cols / 2;
+		for(int i = 0; i < 2; i++) {
+			m_minX[i] = m_minY[i] = INT_MAX;
+			m_maxX[i] = m_maxY[i] = -1;
+		}
+	}
+
+	void row(int y, const uchar *bits, int cols) {
+		int limit[2] = {m_half, std::min(cols, m_half * 2)};
+		int x = 0;
+		for(int zone = 0; zone < 2; zone++) {
+			int first = -1;
+			int last = -1;
+			for(; x < limit[zone]; x++) {
+				if(bits[x]) {
+					if(first < 0) first = x;
+					last = x;
+				}
+			}
+			if(first >= 0) {
+				m_minX[zone] = std::min(m_minX[zone], first);
+				m_maxX[zone] = std::max(m_maxX[zone], last);
+				m_minY[zone] = std::min(m_minY[zone], y);
+				m_maxY[zone] = y;
+			}
+		}
+	}
+
+	bool found(int zone) const {return(m_maxY[zone] >= 0);}
+
+	Point center(int zone) const {
+		return(Point((m_minX[zone] + m_maxX[zone]) / 2 * m_step, (m_minY[zone] + m_maxY[zone]) / 2 * m_step));
+	}
+
+private:
+	int m_step;
+	int m_half;
+	int m_minX[2];
+	int m_maxX[2];
+	int m_minY[2];
+	int m_maxY[2];
+};
+
+/* ---------------------------------------------------------------------------------
+* Pipeline
+* --------------------------------------------------------------------------------*/
+
+/*
+* Pipeline
+*
+* runs the stages over a frame in one pass. The stage objects carry the runtime
+* parameters (thresholds, filter sizes), which configure() sets from the detector
+* settings, and are reached through the accessors so a detector can retune them
+* between frames.
+*/
+template<class Source, class Mirror, class Convert, class Threshold, class Filter, class Locate>
+class Pipeline {
+public:
+	typedef Source SourceType;
+
+	Pipeline(const Convert &convert = Convert(), const Threshold &threshold = Threshold(),
+			 const Filter &filter = Filter(), const Locate &locate = Locate()) :
+		m_convert(convert), m_threshold(threshold), m_filter(filter), m_locate(locate), m_step(1) {}
+
+	/*
+	* configure
+	*
+	* preconditions:	none
+	* postconditions:	hands settings to every stage and samples the frame at the
+	*					processing resolution of settings from the next run on
+	*/
+	void configure(const DetectorSettings &settings) {
+		m_step = stepOf(settings);
+		m_convert.configure(settings);
+		m_threshold.configure(settings);
+		m_filter.configure(settings);
+		m_locate.configure(settings);
+	}
+
+	/*
+	* run
+	*
+	* preconditions:	source must have acquired a frame
+	* postconditions:	mirrors the frame of source and leaves the location of the object
+	*					in each half of the frame in locate(). Only the rows from top up to
+	*					bottom are thresholded, the rest are mirrored and count as empty.
+	*/
+	void run(Source &source, int top = 0, int bottom = INT_MAX) {
+		int rows = source.rows();
+		int cols = source.cols();
+		int sampledRows = (rows + m_step - 1) / m_step;
+		int sampledCols = (cols + m_step - 1) / m_step;
+
+		m_bits.resize(sampledCols);
+		m_filter.begin(sampledRows, sampledCols);
+		m_locate.begin(sampledRows, sampledCols);
+
+		for(int y = 0; y < rows; y++) {
+			// every row is mirrored for the frame displayed, only the sampled rows are read
+			typename Source::Row row = source.template prepare<Mirror>(y);
+			if(y % m_step != 0) continue;
+
+			if(y < top || y >= bottom) {
+				std::fill(m_bits.begin(), m_bits.end(), 0);
+			} else {
+				for(int x = 0; x < sampledCols; x++) {
+					m_bits[x] = m_threshold(m_convert(row, x * m_step)) ? 1 : 0;
+				}
+			}
+			m_filter.push(y / m_step, &m_bits[0], sampledCols, m_locate);
+		}
+		m_filter.end(m_locate);
+	}
+
+	Convert &convert() {return(m_convert);}
+	Threshold &threshold() {return(m_threshold);}
+	Filter &filter() {return(m_filter);}
+	Locate &locate() {return(m_locate);}
+
+private:
+	Convert m_convert;
+	Threshold m_threshold;
+	Filter m_filter;
+	Locate m_locate;
+	int m_step;
+	vector<uchar> m_bits;
+};
+
+/*
+* the pipelines of the motion and color detectors built from the stages above
+*/
+typedef Pipeline<FramePairSource, FlipMirror, GrayDiff, Above, BoxFilter, BoundsLocator> MotionPipeline;
+typedef Pipeline<FrameSource, FlipMirror, BgrToHsv, HsvInRange, NoFilter, MomentLocator> ColorPipeline;
+
+}
+
+#endif
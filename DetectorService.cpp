@@ -0,0 +1,98 @@
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include "MotionPaddleDetector.h"
+#include "ColorPaddleDetector.h"
+#include "OpticalFlowPaddleDetector.h"
+#include "SharedPaddleRing.h"
+using namespace std;
+
+// set by ctrl+c or a termination request, the loop then stops and the ring is
+// removed so no game attaches to a ring nobody publishes to
+volatile sig_atomic_t g_quit = 0;
+
+/*
+* requestQuit
+*
+* preconditions:	called as a signal handler
+* postconditions:	asks the detection loop to stop after the current frame
+*/
+extern "C" void requestQuit(int) {
+	g_quit = 1;
+}
+
+/*
+* main
+*
+* runs one detector on the default camera in its own process and publishes every
+* detection, with the frame it was detected in, through a SharedPaddleRing. The game
+* ("shared" tracking), recorders and analytics tools all read the same detections
+* from the ring instead of opening the camera and detecting again.
+*
+* usage: detectorservice <move|color|flow> [profile] [ring name]
+*
+*/
+int main(int argc, char *argv[]) {
+	string tracking = argc > 1 ? argv[1] : MPD_FLAG;
+	string profile = argc > 2 ? argv[2] : "default";
+	string name = argc > 3 ? argv[3] : DEFAULT_RING_NAME;
+
+	VideoCapture cap(0);
+	cap.set(CV_CAP_PROP_FPS, 15);
+	if(!cap.isOpened()) {
+		cout << "No camera has been detected, please connect one to detect." << endl;
+		return(-1);
+	}
+
+	PaddleDetector *sherlock;
+	if(tracking == CPD_FLAG) {
+		sherlock = new ColorPaddleDetector(&cap, profile);
+	} else if(tracking == OFPD_FLAG) {
+		sherlock = new OpticalFlowPaddleDetector();
+	} else {
+		// without a capture of its own the detector tracks the frames read here, so each
+		// published image is the frame its detection and timestamp belong to
+		sherlock = new MotionPaddleDetector();
+	}
+
+	// size the ring's images from the first frame
+	Mat frame;
+	cap >> frame;
+	SharedPaddleRing ring(name, DEFAULT_RING_SLOTS, frame.size(), frame.type());
+	if(!ring.isOpen()) {
+		cout << "Could not create the shared ring \"" << name << "\"." << endl;
+		delete sherlock;
+		return(-1);
+	}
+	cout << "Publishing " << tracking << " detections to \"" << name << "\" ... press ctrl+c to quit" << endl;
+	signal(SIGINT, requestQuit);
+	signal(SIGTERM, requestQuit);
+
+	PaddleSample sample;
+	sample.frameId = 0;
+	while(!g_quit) {
+		cap >> frame;
+		sample.timestampUs = chrono::duration_cast<chrono::microseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count();
+		if(frame.empty()) break;
+
+		sherlock->processFrame(frame);
+
+		PaddleReading left = sherlock->getLeftPaddle();
+		PaddleReading right = sherlock->getRightPaddle();
+		sample.leftPaddlePos = left.pos;
+		sample.rightPaddlePos = right.pos;
+		sample.leftConfidence = left.confidence;
+		sample.rightConfidence = right.confidence;
+		sample.leftFound = left.found;
+		sample.rightFound = right.found;
+		ring.publish(sample, &frame);
+		sample.frameId++;
+	}
+
+	// the ring removes its name as it goes out of scope
+	delete sherlock;
+	cap.release();
+	return(0);
+}
@@ -1,66 +1,286 @@
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include "GameBoard.h"
 #include "MotionPaddleDetector.h"
 #include "ColorPaddleDetector.h"
+#include "HybridPaddleDetector.h"
+#include "OpticalFlowPaddleDetector.h"
+#include "PipelinePaddleDetector.h"
+#include "FrameGovernor.h"
+#include "AsyncPaddleDetector.h"
+#include "StateBroadcast.h"
+#include "SharedPaddleDetector.h"
+#include "BotPaddleDetector.h"
+#include "AllocCounter.h"
+#include "Trace.h"
 using namespace std;
 
+// where the timeline of the game is written in a build with CVPONG_TRACE defined
+const string TRACE_FILE = "cvpong.trace.json";
+
+// flags which calibrate the color profile again instead of loading it
+const string RECALIBRATE_FLAG = "--recalibrate";
+const string CONFIGURE_FLAG = "--configure";
+
+// flag followed by the address the game state is broadcast to for spectators
+const string BROADCAST_FLAG = "--broadcast";
+
+// the shortest tick when no camera in this process sets the pace, as the game
+// ran with highgui's waitKey(30)
+const int UNPACED_TICK_MS = 30;
+
 /*
 * main
 * 
 * plays a game of cvpong using either color or motion for tracking the paddle
 * movements. If no command line arguments were entered, the user is prompted
-* for what type of tracking they would like to use: motion or color. 
+* for what type of tracking they would like to use: any of the trackings below. The
+* fastmove and fastcolor tracking run the fused pipeline versions of motion and color.
+* The hybrid tracking is color tracking which only segments the halves that moved.
+* Color tracking takes an optional profile name as the second argument; the
+* profile is calibrated on first use and loaded instantly after that. The
+* --recalibrate flag calibrates it automatically again, and --configure sets its
+* color by hand with scroll bars; either replaces the saved profile. With any
+* tracking, --broadcast <address> broadcasts the game state to spectators there.
+* The shared tracking takes the detections and frames from a detector service
+* running in another process instead of opening the camera. The bot tracking
+* needs no camera either, it plays both paddles itself.
+*
+* The camera trackings detect on a thread of their own. The game simulates each
+* tick without waiting for its detection, predicting the paddles, and rolls back
+* to correct the ticks a late detection disagrees with. The bot reads the board and
+* the shared tracking already waits on another process, so those two play in
+* lockstep with their detections.
 *
 */
 int main(int argc, char *argv[]) {
 
 	PaddleDetector* sherlock;
-	GameBoard pong;
+	Presenter *presenter = createPresenter("cvpong");
+	GameBoard pong(presenter);
 	Mat frame;
 	string tracking;
+	string profile = "default";
+	StatePublisher *publisher = nullptr;
+
+	// the flags may come anywhere, the other arguments are taken in order
+	ProfileMode profileMode = LOAD_PROFILE;
+	vector<string> args;
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if(arg == RECALIBRATE_FLAG) {
+			profileMode = RECALIBRATE_PROFILE;
+		} else if(arg == CONFIGURE_FLAG) {
+			profileMode = CONFIGURE_PROFILE;
+		} else if(arg == BROADCAST_FLAG && i + 1 < argc) {
+			delete publisher;
+			publisher = new StatePublisher(argv[++i]);
+		} else {
+			args.push_back(arg);
+		}
+	}
 
-	if(argc < 2) {
+	if(args.empty()) {
 		// no command line args, prompt for game type
-		cout << "Pick your method for motion tracking. Enter \"move\" or \"color\" to play." << endl;
+		cout << "Pick your method for motion tracking. Enter \"" << MPD_FLAG << "\", \"" << CPD_FLAG
+			 << "\", \"" << HPD_FLAG << "\", \"" << OFPD_FLAG << "\", \"" << FMPD_FLAG << "\", \""
+			 << FCPD_FLAG << "\", \"" << SPD_FLAG << "\" or \"" << BPD_FLAG << "\" to play." << endl;
 		cout << "tracking: ";
 		cin >> tracking;
 
-		if(tracking != CPD_FLAG) {
+		if(tracking != CPD_FLAG && tracking != OFPD_FLAG && tracking != FMPD_FLAG &&
+		   tracking != FCPD_FLAG && tracking != SPD_FLAG && tracking != HPD_FLAG &&
+		   tracking != BPD_FLAG) {
 			tracking = MPD_FLAG;
 		}
 	} else {
-		sscanf_s(argv[1], "%s", &tracking);
+		tracking = args[0];
+		if(args.size() > 1) {
+			profile = args[1];
+		}
 	}
 	cout << "Gametype = " << tracking;
 	cout << " ... initializing game ..." << endl;
 
+	// the detector service owns the camera when the detections are shared, and
+	// the bot plays without one
+	bool shared = tracking == SPD_FLAG;
+	bool bot = tracking == BPD_FLAG;
+
 	// get videofeed from computer's default camera and set the camer's FPS
-	VideoCapture cap(0);
-	cap.set(CV_CAP_PROP_FPS, 15);
+	VideoCapture cap;
+	if(!shared && !bot) {
+		cap.open(0);
+		cap.set(CV_CAP_PROP_FPS, 15);
 
-	// if camera is not on we will exit; cant play without video tracking
-	if(!cap.isOpened()) {
-		cout << "No camera has been detected, please connect one to play." << endl;
-		return(-1);
+		// if camera is not on we will exit; cant play without video tracking
+		if(!cap.isOpened()) {
+			cout << "No camera has been detected, please connect one to play." << endl;
+			delete publisher;
+			return(-1);
+		}
 	}
 
-	if(tracking == CPD_FLAG) {
-		sherlock = new ColorPaddleDetector(&cap);
+	if(shared) {
+		SharedPaddleDetector *reader = new SharedPaddleDetector();
+		if(!reader->isOpen()) {
+			cout << "No detector service is running, start one to play shared." << endl;
+			delete reader;
+			delete publisher;
+			return(-1);
+		}
+		sherlock = reader;
+	} else if(bot) {
+		sherlock = new BotPaddleDetector(&pong);
+	} else if(tracking == CPD_FLAG) {
+		sherlock = new ColorPaddleDetector(&cap, profile, profileMode);
+	} else if(tracking == HPD_FLAG) {
+		sherlock = new HybridPaddleDetector(&cap, profile, profileMode);
+	} else if(tracking == OFPD_FLAG) {
+		sherlock = new OpticalFlowPaddleDetector();
+	} else if(tracking == FMPD_FLAG) {
+		sherlock = new FusedMotionPaddleDetector(nullptr);
+	} else if(tracking == FCPD_FLAG) {
+		// the color is still calibrated and saved by the color detector
+		ColorPaddleDetector calibration(&cap, profile, profileMode);
+		pipeline::HsvInRange range(calibration.getLowBound(), calibration.getHighBound());
+		sherlock = new FusedColorPaddleDetector(nullptr, pipeline::ColorPipeline(pipeline::BgrToHsv(), range));
 	} else {
-		sherlock = new MotionPaddleDetector(&cap);
+		// each frame is compared with the one before, the game loop reads the camera
+		sherlock = new MotionPaddleDetector();
 	}
 
+	// steps detection quality down when detection runs over the frame budget. The
+	// camera is read before the time is taken, so only detection counts against it
+	FrameGovernor governor(sherlock->getSettings(), DEFAULT_FRAME_BUDGET_MS, sherlock->scansRoi());
+
+	// the results handed back by the detection thread, swapped into ready each tick
+	// so both keep their capacity, and the latest frame it detected, mirrored and
+	// marked, which the board is drawn over
+	bool lockstep = shared || bot;
+	mutex resultsMutex;
+	vector<PaddleResult> results;
+	vector<PaddleResult> ready;
+	Mat shown;
+	Mat background;
+	AsyncPaddleDetector *async = lockstep ? nullptr : new AsyncPaddleDetector(sherlock);
+
+	Trace::setThreadName("game");
+	uint64_t frameId = 0;
 	while(pong.gameOn()) {
-		cap >> frame;
-		sherlock->processFrame(frame);
-		pong.play(frame, sherlock->getLeftPaddleLoc(), sherlock->getRightPaddleLoc());
-		int key = waitKey(30);
+		chrono::steady_clock::time_point tickStart = chrono::steady_clock::now();
+		Trace::setFrame(frameId++);
+
+		if(!lockstep) {
+			{
+				TRACE_SCOPE("capture");
+				cap >> frame;
+			}
+			if(!frame.empty()) {
+				async->submit(frame, pong.getTick(), AsyncPaddleDetector::nowUs(),
+							  [&resultsMutex, &results](const PaddleResult &result) {
+					lock_guard<mutex> lock(resultsMutex);
+					results.push_back(result);
+				});
+			}
+
+			{
+				lock_guard<mutex> lock(resultsMutex);
+				ready.swap(results);
+			}
+			for(size_t i = 0; i < ready.size(); i++) {
+				const PaddleResult &result = ready[i];
+				if(result.skipped) continue;
+
+				// a paddle which was not seen is left to the board's prediction
+				if(result.left.found) pong.detect(result.frameId, IS_RED, result.left.pos);
+				if(result.right.found) pong.detect(result.frameId, IS_BLUE, result.right.pos);
+				shown = result.frame;
+
+				// from capture until detected, nothing else runs on the detection thread
+				if(governor.update(result.latencyUs / 1000.0)) {
+					async->setSettings(governor.getSettings());
+				}
+			}
+			ready.clear();
+
+			{
+				TRACE_SCOPE("play");
+				ALLOC_SCOPE("play");
+				if(shown.empty()) {
+					background = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+				} else {
+					// the board draws on its background, the frame is kept clean for the
+					// ticks until the next detection
+					shown.copyTo(background);
+				}
+				pong.advance();
+				pong.render(background);
+			}
+		} else {
+			if(bot) {
+				frame = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+			}
+
+			// time only our own work, not the wait for the camera or the keyboard
+			int64 start = getTickCount();
+			{
+				TRACE_SCOPE("processFrame");
+				ALLOC_SCOPE("processFrame");
+				sherlock->processFrame(frame);
+			}
+			if(frame.empty()) {
+				// the shared detector has not published a frame yet
+				frame = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+			}
+			{
+				TRACE_SCOPE("play");
+				ALLOC_SCOPE("play");
+				pong.play(frame, sherlock->getLeftPaddleLoc(), sherlock->getRightPaddleLoc());
+			}
+			double tickMs = (getTickCount() - start) * 1000.0 / getTickFrequency();
+			if(governor.update(tickMs)) {
+				sherlock->setSettings(governor.getSettings());
+			}
+		}
+
+		if(publisher != nullptr) {
+			publisher->publish(pong.getState());
+		}
+
+		// the camera sets the pace when there is one, waiting for its next frame. The
+		// bot has none and the shared game only waits on another process, so their
+		// ticks are held to at least UNPACED_TICK_MS
+		if(!cap.isOpened()) {
+			TRACE_SCOPE("pace");
+			this_thread::sleep_until(tickStart + chrono::milliseconds(UNPACED_TICK_MS));
+		}
+
+		// pump the window's events without sleeping
+		int key = presenter->pollKey();
 		if(key == 27) { break; } // If 'esc' key is pressed we'll quit
 	}
+	// the detection thread hands its last results to the queue above, stop it first
+	delete async;
 	cap.release();
 
+	if(Trace::enabled() && Trace::write(TRACE_FILE)) {
+		cout << "Wrote the timeline of the game to " << TRACE_FILE << endl;
+	}
+
+	if(AllocCounter::enabled()) {
+		cout << "heap allocations per stage:" << endl;
+		AllocCounter::report(cout);
+	}
+
 	// hold window until key press
-	waitKey(0);
+	presenter->pollKey(-1);
+	delete sherlock;
+	delete publisher;
+	delete presenter;
 	return(0);
 };
@@ -0,0 +1,83 @@
+/*
+* FrameGovernor class
+*
+* a class which keeps the time spent on each tick of the game within a budget by
+* stepping the detector settings down to cheaper levels when ticks run over the
+* budget and back up when there is headroom again.
+*
+*/
+#include <algorithm>
+#include "FrameGovernor.h"
+
+/*
+* FrameGovernor constructor
+*
+* preconditions:	budgetMs must be greater than 0
+* postconditions:	creates a governor at the full quality level which steps down
+*					from base, the settings the detector was tuned with. The last
+*					level, scanning only around the objects found, is left out
+*					unless scansRoi is set, it would change nothing.
+*/
+FrameGovernor::FrameGovernor(const DetectorSettings &base, double budgetMs, bool scansRoi) {
+	m_budgetMs = budgetMs;
+	m_level = 0;
+	m_overTicks = 0;
+	m_underTicks = 0;
+
+	// each level gives up a little more precision than the one before it
+	DetectorSettings settings = base;
+	m_levels.push_back(settings);
+
+	// smaller blur kernels
+	settings.gaussSize = std::min(settings.gaussSize, 5);
+	settings.blurSize = std::min(settings.blurSize, 6);
+	m_levels.push_back(settings);
+
+	// one gaussian blur instead of two
+	settings.gaussPasses = std::min(settings.gaussPasses, 1);
+	m_levels.push_back(settings);
+
+	// half the processing resolution
+	settings.scale = std::min(settings.scale, 0.5);
+	m_levels.push_back(settings);
+
+	// only scan around the objects found on the last frame
+	if(scansRoi) {
+		settings.roiOnly = true;
+		m_levels.push_back(settings);
+	}
+}
+
+/*
+* update
+*
+* preconditions:	tickMs must be the time spent on the last tick in milliseconds
+* postconditions:	steps the level down or up when enough ticks in a row were over
+*					the budget or under the headroom. returns true if the level changed.
+*/
+bool FrameGovernor::update(double tickMs) {
+	if(tickMs > m_budgetMs) {
+		m_overTicks++;
+		m_underTicks = 0;
+	} else if(tickMs * 100 < m_budgetMs * HEADROOM_PERCENT) {
+		m_underTicks++;
+		m_overTicks = 0;
+	} else {
+		// close to the budget, stay at this level
+		m_overTicks = 0;
+		m_underTicks = 0;
+	}
+
+	int last = static_cast<int>(m_levels.size()) - 1;
+	if(m_overTicks >= OVER_BUDGET_TICKS && m_level < last) {
+		m_level++;
+		m_overTicks = 0;
+		return(true);
+	}
+	if(m_underTicks >= UNDER_BUDGET_TICKS && m_level > 0) {
+		m_level--;
+		m_underTicks = 0;
+		return(true);
+	}
+	return(false);
+}
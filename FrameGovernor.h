@@ -0,0 +1,68 @@
+/*
+* FrameGovernor class
+*
+* a class which keeps the time spent on each tick of the game within a budget by
+* stepping the detector settings down to cheaper levels when ticks run over the
+* budget and back up when there is headroom again.
+*
+*/
+#ifndef FRAMEGOVERNOR_H
+#define FRAMEGOVERNOR_H
+#include "PaddleDetector.h"
+
+const double DEFAULT_FRAME_BUDGET_MS = 16.6;
+
+class FrameGovernor {
+	// ticks in a row over the budget before stepping down a level
+	static const int OVER_BUDGET_TICKS = 3;
+	// ticks in a row under the headroom before stepping back up a level
+	static const int UNDER_BUDGET_TICKS = 30;
+	// fraction of the budget a tick must stay under to count as headroom
+	static const int HEADROOM_PERCENT = 60;
+public:
+	/*
+	* FrameGovernor constructor
+	*
+	* preconditions:	budgetMs must be greater than 0
+	* postconditions:	creates a governor at the full quality level which steps down
+	*					from base, the settings the detector was tuned with. The last
+	*					level, scanning only around the objects found, is left out
+	*					unless scansRoi is set, it would change nothing.
+	*/
+	FrameGovernor(const DetectorSettings &base, double budgetMs = DEFAULT_FRAME_BUDGET_MS,
+				  bool scansRoi = true);
+
+	/*
+	* update
+	*
+	* preconditions:	tickMs must be the time spent on the last tick in milliseconds
+	* postconditions:	steps the level down or up when enough ticks in a row were over
+	*					the budget or under the headroom. returns true if the level changed.
+	*/
+	bool update(double tickMs);
+
+	/*
+	* getLevel
+	*
+	* preconditions:	none
+	* postconditions:	returns the current level, 0 being full quality
+	*/
+	int getLevel() const {return(m_level);}
+
+	/*
+	* getSettings
+	*
+	* preconditions:	none
+	* postconditions:	returns the detector settings of the current level
+	*/
+	const DetectorSettings &getSettings() const {return(m_levels[m_level]);}
+
+private:
+	vector<DetectorSettings> m_levels;
+	double m_budgetMs;
+	int m_level;
+	int m_overTicks;
+	int m_underTicks;
+};
+
+#endif
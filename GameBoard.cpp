@@ -7,6 +7,8 @@
 #ifndef GAMEBAORD_CPP
 #define GAMEBOARD_CPP
 #include "GameBoard.h"
+#include "AllocCounter.h"
+#include "Trace.h"
 
 /*
 * GameBall default constructor
@@ -35,16 +37,45 @@ void GameBoard::GameBall::move(double x, double y) {
 /*
 * GameBoard default constructor
 *
-* preconditions:	none
-* postconditions:	initializes game board to the default values
+* preconditions:	presenter must outlive the game board, or be nullptr
+* postconditions:	initializes game board to the default values. the gameboard is
+*					shown through presenter, or only drawn if presenter is nullptr.
 */
-GameBoard::GameBoard() {
+GameBoard::GameBoard(Presenter *presenter) {
+	m_presenter = presenter;
+	m_board = cv::Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+	m_scoreShown[0] = -1;
+	m_scoreShown[1] = -1;
+	m_tick = 0;
+	reset();
+}
+
+/*
+* reset
+*
+* starts a new game on the same gameboard. Ticks keep counting from the last game,
+* so a late detection from it is not applied to the new one.
+*
+* preconditions:	speedFactor must not be negative
+* postconditions:	sets the score to 0 - 0, centers the ball and paddles and serves
+*					the ball at the speed of speedFactor
+*/
+void GameBoard::reset(double speedFactor) {
 	m_gameOn = true;
 	m_score[0] = 0;
 	m_score[1] = 0;
-	m_speedFactor = 0;
-	m_board = cv::Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+	m_speedFactor = speedFactor;
+	m_ball = GameBall();
+	m_ball.move(MOVE_RIGHT + m_speedFactor, MOVE_HORIZ);
 	initPaddles();
+
+	m_historyStart = 0;
+	m_historySize = 0;
+	for(int side = 0; side < 2; side++) {
+		m_nextInput[side] = 0;
+		m_nextDetected[side] = false;
+		m_detections[side] = 0;
+	}
 }
 
 /*
@@ -60,41 +91,279 @@ bool GameBoard::gameOn() {
 }
 
 
+/*
+* getState
+*
+* preconditions:	none
+* postconditions:	returns the positions of the ball and paddles, the ball's movement,
+*					the score and the status of the game
+*/
+GameState GameBoard::getState() const {
+	GameState state;
+	state.ballX = m_ball.m_Xpos;
+	state.ballY = m_ball.m_Ypos;
+	state.ballXmov = m_ball.m_Xmov;
+	state.ballYmov = m_ball.m_Ymov;
+	state.leftPaddleY = m_leftPaddle.m_Ypos;
+	state.rightPaddleY = m_rightPaddle.m_Ypos;
+	state.score[0] = m_score[0];
+	state.score[1] = m_score[1];
+	state.gameOn = m_gameOn;
+	return(state);
+}
+
 /*
 * play
 *
 * preconditions:	background must be a valid Mat object not equal to nullptr.
 * postconditions:	sets the background image to background. sets the left and right
-*					paddles to the passed in values. displays the gameboard.
+*					paddles to the passed in values. displays the gameboard through
+*					the presenter.
 */
 void GameBoard::play(const Mat& background, int leftPaddlePos, int rightPaddleLoc) {
 	m_board = background;
-	setLeftPaddle(leftPaddlePos);
-	setRightPaddle(rightPaddleLoc);
+	detect(m_tick, false, leftPaddlePos);
+	detect(m_tick, true, rightPaddleLoc);
+	advance();
+	render(background);
+}
+
+/*
+* detect
+*
+* records the detected position of a paddle in the frame of tick. A detection of a
+* tick which was already simulated on a predicted position that turns out wrong
+* rolls the game back to that tick and simulates it again up to the current tick,
+* so collisions are decided on where the paddle really was.
+*
+* preconditions:	none
+* postconditions:	returns true if the detection was used, false if tick is older
+*					than the history or newer than the next tick
+*/
+bool GameBoard::detect(uint64_t tick, bool isRight, int y) {
+	int side = isRight ? 1 : 0;
+	if(tick > m_tick || m_tick - tick > m_historySize) {
+		return(false);
+	}
+	noteDetection(side, tick, y);
+
+	if(tick == m_tick) {
+		m_nextInput[side] = y;
+		m_nextDetected[side] = true;
+		return(true);
+	}
+
+	size_t first = m_historySize - static_cast<size_t>(m_tick - tick);
+	TickRecord &late = history(first);
+	late.detected[side] = true;
+	if(late.input[side] == y) {
+		// the prediction was right, nothing to correct
+		return(true);
+	}
+	late.input[side] = y;
+
+	// roll back to the tick and simulate forward again, predicting the paddles which
+	// are still not detected from the corrected detections
+	TRACE_SCOPE("board.resimulate");
+	restore(late.before);
+	for(size_t i = first; i < m_historySize; i++) {
+		TickRecord &record = history(i);
+		uint64_t recordTick = m_tick - (m_historySize - i);
+		record.before = snapshot();
+		for(int s = 0; s < 2; s++) {
+			if(!record.detected[s]) {
+				record.input[s] = predict(s == 1, recordTick);
+			}
+		}
+		step(record.input[0], record.input[1]);
+	}
+	return(true);
+}
+
+/*
+* advance
+*
+* simulates one tick. The paddles which have not been detected for the tick are
+* moved to where their last detections predict them to be.
+*
+* preconditions:	none
+* postconditions:	returns the tick simulated
+*/
+uint64_t GameBoard::advance() {
+	TRACE_SCOPE("board.simulate");
+	TickRecord record;
+	record.before = snapshot();
+	for(int side = 0; side < 2; side++) {
+		record.detected[side] = m_nextDetected[side];
+		record.input[side] = m_nextDetected[side] ? m_nextInput[side] : predict(side == 1, m_tick);
+		m_nextDetected[side] = false;
+	}
+	step(record.input[0], record.input[1]);
+
+	// the oldest tick makes way for this one once the history is full
+	if(m_historySize == static_cast<size_t>(HISTORY_TICKS)) {
+		m_historyStart = (m_historyStart + 1) % HISTORY_TICKS;
+		m_historySize--;
+	}
+	history(m_historySize++) = record;
+	return(m_tick++);
+}
+
+/*
+* render
+*
+* preconditions:	background must be a valid Mat object the size of the gameboard
+* postconditions:	draws the paddles, score and ball on background and displays the
+*					gameboard through the presenter
+*/
+void GameBoard::render(const Mat& background) {
+	m_board = background;
+	{
+		TRACE_SCOPE("board.draw");
+		ALLOC_SCOPE("draw");
+		drawPaddles();
+		drawScore();
+		drawBall();
+	}
+	if(m_presenter != nullptr) {
+		TRACE_SCOPE("present");
+		ALLOC_SCOPE("present");
+		m_presenter->present(m_board);
+	}
+}
+
+/*
+* step
+*
+* preconditions:	none
+* postconditions:	simulates one tick with the paddles at leftY and rightY
+*/
+void GameBoard::step(int leftY, int rightY) {
+	setLeftPaddle(leftY);
+	setRightPaddle(rightY);
 	setScore();
-	setBall();
-	namedWindow("cvpong");
-	imshow("cvpong", m_board);
+	moveBall();
 }
 
 /*
-* setBall
+* predict
 *
-* draws the ball on the gameboard
+* preconditions:	none
+* postconditions:	returns where the paddle indicated by isRight is expected to be at
+*					tick, extrapolated from its last two detections
+*/
+int GameBoard::predict(bool isRight, uint64_t tick) const {
+	int side = isRight ? 1 : 0;
+	if(m_detections[side] == 0) {
+		return(isRight ? m_rightPaddle.m_Ypos : m_leftPaddle.m_Ypos);
+	}
+
+	const Detection &latest = m_latest[side];
+	if(m_detections[side] == 1) {
+		return(latest.y);
+	}
+
+	// move on at the speed between the last two detections, but not for long as
+	// players change direction
+	const Detection &previous = m_previous[side];
+	double speed = static_cast<double>(latest.y - previous.y) / static_cast<double>(latest.tick - previous.tick);
+	double ahead = static_cast<double>(tick) - static_cast<double>(latest.tick);
+	ahead = std::min(ahead, static_cast<double>(MAX_PREDICT_TICKS));
+	return(latest.y + cvRound(speed * ahead));
+}
+
+/*
+* noteDetection
 *
 * preconditions:	none
-* postconditions:	sets game ball to the default values
+* postconditions:	keeps the detection if it is one of the last two of side
 */
-void GameBoard::setBall() {	
+void GameBoard::noteDetection(int side, uint64_t tick, int y) {
+	Detection detection = {tick, y};
+	if(m_detections[side] == 0 || tick > m_latest[side].tick) {
+		m_previous[side] = m_latest[side];
+		m_latest[side] = detection;
+		m_detections[side] = std::min(m_detections[side] + 1, 2);
+	} else if(tick == m_latest[side].tick) {
+		m_latest[side].y = y;
+	} else if(m_detections[side] == 1 || tick >= m_previous[side].tick) {
+		m_previous[side] = detection;
+		m_detections[side] = 2;
+	}
+}
+
+/*
+* snapshot
+*
+* preconditions:	none
+* postconditions:	returns the state the simulation of a tick changes
+*/
+GameBoard::GameSnapshot GameBoard::snapshot() const {
+	GameSnapshot snapshot;
+	snapshot.ball = m_ball;
+	snapshot.leftPaddle = m_leftPaddle;
+	snapshot.rightPaddle = m_rightPaddle;
+	snapshot.gameOn = m_gameOn;
+	snapshot.score[0] = m_score[0];
+	snapshot.score[1] = m_score[1];
+	snapshot.speedFactor = m_speedFactor;
+	return(snapshot);
+}
+
+/*
+* restore
+*
+* preconditions:	snapshot must have been taken of this gameboard
+* postconditions:	puts the game back in the state of snapshot
+*/
+void GameBoard::restore(const GameSnapshot &snapshot) {
+	m_ball = snapshot.ball;
+	m_leftPaddle = snapshot.leftPaddle;
+	m_rightPaddle = snapshot.rightPaddle;
+	m_gameOn = snapshot.gameOn;
+	m_score[0] = snapshot.score[0];
+	m_score[1] = snapshot.score[1];
+	m_speedFactor = snapshot.speedFactor;
+}
+
+/*
+* moveBall
+*
+* preconditions:	none
+* postconditions:	moves the ball one tick, bouncing it off of what it collides with
+*/
+void GameBoard::moveBall() {
 	checkCollisions();
 	m_ball.m_Ypos += m_ball.m_Ymov;
 	m_ball.m_Xpos += m_ball.m_Xmov;
+}
+
+/*
+* drawBall
+*
+* preconditions:	none
+* postconditions:	draws the ball on the gameboard
+*/
+void GameBoard::drawBall() {
+	fillRect(m_board, Rect(m_ball.m_Xpos, m_ball.m_Ypos, BALL_SIZE, BALL_SIZE), BALL_COLOR);
+}
 
-	for(int i = m_ball.m_Ypos; i < m_ball.m_Ypos + BALL_SIZE; i++) {
-		for(int j = m_ball.m_Xpos; j < m_ball.m_Xpos + BALL_SIZE; j++) {
-			m_board.at<Vec3b>(i, j)[0] = BALL_COLOR[0];
-			m_board.at<Vec3b>(i, j)[1] = BALL_COLOR[1];
-			m_board.at<Vec3b>(i, j)[2] = BALL_COLOR[2];
+/*
+* fillRect
+*
+* fills a rectangle of the gameboard with a color pixel by pixel, the way the ball
+* and paddles are drawn
+*
+* preconditions:	board must be a BGR image containing rect. color must hold the
+*					blue, green and red values.
+* postconditions:	sets every pixel of rect in board to color
+*/
+void GameBoard::fillRect(Mat &board, const Rect &rect, const int color[3]) {
+	for(int i = rect.y; i < rect.y + rect.height; i++) {
+		for(int j = rect.x; j < rect.x + rect.width; j++) {
+			board.at<Vec3b>(i, j)[0] = color[0];
+			board.at<Vec3b>(i, j)[1] = color[1];
+			board.at<Vec3b>(i, j)[2] = color[2];
 		}
 	}
 }
@@ -171,7 +440,7 @@ void GameBoard::checkCollisions() {
 * setLeftPaddle
 *
 * preconditions:	none
-* postconditions:	draws the left paddle on the gameboard
+* postconditions:	moves the left paddle to y, kept inside of the gameboard
 */
 void GameBoard::setLeftPaddle(int y) {
 	// check if new location is in bounds
@@ -182,22 +451,13 @@ void GameBoard::setLeftPaddle(int y) {
 	} else {
 		m_leftPaddle.m_Ypos = y;
 	}
-
-	// set paddle at new location
-	for(int i = m_leftPaddle.m_Ypos; i <m_leftPaddle.m_Ypos + PADDLE_Y; i++) {
-		for(int j = m_leftPaddle.m_Xpos; j < m_leftPaddle.m_Xpos + PADDLE_X; j++) {
-			m_board.at<Vec3b>(i, j)[0] = L_PADDLE_COLOR[0];
-			m_board.at<Vec3b>(i, j)[1] = L_PADDLE_COLOR[1];
-			m_board.at<Vec3b>(i, j)[2] = L_PADDLE_COLOR[2];
-		}
-	}
 }
 
 /*
 * setRightPaddle
 *
 * preconditions:	none
-* postconditions:	draws the right paddle on the gameboard
+* postconditions:	moves the right paddle to y, kept inside of the gameboard
 */
 void GameBoard::setRightPaddle(int y) {
 	// check if new location is in bounds
@@ -208,15 +468,17 @@ void GameBoard::setRightPaddle(int y) {
 	} else {
 		m_rightPaddle.m_Ypos = y;
 	}
+}
 
-	// set paddle at new location
-	for(int i = m_rightPaddle.m_Ypos; i <m_rightPaddle.m_Ypos + PADDLE_Y; i++) {
-		for(int j = m_rightPaddle.m_Xpos; j < m_rightPaddle.m_Xpos + PADDLE_X; j++) {
-			m_board.at<Vec3b>(i, j)[0] = R_PADDLE_COLOR[0];
-			m_board.at<Vec3b>(i, j)[1] = R_PADDLE_COLOR[1];
-			m_board.at<Vec3b>(i, j)[2] = R_PADDLE_COLOR[2];
-		}
-	}
+/*
+* drawPaddles
+*
+* preconditions:	none
+* postconditions:	draws the left and right paddles on the gameboard
+*/
+void GameBoard::drawPaddles() {
+	fillRect(m_board, Rect(m_leftPaddle.m_Xpos, m_leftPaddle.m_Ypos, PADDLE_X, PADDLE_Y), L_PADDLE_COLOR);
+	fillRect(m_board, Rect(m_rightPaddle.m_Xpos, m_rightPaddle.m_Ypos, PADDLE_X, PADDLE_Y), R_PADDLE_COLOR);
 }
 
 /*
@@ -237,22 +499,92 @@ void GameBoard::initPaddles() {
 * setScore
 *
 * preconditions:	none
-* postconditions:	draws the score on the gameboard and displays the winner when necessary
+* postconditions:	ends the game when a player has won
 */
 void GameBoard::setScore() {
-	std::string score = "";
-	if(m_score[0] >= WINNING_SCORE) {
-		score = "PLAYER 1 WINS!";
-		putText(m_board, score, cvPoint((DEFAULT_X / 2) - 143, BOARDER_WIDTH * 15), FONT_HERSHEY_COMPLEX_SMALL, 1.5, cvScalar(255, 0, 255), 1, CV_AA);
-		m_gameOn = false;
-	} else if(m_score[1] >= WINNING_SCORE) {
-		score = "PLAYER 2 WINS!";
-		putText(m_board, score, cvPoint((DEFAULT_X / 2) - 143, BOARDER_WIDTH * 15), FONT_HERSHEY_COMPLEX_SMALL, 1.5, cvScalar(255, 0, 255), 1, CV_AA);
+	if(m_score[0] >= WINNING_SCORE || m_score[1] >= WINNING_SCORE) {
 		m_gameOn = false;
+	}
+}
+
+/*
+* drawScore
+*
+* preconditions:	none
+* postconditions:	draws the score on the gameboard and displays the winner when necessary
+*/
+void GameBoard::drawScore() {
+	if(m_score[0] != m_scoreShown[0] || m_score[1] != m_scoreShown[1]) {
+		renderScore(m_score, m_scoreMask, m_scoreRect);
+		m_scoreShown[0] = m_score[0];
+		m_scoreShown[1] = m_score[1];
+	}
+	blendScore(m_board, m_scoreMask, m_scoreRect);
+}
+
+/*
+* renderScore
+*
+* renders the text of score, or of the winner, antialiased into a coverage mask so
+* it can be drawn on many boards without being rendered again
+*
+* preconditions:	none
+* postconditions:	sets mask to the coverage (0 - 255) of each pixel by the text and
+*					rect to where mask belongs on the gameboard
+*/
+void GameBoard::renderScore(const int score[2], Mat &mask, Rect &rect) {
+	const int font = FONT_HERSHEY_COMPLEX_SMALL;
+	const double fontScale = 1.5;
+	const int thickness = 1;
+
+	std::string text = "";
+	Point origin;
+	if(score[0] >= WINNING_SCORE) {
+		text = "PLAYER 1 WINS!";
+		origin = Point((DEFAULT_X / 2) - 143, BOARDER_WIDTH * 15);
+	} else if(score[1] >= WINNING_SCORE) {
+		text = "PLAYER 2 WINS!";
+		origin = Point((DEFAULT_X / 2) - 143, BOARDER_WIDTH * 15);
 	} else {
-		score = to_string(m_score[0]);
-		score += " | " + to_string(m_score[1]);
-		putText(m_board, score, cvPoint((DEFAULT_X / 2) - 41, BOARDER_WIDTH * 15), FONT_HERSHEY_COMPLEX_SMALL, 1.5, cvScalar(255, 0, 255), 1, CV_AA);
+		text = to_string(score[0]);
+		text += " | " + to_string(score[1]);
+		origin = Point((DEFAULT_X / 2) - 41, BOARDER_WIDTH * 15);
+	}
+
+	// leave room around the text for the strokes, and their antialiased edges, which
+	// overhang its box
+	int baseline = 0;
+	Size textSize = getTextSize(text, font, fontScale, thickness, &baseline);
+	int margin = thickness + 2;
+	rect = Rect(origin.x - margin, origin.y - textSize.height - margin,
+				textSize.width + margin * 2, textSize.height + baseline + margin * 2);
+
+	// white antialiased text on black leaves the coverage of each pixel in the mask
+	mask.create(rect.height, rect.width, CV_8UC1);
+	mask.setTo(Scalar(0));
+	putText(mask, text, Point(margin, textSize.height + margin), font, fontScale, Scalar(255), thickness, CV_AA);
+}
+
+/*
+* blendScore
+*
+* preconditions:	mask and rect must have been set by renderScore. board must be a
+*					BGR image.
+* postconditions:	blends SCORE_COLOR into the part of rect inside of board by the
+*					coverage of mask
+*/
+void GameBoard::blendScore(Mat &board, const Mat &mask, const Rect &rect) {
+	Rect onBoard = rect & Rect(0, 0, board.cols, board.rows);
+	for(int y = onBoard.y; y < onBoard.y + onBoard.height; y++) {
+		const uchar *coverage = mask.ptr<uchar>(y - rect.y);
+		Vec3b *pixel = board.ptr<Vec3b>(y);
+		for(int x = onBoard.x; x < onBoard.x + onBoard.width; x++) {
+			int alpha = coverage[x - rect.x];
+			if(alpha == 0) continue;
+			for(int c = 0; c < 3; c++) {
+				pixel[x][c] = static_cast<uchar>((pixel[x][c] * (255 - alpha) + SCORE_COLOR[c] * alpha + 127) / 255);
+			}
+		}
 	}
 }
 
@@ -4,13 +4,16 @@
 * a class representing a cvpong gameboard
 *
 */
-#ifndef GAMEBAORD_H
+#ifndef GAMEBOARD_H
 #define GAMEBOARD_H
 #include <time.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <iostream>
+#include <deque>
+#include <stdint.h>
+#include "Presenter.h"
 using namespace cv;
 using namespace std;
 
@@ -24,6 +27,11 @@ const int PADDLE_MOD = PADDLE_Y / 3;
 const int WINNING_SCORE = 7;
 const double SPEED_INCREMENT = 1.5;
 
+// ticks of game state kept to roll back to when a late detection arrives
+const int HISTORY_TICKS = 8;
+// how far ahead a paddle's motion is extrapolated from its last detections
+const int MAX_PREDICT_TICKS = 4;
+
 const int MOVE_LEFT = -11;
 const int MOVE_RIGHT = 11;
 const int MOVE_UP = -11;
@@ -34,6 +42,23 @@ const int BOARDER_COLOR[3] = {0, 153, 0};
 const int BALL_COLOR[3] = {0, 204, 0};
 const int L_PADDLE_COLOR[3] = {0 , 0, 255}; /* red paddle */
 const int R_PADDLE_COLOR[3] = {255, 0, 0}; /* blue paddle */
+const int SCORE_COLOR[3] = {255, 0, 255};
+
+/*
+* GameState
+*
+* the state of a game which is visible to a spectator
+*/
+struct GameState {
+	int ballX;
+	int ballY;
+	int ballXmov;
+	int ballYmov;
+	int leftPaddleY;
+	int rightPaddleY;
+	int score[2];
+	bool gameOn;
+};
 
 
 class GameBoard {
@@ -41,10 +66,11 @@ public:
 	/*
 	* GameBoard default constructor
 	*
-	* preconditions:	none
-	* postconditions:	initializes game board to the default values
+	* preconditions:	presenter must outlive the game board, or be nullptr
+	* postconditions:	initializes game board to the default values. the gameboard is
+	*					shown through presenter, or only drawn if presenter is nullptr.
 	*/
-	GameBoard();
+	GameBoard(Presenter *presenter = nullptr);
 
 	/*
 	* gameOn
@@ -61,22 +87,132 @@ public:
 	*
 	* preconditions:	background must be a valid Mat object not equal to nullptr.
 	* postconditions:	sets the background image to background. sets the left and right
-	*					paddles to the passed in values. displays the gameboard.
+	*					paddles to the passed in values. displays the gameboard through
+	*					the presenter.
 	*/
 	void play(const Mat& background, int leftPaddlePos, int rightPaddleLoc);
 
-private:
-	void displayBall();
+	/*
+	* detect
+	*
+	* records the detected position of a paddle in the frame of tick. A detection of a
+	* tick which was already simulated on a predicted position that turns out wrong
+	* rolls the game back to that tick and simulates it again up to the current tick,
+	* so collisions are decided on where the paddle really was.
+	*
+	* preconditions:	none
+	* postconditions:	returns true if the detection was used, false if tick is older
+	*					than the history or newer than the next tick
+	*/
+	bool detect(uint64_t tick, bool isRight, int y);
+
+	/*
+	* advance
+	*
+	* simulates one tick. The paddles which have not been detected for the tick are
+	* moved to where their last detections predict them to be.
+	*
+	* preconditions:	none
+	* postconditions:	returns the tick simulated
+	*/
+	uint64_t advance();
 
 	/*
-	* setBall
+	* render
 	*
-	* draws the ball on the gameboard
+	* preconditions:	background must be a valid Mat object the size of the gameboard
+	* postconditions:	draws the paddles, score and ball on background and displays the
+	*					gameboard through the presenter
+	*/
+	void render(const Mat& background);
+
+	/*
+	* getTick
 	*
 	* preconditions:	none
-	* postconditions:	sets game ball to the default values
+	* postconditions:	returns the next tick to be simulated
 	*/
-	void setBall();
+	uint64_t getTick() const {return(m_tick);}
+
+	/*
+	* fillRect
+	*
+	* fills a rectangle of the gameboard with a color pixel by pixel, the way the ball
+	* and paddles are drawn
+	*
+	* preconditions:	board must be a BGR image containing rect. color must hold the
+	*					blue, green and red values.
+	* postconditions:	sets every pixel of rect in board to color
+	*/
+	static void fillRect(Mat &board, const Rect &rect, const int color[3]);
+
+	/*
+	* renderScore
+	*
+	* renders the text of score, or of the winner, antialiased into a coverage mask so
+	* it can be drawn on many boards without being rendered again
+	*
+	* preconditions:	none
+	* postconditions:	sets mask to the coverage (0 - 255) of each pixel by the text and
+	*					rect to where mask belongs on the gameboard
+	*/
+	static void renderScore(const int score[2], Mat &mask, Rect &rect);
+
+	/*
+	* blendScore
+	*
+	* preconditions:	mask and rect must have been set by renderScore. board must be a
+	*					BGR image.
+	* postconditions:	blends SCORE_COLOR into the part of rect inside of board by the
+	*					coverage of mask
+	*/
+	static void blendScore(Mat &board, const Mat &mask, const Rect &rect);
+
+	/*
+	* getBoard
+	*
+	* preconditions:	none
+	* postconditions:	returns the gameboard drawn by the last play or render
+	*/
+	const Mat &getBoard() const {return(m_board);}
+
+	/*
+	* getState
+	*
+	* preconditions:	none
+	* postconditions:	returns the positions of the ball and paddles, the ball's movement,
+	*					the score and the status of the game
+	*/
+	GameState getState() const;
+
+	/*
+	* reset
+	*
+	* starts a new game on the same gameboard. Ticks keep counting from the last game,
+	* so a late detection from it is not applied to the new one.
+	*
+	* preconditions:	speedFactor must not be negative
+	* postconditions:	sets the score to 0 - 0, centers the ball and paddles and serves
+	*					the ball at the speed of speedFactor
+	*/
+	void reset(double speedFactor = 0);
+
+private:
+	/*
+	* moveBall
+	*
+	* preconditions:	none
+	* postconditions:	moves the ball one tick, bouncing it off of what it collides with
+	*/
+	void moveBall();
+
+	/*
+	* drawBall
+	*
+	* preconditions:	none
+	* postconditions:	draws the ball on the gameboard
+	*/
+	void drawBall();
 
 	/*
 	* checkCollisions
@@ -94,7 +230,7 @@ private:
 	* setLeftPaddle
 	*
 	* preconditions:	none
-	* postconditions:	draws the left paddle on the gameboard
+	* postconditions:	moves the left paddle to y, kept inside of the gameboard
 	*/
 	void setLeftPaddle(int y);
 
@@ -102,10 +238,18 @@ private:
 	* setRightPaddle
 	*
 	* preconditions:	none
-	* postconditions:	draws the right paddle on the gameboard
+	* postconditions:	moves the right paddle to y, kept inside of the gameboard
 	*/
 	void setRightPaddle(int y);
 
+	/*
+	* drawPaddles
+	*
+	* preconditions:	none
+	* postconditions:	draws the left and right paddles on the gameboard
+	*/
+	void drawPaddles();
+
 	/*
 	* initPaddles
 	*
@@ -118,10 +262,35 @@ private:
 	* setScore
 	*
 	* preconditions:	none
-	* postconditions:	draws the score on the gameboard and displays the winner when necessary
+	* postconditions:	ends the game when a player has won
 	*/
 	void setScore();
 
+	/*
+	* drawScore
+	*
+	* preconditions:	none
+	* postconditions:	draws the score on the gameboard and displays the winner when necessary
+	*/
+	void drawScore();
+
+	/*
+	* step
+	*
+	* preconditions:	none
+	* postconditions:	simulates one tick with the paddles at leftY and rightY
+	*/
+	void step(int leftY, int rightY);
+
+	/*
+	* predict
+	*
+	* preconditions:	none
+	* postconditions:	returns where the paddle indicated by isRight is expected to be at
+	*					tick, extrapolated from its last two detections
+	*/
+	int predict(bool isRight, uint64_t tick) const;
+
 	struct GameBall {
 		/*
 		* GameBall default constructor
@@ -150,6 +319,54 @@ private:
 		int m_Ypos;
 	};
 
+	/*
+	* GameSnapshot
+	*
+	* everything the simulation of a tick changes
+	*/
+	struct GameSnapshot {
+		GameBall ball;
+		Paddle leftPaddle;
+		Paddle rightPaddle;
+		bool gameOn;
+		int score[2];
+		double speedFactor;
+	};
+
+	/*
+	* TickRecord
+	*
+	* a simulated tick: the state before it and the paddle positions it was simulated
+	* with, detected or predicted
+	*/
+	struct TickRecord {
+		GameSnapshot before;
+		int input[2];
+		bool detected[2];
+	};
+
+	/*
+	* Detection
+	*
+	* a detected paddle position and the tick it was detected in
+	*/
+	struct Detection {
+		uint64_t tick;
+		int y;
+	};
+
+	GameSnapshot snapshot() const;
+	void restore(const GameSnapshot &snapshot);
+	void noteDetection(int side, uint64_t tick, int y);
+
+	/*
+	* history
+	*
+	* preconditions:	i must be less than m_historySize
+	* postconditions:	returns the record of the ith oldest tick in the history
+	*/
+	TickRecord &history(size_t i) {return(m_history[(m_historyStart + i) % HISTORY_TICKS]);}
+
 	GameBall m_ball;
 	Paddle m_leftPaddle;
 	Paddle m_rightPaddle;
@@ -157,5 +374,29 @@ private:
 	int m_score[2];
 	double m_speedFactor;
 	Mat m_board;
+	Presenter *m_presenter;
+
+	// the score text is only rendered when the score changes, the mask of its pixels
+	// is drawn on every board after that
+	int m_scoreShown[2];
+	Mat m_scoreMask;
+	Rect m_scoreRect;
+
+	// the next tick to be simulated and the ticks simulated before it, oldest first.
+	// the history is a ring of m_historySize records from m_historyStart on, so a
+	// steady game does not allocate a record per tick
+	uint64_t m_tick;
+	TickRecord m_history[HISTORY_TICKS];
+	size_t m_historyStart;
+	size_t m_historySize;
+
+	// the paddle positions detected for the next tick so far
+	int m_nextInput[2];
+	bool m_nextDetected[2];
+
+	// the last two detections of each paddle, which its motion is predicted from
+	Detection m_latest[2];
+	Detection m_previous[2];
+	int m_detections[2];
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+* HighguiPresenter class
+*
+* a presenter which shows the gameboard in a highgui window. highgui copies the
+* frame and can only pump events while waiting at least a millisecond in waitKey.
+*
+*/
+#include <opencv2/highgui/highgui.hpp>
+#include "HighguiPresenter.h"
+
+/*
+* HighguiPresenter constructor
+*
+* preconditions:	none
+* postconditions:	creates a highgui window called title
+*/
+HighguiPresenter::HighguiPresenter(const string &title) {
+	m_title = title;
+	namedWindow(m_title);
+}
+
+/*
+* HighguiPresenter destructor
+*
+* preconditions:	none
+* postconditions:	destroys the window
+*/
+HighguiPresenter::~HighguiPresenter() {
+	destroyWindow(m_title);
+}
+
+/*
+* present
+*
+* preconditions:	frame must be a BGR image
+* postconditions:	shows frame in the window
+*/
+void HighguiPresenter::present(const Mat &frame) {
+	imshow(m_title, frame);
+}
+
+/*
+* pollKey
+*
+* preconditions:	none
+* postconditions:	handles the window's pending events and returns the key pressed,
+*					or -1 if none was. waits at least 1 ms, as waitKey(0) would wait
+*					forever, and a negative waitMs waits until a key is pressed.
+*/
+int HighguiPresenter::pollKey(int waitMs) {
+	return(waitKey(waitMs < 0 ? 0 : std::max(waitMs, 1)));
+}
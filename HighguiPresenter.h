@@ -0,0 +1,52 @@
+/*
+* HighguiPresenter class
+*
+* a presenter which shows the gameboard in a highgui window. highgui copies the
+* frame and can only pump events while waiting at least a millisecond in waitKey.
+*
+*/
+#ifndef HIGHGUIPRESENTER_H
+#define HIGHGUIPRESENTER_H
+#include "Presenter.h"
+
+class HighguiPresenter : public Presenter {
+public:
+	/*
+	* HighguiPresenter constructor
+	*
+	* preconditions:	none
+	* postconditions:	creates a highgui window called title
+	*/
+	HighguiPresenter(const string &title);
+
+	/*
+	* HighguiPresenter destructor
+	*
+	* preconditions:	none
+	* postconditions:	destroys the window
+	*/
+	~HighguiPresenter();
+
+	/*
+	* present
+	*
+	* preconditions:	frame must be a BGR image
+	* postconditions:	shows frame in the window
+	*/
+	void present(const Mat &frame);
+
+	/*
+	* pollKey
+	*
+	* preconditions:	none
+	* postconditions:	handles the window's pending events and returns the key pressed,
+	*					or -1 if none was. waits at least 1 ms, as waitKey(0) would wait
+	*					forever, and a negative waitMs waits until a key is pressed.
+	*/
+	int pollKey(int waitMs = 0);
+
+private:
+	string m_title;
+};
+
+#endif
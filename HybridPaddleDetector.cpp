@@ -0,0 +1,87 @@
+/*
+* HybridPaddleDetector class
+*
+* a color detector which only segments the zones where something moved. A cheap
+* motion check on a downsampled grayscale frame decides which zones changed since
+* the last frame, and the HSV conversion and blurs of the color detector only run
+* on those.
+*
+*/
+#include <algorithm>
+#include "HybridPaddleDetector.h"
+#include "Trace.h"
+
+/*
+* HybridPaddleDetector constructor
+*
+* preconditions:	vid must be a valid VideoCapture object point not equal to
+*					nullptr
+* postconditions:	sets the left and right paddles equal to the default position
+*					and loads, or calibrates as mode asks, the tracking color of profile
+*/
+HybridPaddleDetector::HybridPaddleDetector(VideoCapture *vid, const string &profile, ProfileMode mode)
+	: ColorPaddleDetector(vid, profile, mode) {
+}
+
+/*
+* clone
+*
+* preconditions:	none
+* postconditions:	returns a new detector with the same settings, color and zones which
+*					has processed no frames
+*/
+PaddleDetector *HybridPaddleDetector::clone() const {
+	HybridPaddleDetector *copy = new HybridPaddleDetector(*this);
+	copy->resetZones();
+	copy->m_lastGray.release();
+	copy->m_gray.release();
+	copy->m_small.release();
+	copy->m_diff.release();
+	return(copy);
+}
+
+/*
+* processFrame
+*
+* checks each zone of frame for motion and tracks the configured color only in the
+* zones which moved. Every zone is tracked on the first frame.
+*
+* preconditions:	frame must be a valid Mat object representing a single frame from
+*					from a VideoCapture object
+* postconditions:	sets the position of each zone which moved according to color
+*					detected in it, the first two zones being the left and right paddles
+*/
+void HybridPaddleDetector::processFrame(Mat &frame) {
+	// the gray frame of the frame before last is reused as the buffer of this one
+	swap(m_gray, m_lastGray);
+	Mat &gray = m_gray;
+	Mat &diff = m_diff;
+
+	{
+		TRACE_SCOPE("hybrid.gray");
+		flip(frame, frame, 1);
+
+		// shrink before converting, the motion check only needs a rough picture
+		resize(frame, m_small, Size(frame.cols / MOTION_DOWNSAMPLE, frame.rows / MOTION_DOWNSAMPLE), 0, 0, INTER_AREA);
+		cvtColor(m_small, gray, COLOR_BGR2GRAY);
+	}
+
+	vector<Rect> &zones = m_motionZones;
+	zoneRects(gray.size(), zones);
+	m_moved.assign(zones.size(), true);
+
+	if(m_lastGray.size() == gray.size()) {
+		TRACE_SCOPE("hybrid.motion");
+		absdiff(gray, m_lastGray, diff);
+		threshold(diff, diff, m_settings.thresholdSensitivity, 255, THRESH_BINARY);
+
+		for(size_t i = 0; i < zones.size(); i++) {
+			m_moved[i] = zones[i].area() > 0 && countNonZero(Mat(diff, zones[i])) >= MOTION_MIN_PIXELS;
+		}
+	}
+
+	// nothing moved anywhere, every zone keeps its position
+	if(std::find(m_moved.begin(), m_moved.end(), true) == m_moved.end()) return;
+
+	segmentZones(frame, m_moved);
+}
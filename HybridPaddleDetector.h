@@ -0,0 +1,80 @@
+/*
+* HybridPaddleDetector class
+*
+* a color detector which only segments the zones where something moved. A cheap
+* motion check on a downsampled grayscale frame decides which zones changed since
+* the last frame, and the HSV conversion and blurs of the color detector only run
+* on those. Zones where nothing moved keep their last position, so a player
+* standing still between rallies costs almost nothing.
+*
+*/
+#ifndef HYBRIDPADDLEDETECTOR_H
+#define HYBRIDPADDLEDETECTOR_H
+#include "ColorPaddleDetector.h"
+
+class HybridPaddleDetector : public ColorPaddleDetector {
+	// the motion check runs at 1 / MOTION_DOWNSAMPLE of the frame's width and height
+	static const int MOTION_DOWNSAMPLE = 4;
+	// a zone moved when at least this many downsampled pixels changed
+	static const int MOTION_MIN_PIXELS = 4;
+public:
+	/*
+	* HybridPaddleDetector constructor
+	*
+	* preconditions:	vid must be a valid VideoCapture object point not equal to
+	*					nullptr
+	* postconditions:	sets the left and right paddles equal to the default position
+	*					and loads, or calibrates as mode asks, the tracking color of profile
+	*/
+	HybridPaddleDetector(VideoCapture *vid, const string &profile, ProfileMode mode = LOAD_PROFILE);
+
+	/*
+	* HybridPaddleDetector destructor
+	*
+	* preconditions:	none
+	* postconditions:	none
+	*/
+	~HybridPaddleDetector() {}
+
+	/*
+	* processFrame
+	*
+	* checks each zone of frame for motion and tracks the configured color only in the
+	* zones which moved. Every zone is tracked on the first frame.
+	*
+	* preconditions:	frame must be a valid Mat object representing a single frame from
+	*					from a VideoCapture object
+	* postconditions:	sets the position of each zone which moved according to color
+	*					detected in it, the first two zones being the left and right paddles
+	*/
+	void processFrame(Mat &frame);
+
+	/*
+	* clone
+	*
+	* preconditions:	none
+	* postconditions:	returns a new detector with the same settings, color and zones which has
+	*					processed no frames
+	*/
+	PaddleDetector *clone() const;
+
+	/*
+	* zoneMoved
+	*
+	* preconditions:	zone must be the index of a zone
+	* postconditions:	returns true if zone moved, and was segmented, on the last frame
+	*/
+	bool zoneMoved(int zone) const {return(m_moved[zone]);}
+
+private:
+	Mat m_lastGray;
+	vector<bool> m_moved;
+
+	// the buffers of the motion check, kept so frames of the same size do not allocate
+	Mat m_small;
+	Mat m_gray;
+	Mat m_diff;
+	vector<Rect> m_motionZones;
+};
+
+#endif
@@ -8,11 +8,14 @@
 #ifndef MOTIONPADDLEDETECTOR_CPP
 #define MOTIONPADDLEDETECTOR_CPP
 #include "MotionPaddleDetector.h"
+#include "AllocCounter.h"
+#include "Trace.h"
 
 /*
 * MotionPaddleDetector default constructor
 *
-* preconditions:	vid must be a valid VideoCapture object point not equal to nullptr
+* preconditions:	vid must be a valid VideoCapture object pointer, or nullptr to
+*					compare each frame processed with the one processed before it
 * postconditions:	sets left and right paddles to default position and sets m_vid 
 *					to vid
 */
@@ -26,6 +29,8 @@ MotionPaddleDetector::MotionPaddleDetector(VideoCapture* vid) : PaddleDetector()
 * processFrame
 *
 * uses sequential images to detect motion in the left and right halves of the frame.
+* With a capture both images are read from it, replacing frame. Without one frame
+* is compared with the frame processed before it.
 *
 * preconditions:	frame must be a valid Mat object representing a single frame from 
 *					from a VideoCapture object
@@ -33,32 +38,142 @@ MotionPaddleDetector::MotionPaddleDetector(VideoCapture* vid) : PaddleDetector()
 *					left and right halves of the frame, respectively
 */
 void MotionPaddleDetector::processFrame(Mat& frame) {
-	Mat frame2, gray, gray2, thres, diff;
-
 	// use sequential images (frame and frame2) for motion detection
+	if(m_vid != nullptr) {
+		// read in frame and convert to grayscale
+		{
+			TRACE_SCOPE("capture");
+			m_vid->read(frame);
+		}
+		TRACE_SCOPE("motion.gray");
+		pipeline::FlipMirror::apply(frame);
+		pipeline::BgrToGray::apply(frame, m_gray);
 
-	// read in frame and convert to grayscale
-	m_vid->read(frame);
-	flip(frame, frame, 1);
-	cvtColor(frame, gray, COLOR_BGR2GRAY);
+		// read in frame2 and convert to grayscale
+		{
+			TRACE_SCOPE("capture");
+			m_vid->read(m_frame2);
+		}
+		pipeline::FlipMirror::apply(m_frame2);
+		pipeline::BgrToGray::apply(m_frame2, m_gray2);
+	} else {
+		TRACE_SCOPE("motion.gray");
+		// the frame before this one takes the place of frame, and the buffer of the
+		// one before that is reused for this one
+		swap(m_gray, m_gray2);
+		pipeline::FlipMirror::apply(frame);
+		pipeline::BgrToGray::apply(frame, m_gray2);
+		if(m_gray.size() != m_gray2.size()) return;
+	}
 
-	// read in frame2 and convert to grayscale
-	m_vid->read(frame2);
-	flip(frame2, frame2, 1);
-	cvtColor(frame2, gray2, COLOR_BGR2GRAY);
+	trackMotion(frame);
+}
 
-	// create difference image of frame1 and frame2 after being converted to
-	// grayscale images
-	absdiff(gray, gray2, diff);
+/*
+* detectFrame
+*
+* compares frame with the frame detected before it, like processFrame without a
+* capture. Only the grayscale image is mirrored, frame is read where it is. A
+* grayscale frame is used as it is, the Y plane of a YUV frame being one.
+*
+* preconditions:	frame must be a BGR or grayscale frame of video. the detector must
+*					have no capture.
+* postconditions:	sets left and right paddles according to motion detected in the
+*					left and right halves of the mirrored frame, respectively
+*/
+void MotionPaddleDetector::detectFrame(const Mat &frame) {
+	{
+		TRACE_SCOPE("motion.gray");
+		swap(m_gray, m_gray2);
+		if(frame.channels() == 1) {
+			flip(frame, m_gray2, 1);
+		} else {
+			// the gray of the mirrored frame is the mirror of its gray
+			pipeline::BgrToGray::apply(frame, m_gray2);
+			pipeline::FlipMirror::apply(m_gray2);
+		}
+		if(m_gray.size() != m_gray2.size()) return;
+	}
 
-	// threshold difference
-	threshold(diff, thres, THRESHOLD_SENSITIVITY, 255, THRESH_BINARY);
+	Mat unmarked;
+	trackMotion(unmarked);
+}
 
-	// blur the image. output will be an intensity image
-	blur(thres, thres, cv::Size(BLUR_SIZE, BLUR_SIZE));
+/*
+* trackMotion
+*
+* preconditions:	m_gray and m_gray2 must be the mirrored grayscale images of sequential
+*					frames of the same size. frame must be the frame being processed, or
+*					empty if it is not to be marked.
+* postconditions:	sets left and right paddles according to motion detected between the
+*					images and draws crosshairs on frame
+*/
+void MotionPaddleDetector::trackMotion(Mat &frame) {
+	// shrink the grayscale images to the processing resolution
+	Mat gray = m_gray;
+	Mat gray2 = m_gray2;
+	if(m_settings.scale != 1.0) {
+		resize(m_gray, m_smallGray, Size(), m_settings.scale, m_settings.scale, INTER_AREA);
+		resize(m_gray2, m_smallGray2, Size(), m_settings.scale, m_settings.scale, INTER_AREA);
+		gray = m_smallGray;
+		gray2 = m_smallGray2;
+	}
 
-	// threshold intensity image to get binary image (after blurring)
-	threshold(thres, thres, THRESHOLD_SENSITIVITY, 255, THRESH_BINARY);
+	// the difference image and the motion energy of every tile come from one pass;
+	// most of the frame is static background during play, so only the runs of tiles
+	// which moved are processed further
+	{
+		TRACE_SCOPE("motion.tiles");
+		m_tiles.compute(gray, gray2, m_diff);
+		m_tiles.getActiveRuns(TILE_MEAN_DIFF, m_runs);
+	}
+	if(m_runs.empty()) {
+		losePaddle(IS_RED);
+		losePaddle(IS_BLUE);
+		return;
+	}
+
+	// opening and then dilating the mask reaches no further than this from the runs,
+	// so the rest of the frame is left as it was and never read
+	int reach = m_settings.blurSize / 2 + NOISE_RADIUS;
+	Rect area = m_runs[0];
+	for(size_t i = 1; i < m_runs.size(); i++) {
+		area |= m_runs[i];
+	}
+	area = Rect(area.x - reach, area.y - reach, area.width + reach * 2, area.height + reach * 2);
+	area = area & Rect(0, 0, gray.cols, gray.rows);
+
+	TRACE_SCOPE("motion.threshold");
+	m_threshold.configure(m_settings);
+	Mat &thres = m_thres;
+	thres.create(gray.size(), CV_8UC1);
+	Mat(thres, area) = Scalar(0);
+	for(size_t i = 0; i < m_runs.size(); i++) {
+		const Rect &run = m_runs[i];
+
+		// threshold the difference of the grayscale images
+		Mat destRoi(thres, run);
+		m_threshold.apply(Mat(m_diff, run), destRoi);
+	}
+
+	// remove the specks of noise and then grow what is left into blobs, in place of
+	// blurring the binary image and thresholding it again
+	{
+		TRACE_SCOPE("motion.mask");
+		Mat areaThres(thres, area);
+		m_mask.fromMat(areaThres);
+		m_mask.open(NOISE_RADIUS);
+		m_mask.dilate(m_settings.blurSize / 2);
+		m_mask.toMat(areaThres);
+	}
+
+	TRACE_SCOPE("motion.contours");
+	if(m_wholeFrame) {
+		// the whole binary image is the left paddle's
+		detectMotion(thres, area, frame, IS_RED);
+		losePaddle(IS_BLUE);
+		return;
+	}
 
 	// split threshold (now binary image) into left and right halves
 	int x = thres.cols / 2;
@@ -67,8 +182,22 @@ void MotionPaddleDetector::processFrame(Mat& frame) {
 	Mat thresholdRight(thres, Rect(x, 0, x, y));
 
 	// detect motion in each half of the binary image
-	detectMotion(thresholdLeft, frame, IS_RED);
-	detectMotion(thresholdRight, frame, IS_BLUE);
+	detectMotion(thresholdLeft, area, frame, IS_RED);
+	detectMotion(thresholdRight, area - Point(x, 0), frame, IS_BLUE);
+}
+
+/*
+* clone
+*
+* preconditions:	none
+* postconditions:	returns a new detector with the same settings which has
+*					processed no frames and compares each frame it is given with the one before
+*/
+PaddleDetector *MotionPaddleDetector::clone() const {
+	MotionPaddleDetector *copy = new MotionPaddleDetector();
+	copy->setSettings(m_settings);
+	copy->m_wholeFrame = m_wholeFrame;
+	return(copy);
 }
 
 /*
@@ -78,53 +207,72 @@ void MotionPaddleDetector::processFrame(Mat& frame) {
 * using the largest contour to determine the motion of the paddle.
 *
 * preconditions:	thres must be one half (left or right) of the threshold image of the
-*					difference image from the sequential frames. frame must be the video
-*					frame being processed. isRight should be set true if we are detecting
-*					motion in the right frame, otherwise it should be false as we are
-*					tracking motion in the left frame.
+*					difference image from the sequential frames. area must hold every
+*					pixel of thres which may be set, relative to thres. frame must be the
+*					video frame being processed, or empty. isRight should be set true if we
+*					are detecting motion in the right frame, otherwise it should be false
+*					as we are tracking motion in the left frame.
 * postconditions:	sets the paddle position of the paddle indicated by isRight and draws
-*					a crosshair around the object being tracked
+*					a crosshair around the object being tracked unless frame is empty
 */
-void MotionPaddleDetector::detectMotion(Mat &thres, Mat &frame, bool isRight) {
+void MotionPaddleDetector::detectMotion(Mat &thres, const Rect &area, Mat &frame, bool isRight) {
 	bool objectDetected = false;
 
-	// the contour vector and hieracrchy returned from findContours
-	vector<vector<Point>> contours;
-	vector<Vec4i> hierarchy;
+	// the contour vector and hieracrchy returned from findContours, kept between
+	// frames so their capacity is reused
+	vector<vector<Point> > &contours = m_contours;
+	vector<Vec4i> &hierarchy = m_hierarchy;
 
-	// find contours in binary image
-	findContours(thres, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);// retrieves external contours
+	// find contours in the part of the binary image which may be set
+	Rect searched = area & Rect(0, 0, thres.cols, thres.rows);
+	if(searched.area() == 0) {
+		losePaddle(isRight);
+		return;
+	}
+	{
+		ALLOC_SCOPE("findContours");
+		Mat searchedThres(thres, searched);
+		findContours(searchedThres, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE, searched.tl());// retrieves external contours
+	}
 
 	// if contours vector is empty, no objects were detected
 	objectDetected = contours.size() > 0 ? true : false;
 
 	if(objectDetected){
 		// select the largest contour
-		vector<vector<Point>> largestContourVec;
-		largestContourVec.push_back(contours.at(contours.size() - 1));
+		const vector<Point> &largestContour = contours.at(contours.size() - 1);
 
 		// create a bounding rectangle around the largest contour and then take
 		// the center of the bounding rectangle and use this point for tracking
-		Rect objBoundingRect = boundingRect(largestContourVec.at(0));
+		Rect objBoundingRect = boundingRect(largestContour);
 		int x = objBoundingRect.x + objBoundingRect.width / 2;
 		int y = objBoundingRect.y + objBoundingRect.height / 2;
+
+		// scale the point from the processing resolution back up to the frame
+		x = static_cast<int>(x / m_settings.scale);
+		y = static_cast<int>(y / m_settings.scale);
 		
+		// the bigger the moving object the more likely it is the player
+		double area = objBoundingRect.area() / (m_settings.scale * m_settings.scale);
+		setPaddle(isRight, y, std::min(1.0, area / CONFIDENT_AREA));
+
+		// a frame which is only read is not marked
+		if(frame.empty()) return;
+
 		Scalar color;
 		if(isRight) {
-			//update right paddle's position and set crosshair color to blue
-			m_rightPaddlePos = y;
+			// set crosshair color to blue
 			x = (frame.cols / 2) + x;
 			color = BLUE;
 		} else {
-			// update left paddle's position and set crosshair color to red
-			m_leftPaddlePos = y;
+			// set crosshair color to red
 			color = RED;
 		}
 
 		// draw crosshairs through the point being tracked in the frame
-		circle(frame, Point(x, y), 10, color, 2);
-		line(frame, Point(x, y + 15), Point(x, y - 15), color, 2);
-		line(frame, Point(x + 15, y), Point(x - 15, y), color, 2);
+		drawCrosshair(frame, Point(x, y), color);
+	} else {
+		losePaddle(isRight);
 	}
 }
 
@@ -2,25 +2,36 @@
 * MotionPaddleDetector class
 *
 * a class which detects motion in a video frame using sequential images. Motion
-* is tracked seperately in the left and right halves of the video frame.
+* is tracked seperately in the left and right halves of the video frame. The frames
+* are mirrored, converted, differenced and thresholded by the stages of the fused
+* motion pipeline, applied to the tiles which moved.
 *
 */
 #ifndef MOTIONPADDLEDETECTOR_H
 #define MOTIONPADDLEDETECTOR_H
 #include "PaddleDetector.h"
+#include "DetectorPipeline.h"
+#include "TileEnergy.h"
+#include "BitMask.h"
 
 class MotionPaddleDetector : public PaddleDetector {
-	static const int THRESHOLD_SENSITIVITY = 20;
-	static const int BLUR_SIZE = 10;
+	// tiles whose mean absolute difference per pixel is at most this are treated as
+	// static background and skipped
+	static const int TILE_MEAN_DIFF = 2;
+	// specks of motion no wider than (2 * NOISE_RADIUS) pixels are noise
+	static const int NOISE_RADIUS = 1;
+	// a moving object this many pixels big, at full resolution, is fully trusted
+	static const int CONFIDENT_AREA = 4000;
 public:
 	/*
 	* MotionPaddleDetector default constructor
 	*
-	* preconditions:	vid must be a valid VideoCapture object point not equal to nullptr
+	* preconditions:	vid must be a valid VideoCapture object pointer, or nullptr to
+	*					compare each frame processed with the one processed before it
 	* postconditions:	sets left and right paddles to default position and sets m_vid
 	*					to vid
 	*/
-	MotionPaddleDetector(VideoCapture* vid);
+	MotionPaddleDetector(VideoCapture* vid = nullptr);
 
 	/*
 	* MotionPaddleDetector destructor
@@ -34,6 +45,8 @@ public:
 	* processFrame
 	*
 	* uses sequential images to detect motion in the left and right halves of the frame.
+	* With a capture both images are read from it, replacing frame. Without one frame
+	* is compared with the frame processed before it.
 	*
 	* preconditions:	frame must be a valid Mat object representing a single frame from
 	*					from a VideoCapture object
@@ -42,7 +55,66 @@ public:
 	*/
 	virtual void processFrame(Mat& frame);
 
+	/*
+	* detectFrame
+	*
+	* compares frame with the frame detected before it, like processFrame without a
+	* capture. Only the grayscale image is mirrored, frame is read where it is. A
+	* grayscale frame is used as it is, the Y plane of a YUV frame being one.
+	*
+	* preconditions:	frame must be a BGR or grayscale frame of video. the detector must
+	*					have no capture.
+	* postconditions:	sets left and right paddles according to motion detected in the
+	*					left and right halves of the mirrored frame, respectively
+	*/
+	virtual void detectFrame(const Mat &frame);
+
+	/*
+	* readsOnly
+	*
+	* preconditions:	none
+	* postconditions:	returns true without a capture, detectFrame then only reads frame
+	*/
+	virtual bool readsOnly() const {return(m_vid == nullptr);}
+
+	/*
+	* readsGray
+	*
+	* preconditions:	none
+	* postconditions:	returns true, motion is found in the grayscale image only
+	*/
+	virtual bool readsGray() const {return(true);}
+
+	/*
+	* trackWholeFrame
+	*
+	* preconditions:	none
+	* postconditions:	tracks the largest moving object in the whole frame as the left
+	*					paddle from the next frame on and returns true
+	*/
+	virtual bool trackWholeFrame() {m_wholeFrame = true; return(true);}
+
+	/*
+	* clone
+	*
+	* preconditions:	none
+	* postconditions:	returns a new detector with the same settings which has
+	*					processed no frames and compares each frame it is given with the one before
+	*/
+	virtual PaddleDetector *clone() const;
+
 private:
+	/*
+	* trackMotion
+	*
+	* preconditions:	m_gray and m_gray2 must be the mirrored grayscale images of sequential
+	*					frames of the same size. frame must be the frame being processed, or
+	*					empty if it is not to be marked.
+	* postconditions:	sets left and right paddles according to motion detected between the
+	*					images and draws crosshairs on frame
+	*/
+	void trackMotion(Mat &frame);
+
 	/*
 	* detectMotion
 	*
@@ -50,16 +122,49 @@ private:
 	* using the largest contour to determine the motion of the paddle.
 	*
 	* preconditions:	thres must be one half (left or right) of the threshold image of the
-	*					difference image from the sequential frames. frame must be the video
-	*					frame being processed. isRight should be set true if we are detecting
-	*					motion in the right frame, otherwise it should be false as we are
-	*					tracking motion in the left frame.
+	*					difference image from the sequential frames. area must hold every
+	*					pixel of thres which may be set, relative to thres. frame must be the
+	*					video frame being processed, or empty. isRight should be set true if we
+	*					are detecting motion in the right frame, otherwise it should be false
+	*					as we are tracking motion in the left frame.
 	* postconditions:	sets the paddle position of the paddle indicated by isRight and draws
-	*					a crosshair around the object being tracked
+	*					a crosshair around the object being tracked unless frame is empty
 	*/
-	void detectMotion(Mat &thres, Mat &frame, bool isRight);
+	void detectMotion(Mat &thres, const Rect &area, Mat &frame, bool isRight);
+
+	/*
+	* detectMotion
+	*
+	* preconditions:	as above, with all of thres searched
+	* postconditions:	as above
+	*/
+	void detectMotion(Mat &thres, Mat &frame, bool isRight) {
+		detectMotion(thres, Rect(0, 0, thres.cols, thres.rows), frame, isRight);
+	}
 
 	VideoCapture* m_vid;
+
+	// one object is tracked in the whole frame instead of one in each half
+	bool m_wholeFrame = false;
+
+	// the buffers of each frame are kept so a steady stream of frames the same size
+	// does not allocate. Without a capture m_gray holds the frame processed before.
+	Mat m_frame2;
+	Mat m_gray;
+	Mat m_gray2;
+	Mat m_smallGray;
+	Mat m_smallGray2;
+	Mat m_thres;
+	Mat m_diff;
+	vector<vector<Point> > m_contours;
+	vector<Vec4i> m_hierarchy;
+
+	// thresholds the difference image at the sensitivity of the settings
+	pipeline::Above m_threshold;
+
+	TileEnergy m_tiles;
+	vector<Rect> m_runs;
+	BitMask m_mask;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,314 @@
+/*
+* OpticalFlowPaddleDetector class
+*
+* a class which detects motion in a video frame by following a small set of feature
+* points on each player's object with pyramidal Lucas-Kanade optical flow. Points are
+* seeded once from a motion image and only reseeded when the track is lost. Motion
+* is tracked seperately in the left and right halves of the video frame. The
+* threshold of the difference image and the scale the frames are processed at are
+* taken from the settings.
+*
+*/
+#include <algorithm>
+#include <cfloat>
+#include "OpticalFlowPaddleDetector.h"
+#include "AllocCounter.h"
+#include "Trace.h"
+
+/*
+* OpticalFlowPaddleDetector default constructor
+*
+* preconditions:	none
+* postconditions:	sets left and right paddles to default position with no points
+*					being tracked
+*/
+OpticalFlowPaddleDetector::OpticalFlowPaddleDetector() : PaddleDetector() {
+	m_leftPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_rightPaddlePos = DEFAULT_PADDLE_POSITION;
+}
+
+/*
+* processFrame
+*
+* follows the tracked points of each player from the previous frame into frame. A
+* side whose track has been lost is reseeded from the difference of the two frames.
+*
+* preconditions:	frame must be a valid Mat object representing a single frame from
+*					from a VideoCapture object
+* postconditions:	sets left and right paddles according to the points tracked in the
+*					left and right halves of the frame, respectively
+*/
+void OpticalFlowPaddleDetector::processFrame(Mat& frame) {
+	double scale = m_settings.scale;
+
+	// the gray frame of the frame before last is reused as the buffer of this one
+	swap(m_gray, m_prevGray);
+	Mat &gray = m_gray;
+
+	flip(frame, frame, 1);
+	if(scale < 1.0) {
+		cvtColor(frame, m_fullGray, COLOR_BGR2GRAY);
+		resize(m_fullGray, gray, Size(), scale, scale, INTER_AREA);
+	} else {
+		cvtColor(frame, gray, COLOR_BGR2GRAY);
+	}
+
+	trackFlow(frame);
+}
+
+/*
+* detectFrame
+*
+* follows the tracked points like processFrame, mirroring only the grayscale image
+* so frame is read where it is. A grayscale frame is used as it is.
+*
+* preconditions:	frame must be a BGR or grayscale frame of video
+* postconditions:	sets left and right paddles according to the points tracked in the
+*					left and right halves of the mirrored frame, respectively
+*/
+void OpticalFlowPaddleDetector::detectFrame(const Mat &frame) {
+	double scale = m_settings.scale;
+	swap(m_gray, m_prevGray);
+
+	// the gray of the mirrored frame is the mirror of its gray
+	Mat &full = scale < 1.0 ? m_fullGray : m_gray;
+	if(frame.channels() == 1) {
+		flip(frame, full, 1);
+	} else {
+		cvtColor(frame, full, COLOR_BGR2GRAY);
+		flip(full, full, 1);
+	}
+	if(scale < 1.0) {
+		resize(m_fullGray, m_gray, Size(), scale, scale, INTER_AREA);
+	}
+
+	Mat unmarked;
+	trackFlow(unmarked);
+}
+
+/*
+* trackFlow
+*
+* preconditions:	m_gray must be the mirrored grayscale image of the frame being
+*					processed, at the processing resolution, and m_prevGray that of the
+*					frame before. frame must be the frame being processed, or empty if it
+*					is not to be marked.
+* postconditions:	sets left and right paddles according to the points tracked in the
+*					left and right halves of the frame and draws them on frame
+*/
+void OpticalFlowPaddleDetector::trackFlow(Mat &frame) {
+	Mat &gray = m_gray;
+
+	// points tracked at another scale can not be followed into this frame
+	if(!m_prevGray.empty() && m_prevGray.size() != gray.size()) {
+		m_prevGray.release();
+		m_points[0].clear();
+		m_points[1].clear();
+	}
+
+	// the pyramid is built once per frame and reused as the previous pyramid of
+	// the next frame, so each frame is only pyramided once
+	{
+		TRACE_SCOPE("flow.pyramid");
+		ALLOC_SCOPE("flow.pyramid");
+		buildOpticalFlowPyramid(gray, m_pyr, Size(WIN_SIZE, WIN_SIZE), PYR_LEVELS);
+	}
+
+	if(!m_prevGray.empty()) {
+		// with the whole frame tracked the left "half" is all of it
+		int sides = m_wholeFrame ? 1 : 2;
+		int x = m_wholeFrame ? gray.cols : gray.cols / 2;
+		int y = gray.rows;
+
+		for(int side = 0; side < sides; side++) {
+			bool isRight = (side == 1);
+
+			if(m_points[side].size() < MIN_POINTS) {
+				// track lost, reseed from the difference image of this half only
+				Rect half(isRight ? x : 0, 0, x, y);
+				Mat grayHalf(gray, half);
+				absdiff(Mat(m_prevGray, half), grayHalf, m_diff);
+				threshold(m_diff, m_thres, m_settings.thresholdSensitivity, 255, THRESH_BINARY);
+				detectMotion(m_thres, grayHalf, isRight);
+			} else {
+				trackPoints(m_pyr, x, isRight);
+			}
+
+			if(!m_points[side].empty()) {
+				updatePaddle(frame, isRight);
+			} else {
+				losePaddle(isRight);
+			}
+		}
+		if(m_wholeFrame) {
+			losePaddle(true);
+		}
+	}
+
+	m_prevPyr.swap(m_pyr);
+}
+
+/*
+* clone
+*
+* preconditions:	none
+* postconditions:	returns a new detector with the same settings which has
+*					processed no frames
+*/
+PaddleDetector *OpticalFlowPaddleDetector::clone() const {
+	OpticalFlowPaddleDetector *copy = new OpticalFlowPaddleDetector();
+	copy->setSettings(m_settings);
+	copy->m_wholeFrame = m_wholeFrame;
+	return(copy);
+}
+
+/*
+* detectMotion
+*
+* seeds the track of one player by finding the largest moving object in a thresholded
+* difference image and picking good features to track inside of it.
+*
+* preconditions:	thres must be one half (left or right) of the threshold image of the
+*					difference image from the sequential frames. gray must be the same half
+*					of the current grayscale frame. isRight should be set true if we are
+*					seeding the right frame, otherwise it should be false.
+* postconditions:	replaces the tracked points of the side indicated by isRight. the
+*					points are left empty if no motion was found.
+*/
+void OpticalFlowPaddleDetector::detectMotion(Mat &thres, Mat &gray, bool isRight) {
+	vector<Point2f> &points = m_points[isRight ? 1 : 0];
+	points.clear();
+
+	vector<vector<Point>> &contours = m_contours;
+	{
+		TRACE_SCOPE("flow.contours");
+		ALLOC_SCOPE("findContours");
+		findContours(thres, contours, m_hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+	}
+
+	if(contours.empty()) {
+		return;
+	}
+
+	// select the largest moving object
+	size_t largest = 0;
+	double largestArea = 0;
+	for(size_t i = 0; i < contours.size(); i++) {
+		double area = contourArea(contours[i]);
+		if(area > largestArea) {
+			largestArea = area;
+			largest = i;
+		}
+	}
+
+	// only look for features inside the bounding rectangle of the object
+	m_mask.create(gray.size(), CV_8UC1);
+	m_mask.setTo(Scalar(0));
+	rectangle(m_mask, boundingRect(contours[largest]), Scalar(255), -1);
+
+	{
+		TRACE_SCOPE("flow.reseed");
+		ALLOC_SCOPE("flow.reseed");
+		goodFeaturesToTrack(gray, points, MAX_POINTS, 0.01, MIN_POINT_DISTANCE, m_mask);
+	}
+
+	if(points.size() < MIN_POINTS) {
+		// too few features to follow, try again on the next frame
+		points.clear();
+		return;
+	}
+
+	// features are found in the half frame, move them into full frame coordinates
+	if(isRight) {
+		for(size_t i = 0; i < points.size(); i++) {
+			points[i].x += gray.cols;
+		}
+	}
+}
+
+/*
+* trackPoints
+*
+* follows the tracked points of one player from the previous pyramid into the current
+* one and drops the points which were lost or left their half of the frame.
+*
+* preconditions:	m_prevPyr and pyr must be pyramids of sequential grayscale frames.
+*					isRight should be set true for the right player.
+* postconditions:	updates the tracked points of the side indicated by isRight and clears
+*					them if the track quality has dropped too far to be trusted
+*/
+void OpticalFlowPaddleDetector::trackPoints(vector<Mat> &pyr, int halfWidth, bool isRight) {
+	vector<Point2f> &points = m_points[isRight ? 1 : 0];
+	vector<Point2f> &next = m_next;
+	vector<uchar> &status = m_status;
+
+	{
+		TRACE_SCOPE("flow.track");
+		ALLOC_SCOPE("flow.track");
+		calcOpticalFlowPyrLK(m_prevPyr, pyr, points, next, status, m_err,
+							 Size(WIN_SIZE, WIN_SIZE), PYR_LEVELS);
+	}
+
+	float minX = isRight ? static_cast<float>(halfWidth) : 0.0f;
+	float maxX = isRight ? static_cast<float>(halfWidth * 2) : static_cast<float>(halfWidth);
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+
+	// keep the points which were found and stayed in their player's half
+	size_t kept = 0;
+	for(size_t i = 0; i < next.size(); i++) {
+		if(status[i] && next[i].x >= minX && next[i].x < maxX) {
+			points[kept++] = next[i];
+			minY = std::min(minY, next[i].y);
+			maxY = std::max(maxY, next[i].y);
+		}
+	}
+	points.resize(kept);
+
+	// too few points or points scattered over the frame means the track has
+	// drifted off of the object, drop it so it is reseeded
+	if(kept < MIN_POINTS || maxY - minY > MAX_SPREAD * m_settings.scale) {
+		points.clear();
+	}
+}
+
+/*
+* updatePaddle
+*
+* preconditions:	the points of the side indicated by isRight must not be empty, in the
+*					coordinates of the frame processed at m_settings.scale
+* postconditions:	sets the paddle position of the paddle indicated by isRight to the
+*					median height of its points in frame and draws a crosshair on frame
+*					unless it is empty
+*/
+void OpticalFlowPaddleDetector::updatePaddle(Mat &frame, bool isRight) {
+	const vector<Point2f> &points = m_points[isRight ? 1 : 0];
+
+	// the median is used so a few stray points do not pull the paddle around
+	vector<float> &heights = m_heights;
+	heights.resize(points.size());
+	float sumX = 0;
+	for(size_t i = 0; i < points.size(); i++) {
+		heights[i] = points[i].y;
+		sumX += points[i].x;
+	}
+	std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+
+	// the points are in the coordinates of the frame as processed, at scale
+	double scale = m_settings.scale;
+	int x = static_cast<int>(sumX / points.size() / scale);
+	int y = static_cast<int>(heights[heights.size() / 2] / scale);
+
+	// the more of the seeded points still tracked the surer the track
+	setPaddle(isRight, y, std::min(1.0, static_cast<double>(points.size()) / MAX_POINTS));
+
+	// a frame which is only read is not marked
+	if(frame.empty()) return;
+	Scalar color = isRight ? BLUE : RED;
+
+	// draw the tracked points and crosshairs through the point being tracked
+	for(size_t i = 0; i < points.size(); i++) {
+		circle(frame, Point(static_cast<int>(points[i].x / scale), static_cast<int>(points[i].y / scale)), 2, color, -1);
+	}
+	drawCrosshair(frame, Point(x, y), color);
+}
@@ -0,0 +1,175 @@
+/*
+* OpticalFlowPaddleDetector class
+*
+* a class which detects motion in a video frame by following a small set of feature
+* points on each player's object with pyramidal Lucas-Kanade optical flow. Points are
+* seeded once from a motion image and only reseeded when the track is lost. Motion
+* is tracked seperately in the left and right halves of the video frame. The
+* threshold of the difference image and the scale the frames are processed at are
+* taken from the settings.
+*
+*/
+#ifndef OPTICALFLOWPADDLEDETECTOR_H
+#define OPTICALFLOWPADDLEDETECTOR_H
+#include <opencv2/video/tracking.hpp>
+#include "PaddleDetector.h"
+
+class OpticalFlowPaddleDetector : public PaddleDetector {
+	static const int MAX_POINTS = 30;
+	static const int MIN_POINTS = 8;
+	static const int MIN_POINT_DISTANCE = 5;
+	static const int MAX_SPREAD = 160;
+	static const int WIN_SIZE = 15;
+	static const int PYR_LEVELS = 2;
+public:
+	/*
+	* OpticalFlowPaddleDetector default constructor
+	*
+	* preconditions:	none
+	* postconditions:	sets left and right paddles to default position with no points
+	*					being tracked
+	*/
+	OpticalFlowPaddleDetector();
+
+	/*
+	* OpticalFlowPaddleDetector destructor
+	*
+	* preconditions:	none
+	* postconditions:	none
+	*/
+	~OpticalFlowPaddleDetector() {}
+
+	/*
+	* processFrame
+	*
+	* follows the tracked points of each player from the previous frame into frame. A
+	* side whose track has been lost is reseeded from the difference of the two frames.
+	*
+	* preconditions:	frame must be a valid Mat object representing a single frame from
+	*					from a VideoCapture object
+	* postconditions:	sets left and right paddles according to the points tracked in the
+	*					left and right halves of the frame, respectively
+	*/
+	virtual void processFrame(Mat& frame);
+
+	/*
+	* detectFrame
+	*
+	* follows the tracked points like processFrame, mirroring only the grayscale image
+	* so frame is read where it is. A grayscale frame is used as it is.
+	*
+	* preconditions:	frame must be a BGR or grayscale frame of video
+	* postconditions:	sets left and right paddles according to the points tracked in the
+	*					left and right halves of the mirrored frame, respectively
+	*/
+	virtual void detectFrame(const Mat &frame);
+
+	/*
+	* readsOnly
+	*
+	* preconditions:	none
+	* postconditions:	returns true, detectFrame only reads frame
+	*/
+	virtual bool readsOnly() const {return(true);}
+
+	/*
+	* readsGray
+	*
+	* preconditions:	none
+	* postconditions:	returns true, the points are followed in the grayscale image only
+	*/
+	virtual bool readsGray() const {return(true);}
+
+	/*
+	* trackWholeFrame
+	*
+	* preconditions:	none
+	* postconditions:	follows one set of points anywhere in the frame as the left paddle
+	*					from the next frame on and returns true
+	*/
+	virtual bool trackWholeFrame() {m_wholeFrame = true; return(true);}
+
+	/*
+	* clone
+	*
+	* preconditions:	none
+	* postconditions:	returns a new detector with the same settings which has
+	*					processed no frames
+	*/
+	virtual PaddleDetector *clone() const;
+
+private:
+	/*
+	* trackFlow
+	*
+	* preconditions:	m_gray must be the mirrored grayscale image of the frame being
+	*					processed, at the processing resolution, and m_prevGray that of the
+	*					frame before. frame must be the frame being processed, or empty if it
+	*					is not to be marked.
+	* postconditions:	sets left and right paddles according to the points tracked in the
+	*					left and right halves of the frame and draws them on frame
+	*/
+	void trackFlow(Mat &frame);
+
+	/*
+	* detectMotion
+	*
+	* seeds the track of one player by finding the largest moving object in a thresholded
+	* difference image and picking good features to track inside of it.
+	*
+	* preconditions:	thres must be one half (left or right) of the threshold image of the
+	*					difference image from the sequential frames. gray must be the same half
+	*					of the current grayscale frame. isRight should be set true if we are
+	*					seeding the right frame, otherwise it should be false.
+	* postconditions:	replaces the tracked points of the side indicated by isRight. the
+	*					points are left empty if no motion was found.
+	*/
+	void detectMotion(Mat &thres, Mat &gray, bool isRight);
+
+	/*
+	* trackPoints
+	*
+	* follows the tracked points of one player from the previous pyramid into the current
+	* one and drops the points which were lost or left their half of the frame.
+	*
+	* preconditions:	m_prevPyr and pyr must be pyramids of sequential grayscale frames.
+	*					isRight should be set true for the right player.
+	* postconditions:	updates the tracked points of the side indicated by isRight and clears
+	*					them if the track quality has dropped too far to be trusted
+	*/
+	void trackPoints(vector<Mat> &pyr, int halfWidth, bool isRight);
+
+	/*
+	* updatePaddle
+	*
+	* preconditions:	the points of the side indicated by isRight must not be empty, in the
+	*					coordinates of the frame processed at m_settings.scale
+	* postconditions:	sets the paddle position of the paddle indicated by isRight to the
+	*					median height of its points in frame and draws a crosshair on frame
+	*					unless it is empty
+	*/
+	void updatePaddle(Mat &frame, bool isRight);
+
+	Mat m_prevGray;
+	vector<Mat> m_prevPyr;
+	vector<Point2f> m_points[2];
+
+	// one set of points is followed in the whole frame instead of one in each half
+	bool m_wholeFrame = false;
+
+	// the buffers of each frame, kept so frames of the same size do not allocate
+	Mat m_gray;
+	Mat m_fullGray;
+	vector<Mat> m_pyr;
+	Mat m_diff;
+	Mat m_thres;
+	Mat m_mask;
+	vector<vector<Point> > m_contours;
+	vector<Vec4i> m_hierarchy;
+	vector<Point2f> m_next;
+	vector<uchar> m_status;
+	vector<float> m_err;
+	vector<float> m_heights;
+};
+
+#endif
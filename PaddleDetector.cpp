@@ -1,4 +1,130 @@
 #include "PaddleDetector.h"
+#include "AllocCounter.h"
+#include "Trace.h"
 
+// passed by reference, by std::vector and std::max, so it needs a definition
+const int PaddleDetector::DEFAULT_PADDLE_POSITION;
 
+// the crosshair drawn over a tracked object
+static const int CROSSHAIR_RADIUS = 10;
+static const int CROSSHAIR_ARM = 15;
+static const int CROSSHAIR_THICKNESS = 2;
+// circle() outlines a circle of CROSSHAIR_RADIUS with a vertex every this many degrees
+static const int CROSSHAIR_DEGREES = 18;
 
+// chunks of a batch are at least this many frames, so warming up is a small cost
+static const int MIN_CHUNK_FRAMES = 16;
+// chunks per core, so cores which finish early pick up the rest of the batch
+static const int CHUNKS_PER_CPU = 4;
+
+/*
+* BatchChunks
+*
+* detects a range of the chunks of a batch, each with a fresh clone of the
+* detector, so the results do not depend on how the chunks are spread over cores
+*/
+class BatchChunks : public ParallelLoopBody {
+public:
+	BatchChunks(const PaddleDetector &detector, const vector<Mat> &frames, vector<PaddleResult> &results,
+				int chunkFrames, uint64_t firstFrameId, int warmup)
+		: m_detector(detector), m_frames(frames), m_results(results), m_chunkFrames(chunkFrames),
+		  m_firstFrameId(firstFrameId), m_warmup(warmup) {}
+
+	void operator()(const Range &range) const {
+		for(int chunk = range.start; chunk < range.end; chunk++) {
+			int first = chunk * m_chunkFrames;
+			int last = std::min(first + m_chunkFrames, static_cast<int>(m_frames.size()));
+			PaddleDetector *detector = m_detector.clone();
+
+			bool readsOnly = detector->readsOnly();
+			Mat frame;
+
+			for(int i = std::max(first - m_warmup, 0); i < last; i++) {
+				// the other detectors mirror and mark the frame they are given, so they
+				// get a copy, made outside of the time measured
+				if(!readsOnly) {
+					m_frames[i].copyTo(frame);
+				}
+				Trace::setFrame(m_firstFrameId + i);
+				int64 start = getTickCount();
+				{
+					TRACE_SCOPE("processFrame");
+					if(readsOnly) {
+						detector->detectFrame(m_frames[i]);
+					} else {
+						detector->processFrame(frame);
+					}
+				}
+				if(i < first) continue;
+
+				PaddleResult &result = m_results[i];
+				result.frameId = m_firstFrameId + i;
+				result.captureUs = 0;
+				result.latencyUs = static_cast<int64_t>((getTickCount() - start) * 1000000.0 / getTickFrequency());
+				result.left = detector->getLeftPaddle();
+				result.right = detector->getRightPaddle();
+				result.skipped = false;
+			}
+			delete detector;
+		}
+	}
+
+private:
+	const PaddleDetector &m_detector;
+	const vector<Mat> &m_frames;
+	vector<PaddleResult> &m_results;
+	int m_chunkFrames;
+	uint64_t m_firstFrameId;
+	int m_warmup;
+};
+
+/*
+* processFrames
+*
+* detects the paddles in a batch of recorded frames, spread over all cores. The
+* batch is split into chunks of consecutive frames, each detected by its own clone
+* of this detector. A clone first processes the warmup frames before its chunk,
+* so motion has the frame before the first of the chunk to compare it with.
+*
+* Preconditions:	frames must be consecutive BGR frames of video, or grayscale frames
+*					if readsOnly() and readsGray()
+* Postconditions:	returns the results of the frames in order, numbered from
+*					firstFrameId, and returns true. returns false if the detector can
+*					not be cloned. frames are not changed.
+*/
+bool PaddleDetector::processFrames(const vector<Mat> &frames, vector<PaddleResult> &results,
+								   uint64_t firstFrameId, int warmup) const {
+	PaddleDetector *probe = clone();
+	if(probe == nullptr) {
+		results.clear();
+		return(false);
+	}
+	delete probe;
+
+	results.resize(frames.size());
+	if(frames.empty()) return(true);
+
+	int count = static_cast<int>(frames.size());
+	int chunkFrames = std::max(MIN_CHUNK_FRAMES, count / (getNumberOfCPUs() * CHUNKS_PER_CPU));
+	int chunks = (count + chunkFrames - 1) / chunkFrames;
+
+	parallel_for_(Range(0, chunks), BatchChunks(*this, frames, results, chunkFrames, firstFrameId, warmup));
+	return(true);
+}
+
+/*
+* drawCrosshair
+*
+* Preconditions:	frame must be a BGR image
+* Postconditions:	draws a crosshair in color through at on frame, marking the object
+*					being tracked
+*/
+void PaddleDetector::drawCrosshair(Mat &frame, Point at, const Scalar &color) {
+	ALLOC_SCOPE("markers");
+	ellipse2Poly(at, Size(CROSSHAIR_RADIUS, CROSSHAIR_RADIUS), 0, 0, 360, CROSSHAIR_DEGREES, m_crosshair);
+	const Point *outline = &m_crosshair[0];
+	int vertices = static_cast<int>(m_crosshair.size());
+	polylines(frame, &outline, &vertices, 1, true, color, CROSSHAIR_THICKNESS);
+	line(frame, Point(at.x, at.y + CROSSHAIR_ARM), Point(at.x, at.y - CROSSHAIR_ARM), color, CROSSHAIR_THICKNESS);
+	line(frame, Point(at.x + CROSSHAIR_ARM, at.y), Point(at.x - CROSSHAIR_ARM, at.y), color, CROSSHAIR_THICKNESS);
+}
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -12,12 +13,93 @@ using namespace cv;
 
 static const string MPD_FLAG = "move";
 const string CPD_FLAG = "color";
+const string OFPD_FLAG = "flow";
+const string FMPD_FLAG = "fastmove";
+const string FCPD_FLAG = "fastcolor";
+const string SPD_FLAG = "shared";
+const string HPD_FLAG = "hybrid";
 
 const Scalar RED(0, 0, 255);
 const Scalar BLUE(255, 0, 0);
 const bool IS_RED = false;
 const bool IS_BLUE = true;
 
+const int DEFAULT_THRESHOLD_SENSITIVITY = 20;
+const int DEFAULT_BLUR_SIZE = 10;
+const int DEFAULT_AREA_THRES = 10000;
+const int DEFAULT_GAUSS_SIZE = 7;
+const double DEFAULT_GAUSS_SIGMA = 2;
+const int DEFAULT_GAUSS_PASSES = 2;
+const double DEFAULT_SCALE = 1.0;
+const int DEFAULT_ROI_MARGIN = 120;
+
+/*
+* DetectorSettings
+*
+* the tunable parameters of the detectors. Each detector uses the settings which
+* apply to it and ignores the rest.
+*/
+struct DetectorSettings {
+	/*
+	* DetectorSettings default constructor
+	*
+	* preconditions:	none
+	* postconditions:	sets every parameter to the default the detectors are tuned for
+	*/
+	DetectorSettings() :
+		thresholdSensitivity(DEFAULT_THRESHOLD_SENSITIVITY),
+		blurSize(DEFAULT_BLUR_SIZE),
+		areaThres(DEFAULT_AREA_THRES),
+		gaussSize(DEFAULT_GAUSS_SIZE),
+		gaussSigma(DEFAULT_GAUSS_SIGMA),
+		gaussPasses(DEFAULT_GAUSS_PASSES),
+		scale(DEFAULT_SCALE),
+		roiOnly(false),
+		roiMargin(DEFAULT_ROI_MARGIN) {}
+
+	int thresholdSensitivity;	// motion: threshold of the difference image
+	int blurSize;				// motion: width of the dilation, or fastmove: of the box
+								// filter, joining the difference image
+	int areaThres;				// color: smallest area tracked, in full resolution moments
+	int gaussSize;				// color: kernel size of the gaussian blurs (odd)
+	double gaussSigma;			// color: sigma of the gaussian blurs
+	int gaussPasses;			// color: number of gaussian blurs (0 - 2)
+	double scale;				// processing resolution relative to the frame (0 - 1]
+	bool roiOnly;				// color, fastmove, fastcolor: only scan around the objects
+								// found last frame
+	int roiMargin;				// color: rows scanned above and below the last object
+};
+
+/*
+* PaddleReading
+*
+* what a detector knows about one paddle after processing a frame
+*/
+struct PaddleReading {
+	int pos;			// y-value of the paddle in the frame
+	double confidence;	// how sure the detector is of pos (0 - 1)
+	bool found;			// false if the paddle was not seen, pos is then the last one seen
+};
+
+/*
+* PaddleResult
+*
+* the detection of one frame handed to a detector asynchronously or in a batch
+*/
+struct PaddleResult {
+	uint64_t frameId;
+	int64_t captureUs;		// capture time on the steady clock, in microseconds
+	int64_t latencyUs;		// from capture until the result was ready, or the time
+							// spent detecting the frame in a batch
+	PaddleReading left;
+	PaddleReading right;
+	bool skipped;			// dropped for newer frames before it was detected
+	Mat frame;				// the frame as the detector left it: mirrored and marked.
+							// empty in a batch
+};
+
+const int DEFAULT_BATCH_WARMUP = 1;
+
 /*
 * Abstract class PaddleDetector
 *
@@ -30,7 +112,8 @@ public:
 	
 	static const int DEFAULT_PADDLE_POSITION = 0;
 
-	PaddleDetector() {};
+	PaddleDetector() : m_leftPaddlePos(DEFAULT_PADDLE_POSITION), m_rightPaddlePos(DEFAULT_PADDLE_POSITION),
+		m_leftFound(false), m_rightFound(false), m_leftConfidence(0), m_rightConfidence(0) {};
 	
 	virtual ~PaddleDetector() {};
 
@@ -42,6 +125,37 @@ public:
 	 */
 	virtual void processFrame(Mat& frame) = 0;
 
+	/*
+	* detectFrame
+	*
+	* Preconditions:	frame must be a valid BGR frame, or a grayscale frame if readsGray()
+	* Postconditions:	sets the paddle positions of the left and right paddles from frame
+	*					as processFrame does, leaving frame unchanged. Detectors which do
+	*					not readsOnly() process a copy of frame.
+	*/
+	virtual void detectFrame(const Mat &frame) {
+		Mat copy = frame.clone();
+		processFrame(copy);
+	}
+
+	/*
+	* readsOnly
+	*
+	* Preconditions:	none
+	* Postconditions:	returns true if detectFrame reads frame where it is, without copying,
+	*					mirroring or marking it
+	*/
+	virtual bool readsOnly() const {return(false);}
+
+	/*
+	* readsGray
+	*
+	* Preconditions:	none
+	* Postconditions:	returns true if detectFrame also takes grayscale frames, which are
+	*					all the detector looks at
+	*/
+	virtual bool readsGray() const {return(false);}
+
 	/*
 	* Abstract get left paddle location
 	*
@@ -58,6 +172,90 @@ public:
 	*/
 	int getRightPaddleLoc() {return(m_rightPaddlePos);}
 
+	/*
+	* getLeftPaddle
+	*
+	* Preconditions:	none
+	* Postconditions:	returns the location, confidence and found state of the left paddle
+	*/
+	PaddleReading getLeftPaddle() const {
+		PaddleReading reading = {m_leftPaddlePos, m_leftConfidence, m_leftFound};
+		return(reading);
+	}
+
+	/*
+	* getRightPaddle
+	*
+	* Preconditions:	none
+	* Postconditions:	returns the location, confidence and found state of the right paddle
+	*/
+	PaddleReading getRightPaddle() const {
+		PaddleReading reading = {m_rightPaddlePos, m_rightConfidence, m_rightFound};
+		return(reading);
+	}
+
+	/*
+	* setSettings
+	*
+	* Preconditions:	settings must hold values valid for the detector
+	* Postconditions:	the detector uses settings from the next processed frame on
+	*/
+	void setSettings(const DetectorSettings &settings) {m_settings = settings;}
+
+	/*
+	* getSettings
+	*
+	* Preconditions:	none
+	* Postconditions:	returns the settings the detector is using
+	*/
+	const DetectorSettings &getSettings() const {return(m_settings);}
+
+	/*
+	* clone
+	*
+	* Preconditions:	none
+	* Postconditions:	returns a new detector with the same settings and calibration which
+	*					has processed no frames and takes its frames from processFrame
+	*					only, or nullptr if the detector can not be copied
+	*/
+	virtual PaddleDetector *clone() const {return(nullptr);}
+
+	/*
+	* scansRoi
+	*
+	* Preconditions:	none
+	* Postconditions:	returns true if the detector reads roiOnly from its settings, so
+	*					scanning only around the last objects makes it cheaper
+	*/
+	virtual bool scansRoi() const {return(false);}
+
+	/*
+	* trackWholeFrame
+	*
+	* Preconditions:	none
+	* Postconditions:	from the next frame on tracks a single object anywhere in the frame
+	*					as the left paddle, leaving the right paddle lost, and returns true.
+	*					returns false if the detector can only track the two halves.
+	*/
+	virtual bool trackWholeFrame() {return(false);}
+
+	/*
+	* processFrames
+	*
+	* detects the paddles in a batch of recorded frames, spread over all cores. The
+	* batch is split into chunks of consecutive frames, each detected by its own clone
+	* of this detector. A clone first processes the warmup frames before its chunk,
+	* so motion has the frame before the first of the chunk to compare it with.
+	*
+	* Preconditions:	frames must be consecutive BGR frames of video, or grayscale frames
+	*					if readsOnly() and readsGray()
+	* Postconditions:	returns the results of the frames in order, numbered from
+	*					firstFrameId, and returns true. returns false if the detector can
+	*					not be cloned. frames are not changed.
+	*/
+	bool processFrames(const vector<Mat> &frames, vector<PaddleResult> &results,
+					   uint64_t firstFrameId = 0, int warmup = DEFAULT_BATCH_WARMUP) const;
+
 protected:
 	/*
 	* m_leftPaddlePos
@@ -71,7 +269,72 @@ protected:
 	*/
 	int m_rightPaddlePos;
 
+	/*
+	* m_settings
+	* the tunable parameters the frames are processed with
+	*/
+	DetectorSettings m_settings;
+
+	/*
+	* m_leftFound, m_rightFound
+	* whether each paddle was seen in the last frame processed, and how sure of it
+	* the detector is (0 - 1)
+	*/
+	bool m_leftFound;
+	bool m_rightFound;
+	double m_leftConfidence;
+	double m_rightConfidence;
+
+	/*
+	* setPaddle
+	*
+	* Preconditions:	confidence must be between 0 and 1
+	* Postconditions:	sets the position of the paddle indicated by isRight to y and marks
+	*					it found with confidence
+	*/
+	void setPaddle(bool isRight, int y, double confidence) {
+		if(isRight) {
+			m_rightPaddlePos = y;
+			m_rightFound = true;
+			m_rightConfidence = confidence;
+		} else {
+			m_leftPaddlePos = y;
+			m_leftFound = true;
+			m_leftConfidence = confidence;
+		}
+	}
+
+	/*
+	* losePaddle
+	*
+	* Preconditions:	none
+	* Postconditions:	marks the paddle indicated by isRight not found, keeping its last
+	*					position
+	*/
+	void losePaddle(bool isRight) {
+		if(isRight) {
+			m_rightFound = false;
+			m_rightConfidence = 0;
+		} else {
+			m_leftFound = false;
+			m_leftConfidence = 0;
+		}
+	}
+
+	/*
+	* drawCrosshair
+	*
+	* Preconditions:	frame must be a BGR image
+	* Postconditions:	draws a crosshair in color through at on frame, marking the object
+	*					being tracked
+	*/
+	void drawCrosshair(Mat &frame, Point at, const Scalar &color);
+
 private:
+	// the outline of the crosshair's circle, kept between frames. circle() would
+	// build a new one on every call
+	vector<Point> m_crosshair;
+
 	/*
 	* Abstract configure
 	*
@@ -0,0 +1,137 @@
+/*
+* PipelinePaddleDetector class
+*
+* a detector assembled at compile time from the stages in DetectorPipeline.h. The
+* pipeline runs over the frame in one pass and its locator gives the position of
+* the object in the left and right halves of the frame.
+*
+*/
+#ifndef PIPELINEPADDLEDETECTOR_H
+#define PIPELINEPADDLEDETECTOR_H
+#include "DetectorPipeline.h"
+
+template<class P>
+class PipelinePaddleDetector : public PaddleDetector {
+public:
+	/*
+	* PipelinePaddleDetector constructor
+	*
+	* preconditions:	vid must be a valid VideoCapture object pointer if the source of
+	*					the pipeline should read its frames itself, or nullptr
+	* postconditions:	sets left and right paddles to default position, sets m_vid to
+	*					vid and runs frames through a copy of pipeline
+	*/
+	PipelinePaddleDetector(VideoCapture *vid, const P &pipeline = P()) :
+		PaddleDetector(), m_vid(vid), m_pipeline(pipeline) {
+		m_leftPaddlePos = DEFAULT_PADDLE_POSITION;
+		m_rightPaddlePos = DEFAULT_PADDLE_POSITION;
+	}
+
+	/*
+	* PipelinePaddleDetector destructor
+	*
+	* preconditions:	none
+	* postconditions:	none
+	*/
+	~PipelinePaddleDetector() {}
+
+	/*
+	* processFrame
+	*
+	* runs the pipeline over the frame, with the stages set from the detector settings,
+	* and tracks the object it locates in the left and right halves of the frame. With
+	* roiOnly set and both paddles found on the last frame only the rows around them
+	* are thresholded.
+	*
+	* preconditions:	frame must be a valid Mat object representing a single frame from
+	*					from a VideoCapture object
+	* postconditions:	sets left and right paddles according to the object located in the
+	*					left and right halves of the frame, respectively
+	*/
+	virtual void processFrame(Mat &frame) {
+		if(!m_source.acquire(frame, m_vid)) return;
+
+		m_pipeline.configure(m_settings);
+
+		int top = 0;
+		int bottom = m_source.rows();
+		if(m_settings.roiOnly && m_leftFound && m_rightFound) {
+			top = std::max(top, std::min(m_leftPaddlePos, m_rightPaddlePos) - m_settings.roiMargin);
+			bottom = std::min(bottom, std::max(m_leftPaddlePos, m_rightPaddlePos) + m_settings.roiMargin + 1);
+		}
+		m_pipeline.run(m_source, top, bottom);
+
+		Mat none;
+		detectMotion(none, frame, IS_RED);
+		detectMotion(none, frame, IS_BLUE);
+	}
+
+	/*
+	* clone
+	*
+	* preconditions:	none
+	* postconditions:	returns a new detector with the same settings and stages which has
+	*					processed no frames
+	*/
+	virtual PaddleDetector *clone() const {
+		PipelinePaddleDetector *copy = new PipelinePaddleDetector(nullptr, m_pipeline);
+		copy->setSettings(m_settings);
+		return(copy);
+	}
+
+	/*
+	* scansRoi
+	*
+	* preconditions:	none
+	* postconditions:	returns true, processFrame reads roiOnly
+	*/
+	virtual bool scansRoi() const {return(true);}
+
+	/*
+	* pipeline
+	*
+	* preconditions:	none
+	* postconditions:	returns the pipeline so the parameters of its stages can be tuned
+	*/
+	P &pipeline() {return(m_pipeline);}
+
+private:
+	/*
+	* detectMotion
+	*
+	* the pipeline never builds a threshold image, the object was already located
+	* while the pipeline ran, so thres is not used.
+	*
+	* preconditions:	the pipeline must have run over frame. isRight should be set true
+	*					for the right half of the frame.
+	* postconditions:	sets the paddle position of the paddle indicated by isRight and draws
+	*					a crosshair around the object being tracked
+	*/
+	void detectMotion(Mat &, Mat &frame, bool isRight) {
+		int zone = isRight ? 1 : 0;
+		if(!m_pipeline.locate().found(zone)) {
+			losePaddle(isRight);
+			return;
+		}
+
+		Point center = m_pipeline.locate().center(zone);
+		int x = center.x;
+		int y = center.y;
+
+		// the pipeline only locates an object above its area threshold
+		setPaddle(isRight, y, 1.0);
+		Scalar color = isRight ? BLUE : RED;
+
+		// draw crosshairs through the point being tracked in the frame
+		drawCrosshair(frame, Point(x, y), color);
+	}
+
+	VideoCapture *m_vid;
+	P m_pipeline;
+	typename P::SourceType m_source;
+};
+
+typedef PipelinePaddleDetector<pipeline::MotionPipeline> FusedMotionPaddleDetector;
+typedef PipelinePaddleDetector<pipeline::ColorPipeline> FusedColorPaddleDetector;
+
+#endif
@@ -0,0 +1,283 @@
+/*
+* PlayerStreams class
+*
+* a frame source and a detection thread for each player, merged into the ticks of
+* one game
+*
+*/
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include "PlayerStreams.h"
+#include "Trace.h"
+
+/*
+* PlayerStreams constructor
+*
+* preconditions:	detector must be able to clone itself
+* postconditions:	opens leftSource and rightSource and starts a clone of detector on
+*					each, tracking the whole frame. isOpen() is false if either source
+*					could not be opened or detector could not be cloned or can not track
+*					the whole frame.
+*/
+PlayerStreams::PlayerStreams(const string &leftSource, const string &rightSource, const PaddleDetector &detector) {
+	m_open = false;
+	m_replay = false;
+	m_replayStartUs = 0;
+	m_firstRecordedUs = 0;
+	m_paced = false;
+	const string names[2] = {leftSource, rightSource};
+	for(int side = 0; side < 2; side++) {
+		m_sources[side].raw = nullptr;
+		m_sources[side].nextRaw = 0;
+		m_sources[side].camera = false;
+		m_detectors[side] = nullptr;
+		m_async[side] = nullptr;
+		m_pending[side] = 0;
+	}
+
+	// a player's frame is their own, a bystander in the other half of it must not be
+	// able to take their paddle over
+	for(int side = 0; side < 2; side++) {
+		if(!open(m_sources[side], names[side])) return;
+		m_detectors[side] = detector.clone();
+		if(m_detectors[side] == nullptr || !m_detectors[side]->trackWholeFrame()) return;
+	}
+	m_replay = !m_sources[0].camera && !m_sources[1].camera;
+
+	for(int side = 0; side < 2; side++) {
+		m_async[side] = new AsyncPaddleDetector(m_detectors[side]);
+	}
+	m_open = true;
+}
+
+/*
+* PlayerStreams destructor
+*
+* preconditions:	none
+* postconditions:	stops the detection threads and closes the sources
+*/
+PlayerStreams::~PlayerStreams() {
+	// the threads may still hand in results, they stop before anything is freed
+	for(int side = 0; side < 2; side++) {
+		delete m_async[side];
+	}
+	for(int side = 0; side < 2; side++) {
+		delete m_detectors[side];
+		m_sources[side].cap.release();
+		m_decoded[side].release();
+		m_shown[side].release();
+		m_results[side].clear();
+		// the frames above may have been views into the mapping
+		delete m_sources[side].raw;
+	}
+}
+
+/*
+* capture
+*
+* reads a frame from each source, grabbing both before decoding either so the
+* two frames are taken as close together as the cameras allow
+*
+* preconditions:	isOpen() must be true
+* postconditions:	submits the frames for detection as the frames of tick. returns
+*					false if either source has no more frames.
+*/
+bool PlayerStreams::capture(uint64_t tick) {
+	TRACE_SCOPE("capture");
+	if(!grab(m_sources[0]) || !grab(m_sources[1])) return(false);
+	if(m_replay) {
+		pace();
+	}
+	int64_t captureUs = AsyncPaddleDetector::nowUs();
+
+	for(int side = 0; side < 2; side++) {
+		bool isRight = side == 1;
+		Mat frame = retrieve(m_sources[side], m_decoded[side]);
+		if(frame.empty()) return(false);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending[side]++;
+		}
+		m_async[side]->submit(frame, tick, captureUs, [this, isRight](const PaddleResult &result) {
+			collect(isRight, result);
+		});
+	}
+	return(true);
+}
+
+/*
+* apply
+*
+* preconditions:	none
+* postconditions:	hands the paddles of the results which came in since the last call
+*					to board, each for the tick its frame was captured in. A replay
+*					first waits for the results of every frame captured.
+*/
+void PlayerStreams::apply(GameBoard &board) {
+	std::deque<PaddleResult> results[2];
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		// a replay applies every detection in the tick of its frame, whenever the
+		// detection threads get to run, so its game does not depend on them
+		if(m_replay) {
+			TRACE_SCOPE("replay.wait");
+			m_collected.wait(lock, [this] {return(m_pending[0] == 0 && m_pending[1] == 0);});
+		}
+		for(int side = 0; side < 2; side++) {
+			results[side].swap(m_results[side]);
+		}
+	}
+
+	// a player who was not seen is left to the board's prediction
+	for(int side = 0; side < 2; side++) {
+		for(size_t i = 0; i < results[side].size(); i++) {
+			int y;
+			if(readPaddle(results[side][i], y)) {
+				board.detect(results[side][i].frameId, side == 1, y);
+			}
+		}
+	}
+}
+
+/*
+* background
+*
+* preconditions:	none
+* postconditions:	returns the latest frame detected of each player side by side at
+*					the size of the gameboard, left player on the left, as a new Mat
+*/
+Mat PlayerStreams::background() {
+	Mat board = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(int side = 0; side < 2; side++) {
+		if(m_shown[side].empty()) continue;
+		Mat half = board(Rect(side * (DEFAULT_X / 2), 0, DEFAULT_X / 2, DEFAULT_Y));
+		resize(m_shown[side], half, half.size(), 0, 0, INTER_AREA);
+	}
+	return(board);
+}
+
+/*
+* open
+*
+* preconditions:	none
+* postconditions:	opens name into source and returns true, or returns false
+*/
+bool PlayerStreams::open(Source &source, const string &name) {
+	if(isRawFrameFile(name)) {
+		source.raw = new RawFrameReader(name);
+		return(source.raw->isOpen());
+	}
+
+	// a name made only of digits is a camera
+	if(!name.empty() && name.find_first_not_of("0123456789") == string::npos) {
+		source.camera = true;
+		source.cap.open(atoi(name.c_str()));
+		source.cap.set(CV_CAP_PROP_FPS, 15);
+	} else {
+		source.cap.open(name);
+	}
+	return(source.cap.isOpened());
+}
+
+/*
+* grab
+*
+* preconditions:	source must be open
+* postconditions:	takes the next frame of source without decoding it, or returns false
+*/
+bool PlayerStreams::grab(Source &source) {
+	if(source.raw != nullptr) {
+		return(source.nextRaw < source.raw->getFrameCount());
+	}
+	return(source.cap.grab());
+}
+
+/*
+* retrieve
+*
+* preconditions:	grab must have returned true
+* postconditions:	returns the frame grabbed from source
+*/
+Mat PlayerStreams::retrieve(Source &source, Mat &decoded) {
+	if(source.raw != nullptr) {
+		// submit copies the frame, a view into the mapping is enough here
+		return(source.raw->bgr(source.nextRaw++, decoded));
+	}
+	if(!source.cap.retrieve(decoded)) {
+		decoded.release();
+	}
+	return(decoded);
+}
+
+/*
+* recordedUs
+*
+* preconditions:	grab must have returned true for a source which is not a camera
+* postconditions:	returns when the frame grabbed was captured in the recording, in
+*					microseconds
+*/
+int64_t PlayerStreams::recordedUs(Source &source) {
+	if(source.raw != nullptr) {
+		return(source.raw->getTimestamp(source.nextRaw));
+	}
+	return(static_cast<int64_t>(source.cap.get(CV_CAP_PROP_POS_MSEC) * 1000));
+}
+
+/*
+* pace
+*
+* preconditions:	the frames of a replay must have been grabbed
+* postconditions:	waits until the left frame is as far into the replay as it was into
+*					its recording
+*/
+void PlayerStreams::pace() {
+	int64_t recorded = recordedUs(m_sources[0]);
+	if(!m_paced) {
+		m_replayStartUs = AsyncPaddleDetector::nowUs();
+		m_firstRecordedUs = recorded;
+		m_paced = true;
+	}
+
+	int64_t waitUs = m_replayStartUs + (recorded - m_firstRecordedUs) - AsyncPaddleDetector::nowUs();
+	if(waitUs > 0) {
+		TRACE_SCOPE("pace");
+		std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+	}
+}
+
+/*
+* collect
+*
+* preconditions:	called on a detection thread
+* postconditions:	queues result of the player indicated by isRight for apply
+*/
+void PlayerStreams::collect(bool isRight, const PaddleResult &result) {
+	int side = isRight ? 1 : 0;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pending[side]--;
+	m_collected.notify_all();
+	if(result.skipped) return;
+	m_results[side].push_back(result);
+	m_shown[side] = result.frame;
+}
+
+/*
+* readPaddle
+*
+* each player has the whole frame of their source to themselves, which their
+* detector tracks as its left paddle
+*
+* preconditions:	result must not be skipped
+* postconditions:	sets y to the paddle of a player in their own frame, scaled to the
+*					height of the gameboard, and returns true, or returns false if the
+*					player was not seen
+*/
+bool PlayerStreams::readPaddle(const PaddleResult &result, int &y) {
+	const PaddleReading &reading = result.left;
+	if(!reading.found || result.frame.rows <= 0) return(false);
+
+	y = reading.pos * DEFAULT_Y / result.frame.rows;
+	return(true);
+}
@@ -0,0 +1,192 @@
+/*
+* PlayerStreams class
+*
+* gives each player a frame source of their own instead of splitting one camera's
+* frame into halves. Every source keeps its full resolution and has its own clone
+* of the detector running on its own thread, so the detection work of the two
+* players is spread over two cores. A frame is tagged with the tick of the game it
+* was captured in, and its result is handed to GameBoard::detect for that tick, so
+* a player whose detection comes in late has the game rolled back to when the
+* frame was taken rather than their paddle moved late.
+*
+* A source is a camera index, a video file or a raw frame file, so a game can be
+* replayed from two recordings. A replay is paced by the capture times of the left
+* recording and runs in lockstep: every frame is detected, and each tick waits for
+* the detections of its frames, so replaying the same recordings plays the same game
+* however the threads are scheduled.
+*
+* Each clone tracks a single object in the whole frame, the player's own frame having
+* no other player in it.
+*
+*/
+#ifndef PLAYERSTREAMS_H
+#define PLAYERSTREAMS_H
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include "AsyncPaddleDetector.h"
+#include "GameBoard.h"
+#include "RawFrameFile.h"
+
+class PlayerStreams {
+public:
+	/*
+	* PlayerStreams constructor
+	*
+	* preconditions:	detector must be able to clone itself
+	* postconditions:	opens leftSource and rightSource and starts a clone of detector on
+	*					each, tracking the whole frame. isOpen() is false if either source
+	*					could not be opened or detector could not be cloned or can not track
+	*					the whole frame.
+	*/
+	PlayerStreams(const string &leftSource, const string &rightSource, const PaddleDetector &detector);
+
+	/*
+	* PlayerStreams destructor
+	*
+	* preconditions:	none
+	* postconditions:	stops the detection threads and closes the sources
+	*/
+	~PlayerStreams();
+
+	bool isOpen() const {return(m_open);}
+
+	/*
+	* isReplay
+	*
+	* preconditions:	none
+	* postconditions:	returns true if neither source is a camera
+	*/
+	bool isReplay() const {return(m_replay);}
+
+	/*
+	* capture
+	*
+	* reads a frame from each source, grabbing both before decoding either so the
+	* two frames are taken as close together as the cameras allow. A replay waits
+	* until the left frame is due by the capture times of its recording.
+	*
+	* preconditions:	isOpen() must be true
+	* postconditions:	submits the frames for detection as the frames of tick. returns
+	*					false if either source has no more frames.
+	*/
+	bool capture(uint64_t tick);
+
+	/*
+	* apply
+	*
+	* preconditions:	none
+	* postconditions:	hands the paddles of the results which came in since the last call
+	*					to board, each for the tick its frame was captured in. A replay
+	*					first waits for the results of every frame captured.
+	*/
+	void apply(GameBoard &board);
+
+	/*
+	* background
+	*
+	* preconditions:	none
+	* postconditions:	returns the latest frame detected of each player side by side at
+	*					the size of the gameboard, left player on the left, as a new Mat
+	*/
+	Mat background();
+
+private:
+	PlayerStreams(const PlayerStreams &);
+	PlayerStreams &operator=(const PlayerStreams &);
+
+	/*
+	* Source
+	*
+	* where the frames of one player come from
+	*/
+	struct Source {
+		VideoCapture cap;
+		RawFrameReader *raw;	// the raw frame file played instead of cap, or nullptr
+		uint64_t nextRaw;
+		bool camera;
+	};
+
+	/*
+	* open
+	*
+	* preconditions:	none
+	* postconditions:	opens name into source and returns true, or returns false
+	*/
+	static bool open(Source &source, const string &name);
+
+	/*
+	* grab
+	*
+	* preconditions:	source must be open
+	* postconditions:	takes the next frame of source without decoding it, or returns false
+	*/
+	static bool grab(Source &source);
+
+	/*
+	* retrieve
+	*
+	* preconditions:	grab must have returned true
+	* postconditions:	returns the frame grabbed from source
+	*/
+	static Mat retrieve(Source &source, Mat &decoded);
+
+	/*
+	* recordedUs
+	*
+	* preconditions:	grab must have returned true for a source which is not a camera
+	* postconditions:	returns when the frame grabbed was captured in the recording, in
+	*					microseconds
+	*/
+	static int64_t recordedUs(Source &source);
+
+	/*
+	* pace
+	*
+	* preconditions:	the frames of a replay must have been grabbed
+	* postconditions:	waits until the left frame is as far into the replay as it was into
+	*					its recording
+	*/
+	void pace();
+
+	/*
+	* collect
+	*
+	* preconditions:	called on a detection thread
+	* postconditions:	queues result of the player indicated by isRight for apply
+	*/
+	void collect(bool isRight, const PaddleResult &result);
+
+	/*
+	* readPaddle
+	*
+	* preconditions:	result must not be skipped
+	* postconditions:	sets y to the paddle of a player in their own frame, scaled to the
+	*					height of the gameboard, and returns true, or returns false if the
+	*					player was not seen
+	*/
+	static bool readPaddle(const PaddleResult &result, int &y);
+
+	bool m_open;
+	bool m_replay;
+	Source m_sources[2];
+	Mat m_decoded[2];
+
+	// when the replay started, and when its first left frame was recorded
+	int64_t m_replayStartUs;
+	int64_t m_firstRecordedUs;
+	bool m_paced;
+
+	// results of both players waiting for apply, the frames submitted which have no
+	// result yet, and the latest frames shown
+	std::mutex m_mutex;
+	std::condition_variable m_collected;
+	std::deque<PaddleResult> m_results[2];
+	int m_pending[2];
+	Mat m_shown[2];
+
+	PaddleDetector *m_detectors[2];
+	AsyncPaddleDetector *m_async[2];
+};
+
+#endif
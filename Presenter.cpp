@@ -0,0 +1,31 @@
+/*
+* Presenter class
+*
+* an interface to the display backend which shows the composited gameboard and
+* pumps the window's events.
+*
+*/
+#include "Presenter.h"
+#include "HighguiPresenter.h"
+#ifdef CVPONG_X11
+#include "X11ShmPresenter.h"
+#endif
+
+/*
+* createPresenter
+*
+* preconditions:	none
+* postconditions:	returns the fastest presenter available for a window called title.
+*					the X11 shared memory presenter is used when it was built in with
+*					CVPONG_X11 and the display supports it, highgui otherwise.
+*/
+Presenter *createPresenter(const string &title) {
+#ifdef CVPONG_X11
+	X11ShmPresenter *x11 = new X11ShmPresenter(title);
+	if(x11->isOpen()) {
+		return(x11);
+	}
+	delete x11;
+#endif
+	return(new HighguiPresenter(title));
+}
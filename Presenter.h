@@ -0,0 +1,55 @@
+/*
+* Presenter class
+*
+* an interface to the display backend which shows the composited gameboard and
+* pumps the window's events. The game draws into its own buffer and hands it to the
+* presenter once per frame instead of calling highgui directly.
+*
+*/
+#ifndef PRESENTER_H
+#define PRESENTER_H
+#include <string>
+#include <opencv2/core/core.hpp>
+using namespace cv;
+using namespace std;
+
+class Presenter {
+public:
+	/*
+	* Presenter destructor
+	*
+	* preconditions:	none
+	* postconditions:	closes the window
+	*/
+	virtual ~Presenter() {}
+
+	/*
+	* present
+	*
+	* preconditions:	frame must be a BGR image
+	* postconditions:	shows frame in the window, sizing the window to frame
+	*/
+	virtual void present(const Mat &frame) = 0;
+
+	/*
+	* pollKey
+	*
+	* preconditions:	none
+	* postconditions:	handles the window's pending events and returns the key pressed,
+	*					or -1 if none was. waits up to waitMs for a key, 0 does not wait
+	*					and a negative waitMs waits until a key is pressed.
+	*/
+	virtual int pollKey(int waitMs = 0) = 0;
+};
+
+/*
+* createPresenter
+*
+* preconditions:	none
+* postconditions:	returns the fastest presenter available for a window called title.
+*					the X11 shared memory presenter is used when it was built in with
+*					CVPONG_X11 and the display supports it, highgui otherwise.
+*/
+Presenter *createPresenter(const string &title);
+
+#endif
@@ -0,0 +1,333 @@
+/*
+* RawFrameFile classes
+*
+* an indexed file of uncompressed frames, written by RawFrameWriter and mapped into
+* memory by RawFrameReader
+*
+*/
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+#include "RawFrameFile.h"
+
+static const char RAW_MAGIC[8] = {'C', 'V', 'P', 'R', 'A', 'W', 0, 0};
+// version 1 stored the I420 planes in the video range, which the Y plane of a
+// version 2 file no longer is
+static const uint32_t RAW_VERSION = 2;
+
+static uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+	return((offset + alignment - 1) / alignment * alignment);
+}
+
+/*
+* frameBytes
+*
+* preconditions:	none
+* postconditions:	returns the bytes of the pixels of a frame of width and height stored
+*					as format, or 0 if format is unknown
+*/
+static uint64_t frameBytes(uint32_t width, uint32_t height, uint32_t format) {
+	uint64_t pixels = static_cast<uint64_t>(width) * height;
+	if(format == RAW_BGR) return(pixels * 3);
+	if(format == RAW_I420) return(pixels * 3 / 2);
+	return(0);
+}
+
+/*
+* RawFrameWriter constructor
+*
+* preconditions:	size must not be empty, with an even width and height for RAW_I420
+* postconditions:	creates (or replaces) the file at path for frames of size stored as
+*					format. isOpen() is false if it could not be created.
+*/
+RawFrameWriter::RawFrameWriter(const string &path, Size size, RawFrameFormat format) {
+	memset(&m_header, 0, sizeof(m_header));
+	memcpy(m_header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+	m_header.version = RAW_VERSION;
+	m_header.format = format;
+	m_header.width = size.width;
+	m_header.height = size.height;
+	m_header.frameBytes = frameBytes(size.width, size.height, format);
+	m_end = sizeof(RawFrameHeader);
+
+	if(size.width <= 0 || size.height <= 0) return;
+	if(format == RAW_I420 && (size.width % 2 != 0 || size.height % 2 != 0)) return;
+
+	// the header is written again with the frame count and index when closing
+	m_out.open(path.c_str(), ios::binary | ios::trunc);
+	m_out.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header));
+	if(!m_out.good()) {
+		m_out.close();
+	}
+}
+
+/*
+* write
+*
+* preconditions:	frame must be a BGR frame of the size of the file
+* postconditions:	appends frame, converted to the format of the file, captured at
+*					timestampUs. returns false if frame does not fit the file or could
+*					not be written.
+*/
+bool RawFrameWriter::write(const Mat &frame, int64_t timestampUs) {
+	int width = m_header.width;
+	int height = m_header.height;
+	if(!isOpen() || frame.type() != CV_8UC3 || frame.cols != width || frame.rows != height) {
+		return(false);
+	}
+
+	const Mat *pixels = &frame;
+	if(m_header.format == RAW_I420) {
+		// the planes are laid out one after the other in a single buffer
+		m_converted.create(height * 3 / 2, width, CV_8UC1);
+		Mat y(height, width, CV_8UC1, m_converted.ptr(0));
+		Mat u(height / 2, width / 2, CV_8UC1, m_converted.ptr(height));
+		Mat v(height / 2, width / 2, CV_8UC1, m_converted.ptr(height) + (width / 2) * (height / 2));
+
+		cvtColor(frame, m_yuv, COLOR_BGR2YCrCb);
+		int lumaPair[] = {0, 0};
+		mixChannels(&m_yuv, 1, &y, 1, lumaPair, 1);
+
+		// average each 2x2 block into the chroma planes
+		resize(m_yuv, m_chroma, Size(width / 2, height / 2), 0, 0, INTER_AREA);
+		Mat planes[] = {u, v};
+		int chromaPairs[] = {2, 0, 1, 1};
+		mixChannels(&m_chroma, 1, planes, 2, chromaPairs, 2);
+		pixels = &m_converted;
+	}
+
+	// start the frame on a page boundary
+	uint64_t offset = alignUp(m_end, RAW_FRAME_ALIGN);
+	vector<char> padding(static_cast<size_t>(offset - m_end), 0);
+	if(!padding.empty()) {
+		m_out.write(&padding[0], padding.size());
+	}
+
+	size_t rowBytes = pixels->cols * pixels->elemSize();
+	if(pixels->isContinuous()) {
+		m_out.write(reinterpret_cast<const char *>(pixels->ptr(0)), rowBytes * pixels->rows);
+	} else {
+		for(int row = 0; row < pixels->rows; row++) {
+			m_out.write(reinterpret_cast<const char *>(pixels->ptr(row)), rowBytes);
+		}
+	}
+	if(!m_out.good()) return(false);
+
+	RawFrameIndexEntry entry = {timestampUs, offset};
+	m_index.push_back(entry);
+	m_end = offset + m_header.frameBytes;
+	return(true);
+}
+
+/*
+* close
+*
+* preconditions:	none
+* postconditions:	writes the index and the header and closes the file. returns false if
+*					they could not be written.
+*/
+bool RawFrameWriter::close() {
+	if(!isOpen()) return(false);
+
+	uint64_t indexOffset = alignUp(m_end, sizeof(uint64_t));
+	vector<char> padding(static_cast<size_t>(indexOffset - m_end), 0);
+	if(!padding.empty()) {
+		m_out.write(&padding[0], padding.size());
+	}
+	if(!m_index.empty()) {
+		m_out.write(reinterpret_cast<const char *>(&m_index[0]), m_index.size() * sizeof(RawFrameIndexEntry));
+	}
+
+	m_header.frameCount = m_index.size();
+	m_header.indexOffset = indexOffset;
+	m_out.seekp(0);
+	m_out.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header));
+
+	bool written = m_out.good();
+	m_out.close();
+	return(written);
+}
+
+/*
+* RawFrameReader constructor
+*
+* preconditions:	none
+* postconditions:	maps the file at path. isOpen() is false if it is not a complete
+*					raw frame file or could not be mapped.
+*/
+RawFrameReader::RawFrameReader(const string &path) {
+	m_bytes = 0;
+	m_mapping = nullptr;
+	m_header = nullptr;
+	m_index = nullptr;
+
+	// map the file copy-on-write, so frames can be changed in place without
+	// touching the file
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if(GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	}
+	CloseHandle(file);
+	if(mapping == NULL) return;
+	m_mapping = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	// the view keeps the mapping alive once the handle is closed
+	CloseHandle(mapping);
+	if(m_mapping == NULL) {
+		m_mapping = nullptr;
+		return;
+	}
+	m_bytes = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) return;
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		return;
+	}
+	void *mapping = mmap(NULL, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED) return;
+	m_mapping = mapping;
+	m_bytes = static_cast<size_t>(info.st_size);
+#endif
+
+	// check that everything the header and index point to is inside of the file
+	const unsigned char *base = reinterpret_cast<const unsigned char *>(m_mapping);
+	const RawFrameHeader *header = reinterpret_cast<const RawFrameHeader *>(base);
+	uint64_t bytes = m_bytes;
+	bool valid = bytes >= sizeof(RawFrameHeader) && memcmp(header->magic, RAW_MAGIC, sizeof(RAW_MAGIC)) == 0 &&
+				 header->version == RAW_VERSION && header->format <= RAW_I420 &&
+				 header->width > 0 && header->height > 0 &&
+				 header->frameBytes == frameBytes(header->width, header->height, header->format) &&
+				 header->indexOffset <= bytes && header->indexOffset % sizeof(uint64_t) == 0 &&
+				 header->frameCount <= (bytes - header->indexOffset) / sizeof(RawFrameIndexEntry);
+
+	const RawFrameIndexEntry *index = reinterpret_cast<const RawFrameIndexEntry *>(base + (valid ? header->indexOffset : 0));
+	for(uint64_t i = 0; valid && i < header->frameCount; i++) {
+		valid = index[i].offset <= bytes && header->frameBytes <= bytes - index[i].offset;
+	}
+
+	if(!valid) {
+		unmap();
+		return;
+	}
+	m_header = header;
+	m_index = index;
+}
+
+/*
+* RawFrameReader destructor
+*
+* preconditions:	no Mat returned by the reader may be used after it
+* postconditions:	unmaps the file
+*/
+RawFrameReader::~RawFrameReader() {
+	unmap();
+}
+
+void RawFrameReader::unmap() {
+	if(m_mapping == nullptr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_mapping);
+#else
+	munmap(m_mapping, m_bytes);
+#endif
+	m_mapping = nullptr;
+	m_header = nullptr;
+	m_index = nullptr;
+}
+
+/*
+* frame
+*
+* preconditions:	index must be less than getFrameCount()
+* postconditions:	returns frame index as stored, without copying: a BGR CV_8UC3 frame,
+*					or for RAW_I420 a CV_8UC1 image of the three planes one above the
+*					other, 1.5 times as high as the frame
+*/
+Mat RawFrameReader::frame(uint64_t index) const {
+	unsigned char *pixels = reinterpret_cast<unsigned char *>(m_mapping) + m_index[index].offset;
+	int width = m_header->width;
+	int height = m_header->height;
+	if(getFormat() == RAW_I420) {
+		return(Mat(height * 3 / 2, width, CV_8UC1, pixels));
+	}
+	return(Mat(height, width, CV_8UC3, pixels));
+}
+
+/*
+* gray
+*
+* preconditions:	index must be less than getFrameCount()
+* postconditions:	returns frame index in grayscale. For RAW_I420 that is the Y plane,
+*					the same full range image as COLOR_BGR2GRAY, returned without
+*					copying. BGR frames are converted into dest.
+*/
+Mat RawFrameReader::gray(uint64_t index, Mat &dest) const {
+	Mat stored = frame(index);
+	if(getFormat() == RAW_I420) {
+		return(stored.rowRange(0, m_header->height));
+	}
+	cvtColor(stored, dest, COLOR_BGR2GRAY);
+	return(dest);
+}
+
+/*
+* bgr
+*
+* preconditions:	index must be less than getFrameCount()
+* postconditions:	returns frame index as BGR. BGR frames are returned without copying,
+*					RAW_I420 frames are converted into dest.
+*/
+Mat RawFrameReader::bgr(uint64_t index, Mat &dest) const {
+	Mat stored = frame(index);
+	if(getFormat() != RAW_I420) return(stored);
+
+	// COLOR_YUV2BGR_I420 expects the video range, so the full range planes are
+	// interleaved into YCrCb, each chroma sample covering its 2x2 block, and
+	// converted back with COLOR_YCrCb2BGR
+	int width = m_header->width;
+	int height = m_header->height;
+	const uchar *u = stored.ptr<uchar>(height);
+	const uchar *v = u + (width / 2) * (height / 2);
+	dest.create(height, width, CV_8UC3);
+	for(int y = 0; y < height; y++) {
+		const uchar *luma = stored.ptr<uchar>(y);
+		const uchar *cb = u + (y / 2) * (width / 2);
+		const uchar *cr = v + (y / 2) * (width / 2);
+		Vec3b *pixel = dest.ptr<Vec3b>(y);
+		for(int x = 0; x < width; x++) {
+			pixel[x] = Vec3b(luma[x], cr[x / 2], cb[x / 2]);
+		}
+	}
+	cvtColor(dest, dest, COLOR_YCrCb2BGR);
+	return(dest);
+}
+
+/*
+* detectable
+*
+* preconditions:	index must be less than getFrameCount()
+* postconditions:	returns frame index the cheapest way a detector can take it. When
+*					grayOnly is set, the detector reading nothing but the grayscale
+*					image, a RAW_I420 frame is its Y plane without copying. Otherwise it
+*					is returned as bgr() returns it.
+*/
+Mat RawFrameReader::detectable(uint64_t index, bool grayOnly, Mat &dest) const {
+	if(grayOnly && getFormat() == RAW_I420) {
+		return(gray(index, dest));
+	}
+	return(bgr(index, dest));
+}
@@ -0,0 +1,230 @@
+/*
+* RawFrameFile classes
+*
+* an indexed file of uncompressed frames for offline runs, so reading a frame costs
+* nothing next to detecting in it. The file holds a header, the frames, each at an
+* offset aligned to a page, and an index with the capture time and offset of every
+* frame. Frames are stored as BGR or as planar YUV 4:2:0 (I420), whose first plane
+* is already the grayscale frame. The I420 planes are the full range YCrCb of
+* COLOR_BGR2YCrCb, as in JPEG, rather than the video range of BT.601.
+*
+* RawFrameWriter records frames. RawFrameReader maps the whole file into memory
+* and returns frames as Mat views straight into the mapping, so any frame can be
+* read at once without copying. The mapping is copy-on-write: a detector which
+* mirrors or marks a frame in place changes its own copy of those pages, never the
+* file.
+*
+*/
+#ifndef RAWFRAMEFILE_H
+#define RAWFRAMEFILE_H
+#include <fstream>
+#include <stdint.h>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+const string RAW_EXTENSION = ".cvraw";
+
+/*
+* isRawFrameFile
+*
+* preconditions:	none
+* postconditions:	returns true if path ends in RAW_EXTENSION
+*/
+inline bool isRawFrameFile(const string &path) {
+	return(path.size() > RAW_EXTENSION.size() &&
+		   path.compare(path.size() - RAW_EXTENSION.size(), RAW_EXTENSION.size(), RAW_EXTENSION) == 0);
+}
+
+// frames start on page boundaries, which keeps their rows aligned for SSE
+const uint64_t RAW_FRAME_ALIGN = 4096;
+
+/*
+* RawFrameFormat
+*
+* how the pixels of the frames are stored
+*/
+enum RawFrameFormat {
+	RAW_BGR = 0,	// CV_8UC3 rows of blue, green and red
+	RAW_I420 = 1	// the Y plane, then the U and V planes at half width and height
+};
+
+/*
+* RawFrameHeader
+*
+* the start of the file. Every field is little-endian.
+*/
+struct RawFrameHeader {
+	char magic[8];			// "CVPRAW\0\0"
+	uint32_t version;
+	uint32_t format;		// a RawFrameFormat
+	uint32_t width;
+	uint32_t height;
+	uint64_t frameCount;
+	uint64_t frameBytes;	// bytes of the pixels of one frame
+	uint64_t indexOffset;	// where the index of frameCount entries starts
+	uint8_t reserved[16];
+};
+
+/*
+* RawFrameIndexEntry
+*
+* where one frame is stored and when it was captured
+*/
+struct RawFrameIndexEntry {
+	int64_t timestampUs;
+	uint64_t offset;
+};
+
+class RawFrameWriter {
+public:
+	/*
+	* RawFrameWriter constructor
+	*
+	* preconditions:	size must not be empty, with an even width and height for RAW_I420
+	* postconditions:	creates (or replaces) the file at path for frames of size stored as
+	*					format. isOpen() is false if it could not be created.
+	*/
+	RawFrameWriter(const string &path, Size size, RawFrameFormat format = RAW_BGR);
+
+	/*
+	* RawFrameWriter destructor
+	*
+	* preconditions:	none
+	* postconditions:	closes the file, writing its index
+	*/
+	~RawFrameWriter() {close();}
+
+	bool isOpen() const {return(m_out.is_open());}
+
+	/*
+	* write
+	*
+	* preconditions:	frame must be a BGR frame of the size of the file
+	* postconditions:	appends frame, converted to the format of the file, captured at
+	*					timestampUs. returns false if frame does not fit the file or could
+	*					not be written.
+	*/
+	bool write(const Mat &frame, int64_t timestampUs);
+
+	/*
+	* close
+	*
+	* preconditions:	none
+	* postconditions:	writes the index and the header and closes the file. returns false if
+	*					they could not be written.
+	*/
+	bool close();
+
+	/*
+	* getFrameCount
+	*
+	* preconditions:	none
+	* postconditions:	returns the number of frames written
+	*/
+	uint64_t getFrameCount() const {return(m_index.size());}
+
+private:
+	RawFrameWriter(const RawFrameWriter &);
+	RawFrameWriter &operator=(const RawFrameWriter &);
+
+	ofstream m_out;
+	RawFrameHeader m_header;
+	vector<RawFrameIndexEntry> m_index;
+	uint64_t m_end;
+
+	// the frame being written, converted to the format of the file
+	Mat m_converted;
+	Mat m_yuv;
+	Mat m_chroma;
+};
+
+class RawFrameReader {
+public:
+	/*
+	* RawFrameReader constructor
+	*
+	* preconditions:	none
+	* postconditions:	maps the file at path. isOpen() is false if it is not a complete
+	*					raw frame file or could not be mapped.
+	*/
+	explicit RawFrameReader(const string &path);
+
+	/*
+	* RawFrameReader destructor
+	*
+	* preconditions:	no Mat returned by the reader may be used after it
+	* postconditions:	unmaps the file
+	*/
+	~RawFrameReader();
+
+	bool isOpen() const {return(m_header != nullptr);}
+
+	uint64_t getFrameCount() const {return(m_header->frameCount);}
+	Size getSize() const {return(Size(m_header->width, m_header->height));}
+	RawFrameFormat getFormat() const {return(static_cast<RawFrameFormat>(m_header->format));}
+
+	/*
+	* getTimestamp
+	*
+	* preconditions:	index must be less than getFrameCount()
+	* postconditions:	returns the time frame index was captured, in microseconds
+	*/
+	int64_t getTimestamp(uint64_t index) const {return(m_index[index].timestampUs);}
+
+	/*
+	* frame
+	*
+	* preconditions:	index must be less than getFrameCount()
+	* postconditions:	returns frame index as stored, without copying: a BGR CV_8UC3 frame,
+	*					or for RAW_I420 a CV_8UC1 image of the three planes one above the
+	*					other, 1.5 times as high as the frame
+	*/
+	Mat frame(uint64_t index) const;
+
+	/*
+	* gray
+	*
+	* preconditions:	index must be less than getFrameCount()
+	* postconditions:	returns frame index in grayscale. For RAW_I420 that is the Y plane,
+	*					the same full range image as COLOR_BGR2GRAY, returned without
+	*					copying. BGR frames are converted into dest.
+	*/
+	Mat gray(uint64_t index, Mat &dest) const;
+
+	/*
+	* bgr
+	*
+	* preconditions:	index must be less than getFrameCount()
+	* postconditions:	returns frame index as BGR. BGR frames are returned without copying,
+	*					RAW_I420 frames are converted into dest.
+	*/
+	Mat bgr(uint64_t index, Mat &dest) const;
+
+	/*
+	* detectable
+	*
+	* preconditions:	index must be less than getFrameCount()
+	* postconditions:	returns frame index the cheapest way a detector can take it. When
+	*					grayOnly is set, the detector reading nothing but the grayscale
+	*					image, a RAW_I420 frame is its Y plane without copying. Otherwise it
+	*					is returned as bgr() returns it.
+	*/
+	Mat detectable(uint64_t index, bool grayOnly, Mat &dest) const;
+
+private:
+	RawFrameReader(const RawFrameReader &);
+	RawFrameReader &operator=(const RawFrameReader &);
+
+	void unmap();
+
+	size_t m_bytes;
+	void *m_mapping;
+	const RawFrameHeader *m_header;
+	const RawFrameIndexEntry *m_index;
+};
+
+#endif
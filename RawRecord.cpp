@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <opencv2/highgui/highgui.hpp>
+#include "RawFrameFile.h"
+using namespace std;
+
+/*
+* main
+*
+* records a video file, or a camera given by its index, into a raw frame file which
+* batch maps instead of decoding. Frames are timestamped with their position in the
+* video, or with the clock for a camera.
+*
+* usage: rawrecord <video|camera index> <output.cvraw> [bgr|i420] [max frames]
+*
+*/
+int main(int argc, char *argv[]) {
+	if(argc < 3) {
+		cout << "usage: rawrecord <video|camera index> <output" << RAW_EXTENSION << "> [bgr|i420] [max frames]" << endl;
+		return(-1);
+	}
+
+	string source = argv[1];
+	string output = argv[2];
+	RawFrameFormat format = argc > 3 && string(argv[3]) == "i420" ? RAW_I420 : RAW_BGR;
+	long maxFrames = argc > 4 ? atol(argv[4]) : 0;
+
+	// a source made only of digits is a camera
+	bool camera = source.find_first_not_of("0123456789") == string::npos;
+	VideoCapture cap;
+	if(camera) {
+		cap.open(atoi(source.c_str()));
+	} else {
+		cap.open(source);
+	}
+	if(!cap.isOpened()) {
+		cout << "Could not open " << source << endl;
+		return(-1);
+	}
+
+	Mat frame;
+	if(!cap.read(frame)) {
+		cout << source << " has no frames" << endl;
+		return(-1);
+	}
+
+	RawFrameWriter writer(output, frame.size(), format);
+	if(!writer.isOpen()) {
+		cout << "Could not create " << output << endl;
+		return(-1);
+	}
+
+	int64 start = getTickCount();
+	do {
+		int64_t timestampUs;
+		if(camera) {
+			timestampUs = static_cast<int64_t>((getTickCount() - start) * 1000000.0 / getTickFrequency());
+		} else {
+			timestampUs = static_cast<int64_t>(cap.get(CV_CAP_PROP_POS_MSEC) * 1000);
+		}
+		if(!writer.write(frame, timestampUs)) {
+			cout << "Could not write frame " << writer.getFrameCount() << " to " << output << endl;
+			return(-1);
+		}
+	} while((maxFrames <= 0 || static_cast<long>(writer.getFrameCount()) < maxFrames) && cap.read(frame));
+
+	uint64_t frames = writer.getFrameCount();
+	if(!writer.close()) {
+		cout << "Could not write the index of " << output << endl;
+		return(-1);
+	}
+	cout << "Recorded " << frames << " frames to " << output << endl;
+	return(0);
+}
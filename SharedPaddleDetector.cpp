@@ -0,0 +1,72 @@
+/*
+* SharedPaddleDetector class
+*
+* a class which takes the paddle positions, and the frame they were detected in,
+* from a detector running in another process through a SharedPaddleRing instead of
+* detecting them itself.
+*
+*/
+#include "SharedPaddleDetector.h"
+
+/*
+* SharedPaddleDetector constructor
+*
+* preconditions:	none
+* postconditions:	sets left and right paddles to default position and opens the ring
+*					called name. isOpen() is false if the detector process is not running.
+*/
+SharedPaddleDetector::SharedPaddleDetector(const string &name) : PaddleDetector(), m_ring(name) {
+	m_leftPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_rightPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_sample.timestampUs = 0;
+	m_sample.frameId = 0;
+	m_sample.leftPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_sample.rightPaddlePos = DEFAULT_PADDLE_POSITION;
+	m_sample.leftConfidence = 0;
+	m_sample.rightConfidence = 0;
+	m_sample.leftFound = false;
+	m_sample.rightFound = false;
+	m_published = 0;
+}
+
+/*
+* processFrame
+*
+* waits for the detector process to publish a new sample and takes its paddle
+* positions and frame.
+*
+* preconditions:	none
+* postconditions:	sets left and right paddles to the newest published sample and
+*					copies the frame it was detected in into frame. the paddles and
+*					frame are left as they were if nothing new was published in time.
+*/
+void SharedPaddleDetector::processFrame(Mat &frame) {
+	// the game runs at the pace of the detector process
+	if(!m_ring.waitForPublish(m_published, WAIT_MS)) return;
+
+	if(m_ring.readLatest(m_sample, &frame)) {
+		m_published = m_ring.getPublished();
+		takePaddle(IS_RED, m_sample.leftPaddlePos, m_sample.leftFound, m_sample.leftConfidence);
+		takePaddle(IS_BLUE, m_sample.rightPaddlePos, m_sample.rightFound, m_sample.rightConfidence);
+	}
+}
+
+/*
+* takePaddle
+*
+* preconditions:	none
+* postconditions:	sets the paddle indicated by isRight as the detector process left it
+*/
+void SharedPaddleDetector::takePaddle(bool isRight, int pos, bool found, double confidence) {
+	if(found) {
+		setPaddle(isRight, pos, confidence);
+		return;
+	}
+	// the position of a lost paddle is the last one the detector process saw
+	if(isRight) {
+		m_rightPaddlePos = pos;
+	} else {
+		m_leftPaddlePos = pos;
+	}
+	losePaddle(isRight);
+}
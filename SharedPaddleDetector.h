@@ -0,0 +1,79 @@
+/*
+* SharedPaddleDetector class
+*
+* a class which takes the paddle positions, and the frame they were detected in,
+* from a detector running in another process through a SharedPaddleRing instead of
+* detecting them itself.
+*
+*/
+#ifndef SHAREDPADDLEDETECTOR_H
+#define SHAREDPADDLEDETECTOR_H
+#include "SharedPaddleRing.h"
+
+class SharedPaddleDetector : public PaddleDetector {
+	// how long processFrame waits for the detector process to publish a new sample
+	static const int WAIT_MS = 100;
+public:
+	/*
+	* SharedPaddleDetector constructor
+	*
+	* preconditions:	none
+	* postconditions:	sets left and right paddles to default position and opens the ring
+	*					called name. isOpen() is false if the detector process is not running.
+	*/
+	SharedPaddleDetector(const string &name = DEFAULT_RING_NAME);
+
+	/*
+	* SharedPaddleDetector destructor
+	*
+	* preconditions:	none
+	* postconditions:	none
+	*/
+	~SharedPaddleDetector() {}
+
+	bool isOpen() const {return(m_ring.isOpen());}
+
+	/*
+	* processFrame
+	*
+	* waits for the detector process to publish a new sample and takes its paddle
+	* positions and frame.
+	*
+	* preconditions:	none
+	* postconditions:	sets left and right paddles to the newest published sample and
+	*					copies the frame it was detected in into frame. the paddles and
+	*					frame are left as they were if nothing new was published in time.
+	*/
+	virtual void processFrame(Mat &frame);
+
+	/*
+	* getLastSample
+	*
+	* preconditions:	none
+	* postconditions:	returns the last sample taken from the ring, with its timestamp
+	*					and frame id
+	*/
+	const PaddleSample &getLastSample() const {return(m_sample);}
+
+private:
+	/*
+	* detectMotion
+	*
+	* motion is detected by the other process, there is nothing to do here
+	*/
+	void detectMotion(Mat &, Mat &, bool) {}
+
+	/*
+	* takePaddle
+	*
+	* preconditions:	none
+	* postconditions:	sets the paddle indicated by isRight as the detector process left it
+	*/
+	void takePaddle(bool isRight, int pos, bool found, double confidence);
+
+	SharedPaddleRing m_ring;
+	PaddleSample m_sample;
+	uint64_t m_published;
+};
+
+#endif
@@ -0,0 +1,352 @@
+/*
+* SharedPaddleRing class
+*
+* a lock-free ring buffer in named shared memory through which one detector process
+* publishes timestamped paddle positions, and optionally an image such as the frame
+* or a mask, to any number of reader processes.
+*
+*/
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+#include "SharedPaddleRing.h"
+
+// slots are kept on their own cache lines so the writer of one slot does not slow
+// down readers of the slot next to it
+static const size_t CACHE_LINE = 64;
+
+static size_t alignUp(size_t bytes) {
+	return((bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+}
+
+const int SharedPaddleRing::SPIN_US;
+
+/*
+* SharedPaddleRing writer constructor
+*
+* preconditions:	slotCount must be greater than 0. imageType must be a CV_8U type
+*					if imageSize is not empty.
+* postconditions:	creates (or replaces) the ring called name with room for slotCount
+*					samples, each carrying an image of imageSize and imageType. An empty
+*					imageSize publishes samples without images.
+*/
+SharedPaddleRing::SharedPaddleRing(const string &name, int slotCount, Size imageSize, int imageType) {
+	m_name = name;
+	m_writer = true;
+	m_header = nullptr;
+	m_mapping = nullptr;
+
+	size_t imageBytes = static_cast<size_t>(imageSize.width) * imageSize.height * CV_ELEM_SIZE(imageType);
+	size_t slotStride = alignUp(sizeof(Slot) + imageBytes);
+	m_bytes = alignUp(sizeof(Header)) + slotStride * slotCount;
+
+	if(!map(m_bytes, true)) return;
+
+	Header *header = new(m_mapping) Header();
+	header->magic = RING_MAGIC;
+	header->version = RING_VERSION;
+	header->slotCount = static_cast<uint32_t>(slotCount);
+	header->slotStride = static_cast<uint32_t>(slotStride);
+	header->imageRows = imageSize.height;
+	header->imageCols = imageSize.width;
+	header->imageType = imageType;
+	header->imageBytes = static_cast<uint32_t>(imageBytes);
+	header->published.store(0, std::memory_order_relaxed);
+	header->wakeups.store(0, std::memory_order_relaxed);
+	header->waiters.store(0, std::memory_order_relaxed);
+
+	for(int i = 0; i < slotCount; i++) {
+		Slot *s = new(reinterpret_cast<unsigned char *>(m_mapping) + alignUp(sizeof(Header)) + slotStride * i) Slot();
+		s->sequence.store(0, std::memory_order_relaxed);
+	}
+
+	// readers only trust the ring once the header is complete
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header = header;
+}
+
+/*
+* SharedPaddleRing reader constructor
+*
+* preconditions:	none
+* postconditions:	opens the ring called name created by a writer. isOpen() is false if
+*					there is no such ring.
+*/
+SharedPaddleRing::SharedPaddleRing(const string &name) {
+	m_name = name;
+	m_writer = false;
+	m_header = nullptr;
+	m_mapping = nullptr;
+	m_bytes = 0;
+
+	// map the header first to learn the size of the whole ring
+	if(!map(sizeof(Header), false)) return;
+	Header *header = reinterpret_cast<Header *>(m_mapping);
+	bool valid = header->magic == RING_MAGIC && header->version == RING_VERSION;
+	size_t bytes = alignUp(sizeof(Header)) + static_cast<size_t>(header->slotStride) * header->slotCount;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_mapping);
+#else
+	munmap(m_mapping, sizeof(Header));
+#endif
+	m_mapping = nullptr;
+
+	if(valid && map(bytes, false)) {
+		m_bytes = bytes;
+		m_header = reinterpret_cast<Header *>(m_mapping);
+	}
+}
+
+/*
+* SharedPaddleRing destructor
+*
+* preconditions:	none
+* postconditions:	unmaps the ring, and removes its name if this is the writer
+*/
+SharedPaddleRing::~SharedPaddleRing() {
+	if(m_mapping == nullptr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_mapping);
+	// the mapping goes away with the last handle, which is kept open by the view
+#else
+	munmap(m_mapping, m_bytes);
+	if(m_writer) {
+		shm_unlink(("/" + m_name).c_str());
+	}
+#endif
+}
+
+/*
+* map
+*
+* preconditions:	none
+* postconditions:	maps bytes of the shared memory called m_name into m_mapping,
+*					creating it if create is true. returns false if that failed.
+*/
+bool SharedPaddleRing::map(size_t bytes, bool create) {
+#ifdef _WIN32
+	string name = "Local\\" + m_name;
+	HANDLE handle;
+	if(create) {
+		handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+									static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32),
+									static_cast<DWORD>(bytes), name.c_str());
+	} else {
+		handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	}
+	if(handle == NULL) return(false);
+	m_mapping = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+	// the view keeps the mapping alive once the handle is closed
+	CloseHandle(handle);
+	return(m_mapping != NULL);
+#else
+	string name = "/" + m_name;
+	int fd;
+	if(create) {
+		shm_unlink(name.c_str());
+		fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+		if(fd >= 0 && ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	} else {
+		fd = shm_open(name.c_str(), O_RDWR, 0600);
+	}
+	if(fd < 0) return(false);
+
+	void *mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED) return(false);
+	m_mapping = mapping;
+	return(true);
+#endif
+}
+
+SharedPaddleRing::Slot *SharedPaddleRing::slot(uint64_t index) const {
+	size_t offset = alignUp(sizeof(Header)) + static_cast<size_t>(index % m_header->slotCount) * m_header->slotStride;
+	return(reinterpret_cast<Slot *>(reinterpret_cast<unsigned char *>(m_mapping) + offset));
+}
+
+unsigned char *SharedPaddleRing::slotImage(Slot *s) const {
+	return(reinterpret_cast<unsigned char *>(s) + sizeof(Slot));
+}
+
+/*
+* publish
+*
+* preconditions:	this must be the writer. image must match the image size and type
+*					of the ring, or be nullptr.
+* postconditions:	writes sample and image to the next slot, overwriting the oldest
+*/
+void SharedPaddleRing::publish(const PaddleSample &sample, const Mat *image) {
+	if(!isOpen() || !m_writer) return;
+
+	uint64_t index = m_header->published.load(std::memory_order_relaxed);
+	Slot *s = slot(index);
+
+	// odd while writing, readers which see it retry
+	s->sequence.store(index * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	s->sample = sample;
+	if(image != nullptr && m_header->imageBytes > 0 && image->rows == m_header->imageRows &&
+	   image->cols == m_header->imageCols && image->type() == m_header->imageType) {
+		Mat target(m_header->imageRows, m_header->imageCols, m_header->imageType, slotImage(s));
+		image->copyTo(target);
+	}
+
+	// even once the slot is complete, then make it the newest sample
+	s->sequence.store(index * 2 + 2, std::memory_order_release);
+	m_header->published.store(index + 1, std::memory_order_release);
+
+	// wake the readers sleeping in waitForPublish, the system call is only made when
+	// one is asleep
+	m_header->wakeups.fetch_add(1);
+#ifdef __linux__
+	if(m_header->waiters.load() > 0) {
+		syscall(SYS_futex, reinterpret_cast<int *>(&m_header->wakeups), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+#endif
+}
+
+/*
+* readSlot
+*
+* preconditions:	index must be less than the number of samples published
+* postconditions:	copies the sample at index and returns true, or returns false if the
+*					slot was overwritten before or while it was being copied
+*/
+bool SharedPaddleRing::readSlot(uint64_t index, PaddleSample &sample, Mat *image) {
+	Slot *s = slot(index);
+	uint64_t expected = index * 2 + 2;
+
+	if(s->sequence.load(std::memory_order_acquire) != expected) return(false);
+
+	PaddleSample copy = s->sample;
+	if(image != nullptr && m_header->imageBytes > 0) {
+		image->create(m_header->imageRows, m_header->imageCols, m_header->imageType);
+		memcpy(image->data, slotImage(s), m_header->imageBytes);
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(s->sequence.load(std::memory_order_relaxed) != expected) return(false);
+
+	sample = copy;
+	return(true);
+}
+
+/*
+* readLatest
+*
+* preconditions:	none
+* postconditions:	copies the newest complete sample into sample, and its image into
+*					image unless image is nullptr. returns false if nothing was published.
+*/
+bool SharedPaddleRing::readLatest(PaddleSample &sample, Mat *image) {
+	if(!isOpen()) return(false);
+
+	while(true) {
+		uint64_t published = m_header->published.load(std::memory_order_acquire);
+		if(published == 0) return(false);
+		if(readSlot(published - 1, sample, image)) return(true);
+		// the writer lapped this slot while it was being copied, take the new latest
+	}
+}
+
+/*
+* readNext
+*
+* reads every sample in order for consumers which must not miss any, such as
+* recorders. cursor is the index of the next sample to read and starts at 0.
+*
+* preconditions:	none
+* postconditions:	copies the sample at cursor and advances cursor, returning true.
+*					returns false if there is no new sample. if the writer lapped the
+*					reader, cursor jumps to the oldest sample still in the ring.
+*/
+bool SharedPaddleRing::readNext(uint64_t &cursor, PaddleSample &sample, Mat *image) {
+	if(!isOpen()) return(false);
+
+	while(true) {
+		uint64_t published = m_header->published.load(std::memory_order_acquire);
+		if(cursor >= published) return(false);
+
+		// keep one slot of slack, the writer may already be writing the oldest one
+		uint64_t oldest = published > m_header->slotCount - 1 ? published - (m_header->slotCount - 1) : 0;
+		if(cursor < oldest) cursor = oldest;
+
+		if(readSlot(cursor, sample, image)) {
+			cursor++;
+			return(true);
+		}
+	}
+}
+
+/*
+* getPublished
+*
+* preconditions:	none
+* postconditions:	returns the number of samples published so far
+*/
+uint64_t SharedPaddleRing::getPublished() const {
+	return(isOpen() ? m_header->published.load(std::memory_order_acquire) : 0);
+}
+
+/*
+* waitForPublish
+*
+* preconditions:	none
+* postconditions:	returns true as soon as more than published samples have been
+*					published, or false if none was within timeoutMs
+*/
+bool SharedPaddleRing::waitForPublish(uint64_t published, int timeoutMs) {
+	if(!isOpen()) return(false);
+
+	// a sample which is about to be published is taken without a system call
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point spinEnd = start + std::chrono::microseconds(SPIN_US);
+	std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(timeoutMs);
+	while(std::chrono::steady_clock::now() < spinEnd) {
+		if(getPublished() != published) return(true);
+	}
+
+	while(true) {
+		// read the futex before checking, a publish after the check changes it and
+		// the wait below returns at once
+		uint32_t wakeups = m_header->wakeups.load();
+		if(getPublished() != published) return(true);
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now >= deadline) return(false);
+#ifdef __linux__
+		int64_t remainingNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+		struct timespec timeout;
+		timeout.tv_sec = static_cast<time_t>(remainingNs / 1000000000);
+		timeout.tv_nsec = static_cast<long>(remainingNs % 1000000000);
+
+		m_header->waiters.fetch_add(1);
+		syscall(SYS_futex, reinterpret_cast<int *>(&m_header->wakeups), FUTEX_WAIT, wakeups, &timeout, NULL, 0);
+		m_header->waiters.fetch_sub(1);
+#else
+		// no futex shared between processes here, poll instead
+		(void)wakeups;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+	}
+}
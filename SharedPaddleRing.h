@@ -0,0 +1,158 @@
+/*
+* SharedPaddleRing class
+*
+* a lock-free ring buffer in named shared memory through which one detector process
+* publishes timestamped paddle positions, and optionally an image such as the frame
+* or a mask, to any number of reader processes. The writer never waits for readers.
+* Each slot is guarded by a sequence number (a seqlock): it is odd while the slot is
+* being written and a reader retries if it changed while the reader was copying.
+* A reader waiting for the next sample spins briefly and then sleeps on a futex the
+* writer wakes, so it gets the sample within microseconds without polling.
+*
+*/
+#ifndef SHAREDPADDLERING_H
+#define SHAREDPADDLERING_H
+#include <atomic>
+#include <stdint.h>
+#include "PaddleDetector.h"
+
+const string DEFAULT_RING_NAME = "cvpong";
+const int DEFAULT_RING_SLOTS = 8;
+
+/*
+* PaddleSample
+*
+* one detection published through the ring
+*/
+struct PaddleSample {
+	int64_t timestampUs;	// capture time on the steady clock, in microseconds
+	uint64_t frameId;
+	int leftPaddlePos;
+	int rightPaddlePos;
+	double leftConfidence;	// how sure the detector is of each position (0 - 1)
+	double rightConfidence;
+	bool leftFound;			// false if the paddle was not seen, its position is then
+	bool rightFound;		// the last one seen
+};
+
+class SharedPaddleRing {
+	static const uint32_t RING_MAGIC = 0x52505643; // "CVPR"
+	static const uint32_t RING_VERSION = 2;
+	// how long a waiting reader spins before it sleeps until the next publish
+	static const int SPIN_US = 50;
+public:
+	/*
+	* SharedPaddleRing writer constructor
+	*
+	* preconditions:	slotCount must be greater than 0. imageType must be a CV_8U type
+	*					if imageSize is not empty.
+	* postconditions:	creates (or replaces) the ring called name with room for slotCount
+	*					samples, each carrying an image of imageSize and imageType. An empty
+	*					imageSize publishes samples without images.
+	*/
+	SharedPaddleRing(const string &name, int slotCount, Size imageSize = Size(), int imageType = CV_8UC3);
+
+	/*
+	* SharedPaddleRing reader constructor
+	*
+	* preconditions:	none
+	* postconditions:	opens the ring called name created by a writer. isOpen() is false if
+	*					there is no such ring.
+	*/
+	explicit SharedPaddleRing(const string &name);
+
+	/*
+	* SharedPaddleRing destructor
+	*
+	* preconditions:	none
+	* postconditions:	unmaps the ring, and removes its name if this is the writer
+	*/
+	~SharedPaddleRing();
+
+	bool isOpen() const {return(m_header != nullptr);}
+
+	/*
+	* publish
+	*
+	* preconditions:	this must be the writer. image must match the image size and type
+	*					of the ring, or be nullptr.
+	* postconditions:	writes sample and image to the next slot, overwriting the oldest
+	*/
+	void publish(const PaddleSample &sample, const Mat *image = nullptr);
+
+	/*
+	* readLatest
+	*
+	* preconditions:	none
+	* postconditions:	copies the newest complete sample into sample, and its image into
+	*					image unless image is nullptr. returns false if nothing was published.
+	*/
+	bool readLatest(PaddleSample &sample, Mat *image = nullptr);
+
+	/*
+	* readNext
+	*
+	* reads every sample in order for consumers which must not miss any, such as
+	* recorders. cursor is the index of the next sample to read and starts at 0.
+	*
+	* preconditions:	none
+	* postconditions:	copies the sample at cursor and advances cursor, returning true.
+	*					returns false if there is no new sample. if the writer lapped the
+	*					reader, cursor jumps to the oldest sample still in the ring.
+	*/
+	bool readNext(uint64_t &cursor, PaddleSample &sample, Mat *image = nullptr);
+
+	/*
+	* getPublished
+	*
+	* preconditions:	none
+	* postconditions:	returns the number of samples published so far
+	*/
+	uint64_t getPublished() const;
+
+	/*
+	* waitForPublish
+	*
+	* preconditions:	none
+	* postconditions:	returns true as soon as more than published samples have been
+	*					published, or false if none was within timeoutMs
+	*/
+	bool waitForPublish(uint64_t published, int timeoutMs);
+
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t slotStride;
+		int32_t imageRows;
+		int32_t imageCols;
+		int32_t imageType;
+		uint32_t imageBytes;
+		std::atomic<uint64_t> published;
+		// bumped on every publish; the futex the readers sleep on
+		std::atomic<uint32_t> wakeups;
+		std::atomic<uint32_t> waiters;
+	};
+
+	struct Slot {
+		std::atomic<uint64_t> sequence;
+		PaddleSample sample;
+	};
+
+	SharedPaddleRing(const SharedPaddleRing &);
+	SharedPaddleRing &operator=(const SharedPaddleRing &);
+
+	bool map(size_t bytes, bool create);
+	Slot *slot(uint64_t index) const;
+	unsigned char *slotImage(Slot *s) const;
+	bool readSlot(uint64_t index, PaddleSample &sample, Mat *image);
+
+	string m_name;
+	bool m_writer;
+	size_t m_bytes;
+	Header *m_header;
+	void *m_mapping;
+};
+
+#endif
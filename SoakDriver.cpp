@@ -0,0 +1,174 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "GameBoard.h"
+#include "BotPaddleDetector.h"
+#include "AllocCounter.h"
+#ifdef __linux__
+#include <unistd.h>
+#endif
+using namespace std;
+
+// ticks summed into each line of the report
+const int REPORT_TICKS = 10000;
+// games are served faster and faster up to this speed factor, then start over
+const double MAX_SERVE_SPEED = 30;
+// a rally between two good bots can last forever, after this many ticks without
+// a point the game is served again at the next speed
+const int MAX_RALLY_TICKS = 3000;
+// violations printed in full, the rest are only counted
+const int MAX_REPORTED_VIOLATIONS = 10;
+
+/*
+* residentKb
+*
+* preconditions:	none
+* postconditions:	returns the memory the process holds in RAM in kilobytes, or -1
+*					where that can not be read
+*/
+static long residentKb() {
+#ifdef __linux__
+	long pages = -1;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if(statm != nullptr) {
+		long size;
+		if(fscanf(statm, "%ld %ld", &size, &pages) != 2) {
+			pages = -1;
+		}
+		fclose(statm);
+	}
+	return(pages < 0 ? -1 : pages * (sysconf(_SC_PAGESIZE) / 1024));
+#else
+	return(-1);
+#endif
+}
+
+/*
+* onBoard
+*
+* preconditions:	none
+* postconditions:	returns true if the ball and both paddles are inside of a board of size
+*/
+static bool onBoard(const GameState &state, Size size) {
+	return(state.ballX >= 0 && state.ballX + BALL_SIZE <= size.width &&
+		   state.ballY >= 0 && state.ballY + BALL_SIZE <= size.height &&
+		   state.leftPaddleY >= 0 && state.leftPaddleY + PADDLE_Y <= size.height &&
+		   state.rightPaddleY >= 0 && state.rightPaddleY + PADDLE_Y <= size.height);
+}
+
+/*
+* main
+*
+* plays bot against bot with no camera and no window as fast as the machine allows,
+* to soak test the game loop. Every REPORT_TICKS ticks a CSV line reports the games
+* played, the mean and longest tick, the memory held and, in a build counting them,
+* the heap allocations, so growth and drift show up over hours. Each game is served
+* faster than the last, and a rally which goes on too long ends the game. A tick
+* which leaves the ball or a paddle outside of the board is reported as a physics
+* violation, that game is abandoned and the exit code is 1.
+*
+* usage: soak [minutes] [skill] [delay frames] [jitter] [seed]
+*
+*/
+int main(int argc, char *argv[]) {
+	double minutes = argc > 1 ? atof(argv[1]) : 1;
+	BotSettings settings;
+	if(argc > 2) settings.skill = atof(argv[2]);
+	if(argc > 3) settings.delayFrames = atoi(argv[3]);
+	if(argc > 4) settings.jitter = atof(argv[4]);
+	if(argc > 5) settings.seed = strtoull(argv[5], nullptr, 10);
+
+	GameBoard pong;
+	BotPaddleDetector bot(&pong, settings);
+	Mat background = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+	Mat frame;
+
+	double serveSpeed = 0;
+	uint64_t games = 0;
+	uint64_t violations = 0;
+	int rallyTicks = 0;
+	int points = 0;
+	double firstMeanUs = 0;
+	double lastMeanUs = 0;
+
+	int window = 0;
+	int windowTicks = 0;
+	double windowUs = 0;
+	double windowMaxUs = 0;
+	uint64_t windowAllocs = AllocCounter::total().count;
+
+	cout << "window,ticks,games,meanUs,maxUs,rssKb,allocs,violations" << endl;
+
+	int64 end = getTickCount() + static_cast<int64>(minutes * 60 * getTickFrequency());
+	while(getTickCount() < end) {
+		background.copyTo(frame);
+
+		int64 start = getTickCount();
+		bot.processFrame(frame);
+		pong.detect(pong.getTick(), false, bot.getLeftPaddleLoc());
+		pong.detect(pong.getTick(), true, bot.getRightPaddleLoc());
+		uint64_t tick = pong.advance();
+
+		GameState state = pong.getState();
+		if(onBoard(state, frame.size())) {
+			pong.render(frame);
+		} else {
+			// drawing it would write outside of the board, abandon the game instead
+			if(violations < MAX_REPORTED_VIOLATIONS) {
+				cout << "# tick " << tick << ": ball (" << state.ballX << ", " << state.ballY;
+				cout << ") moving (" << state.ballXmov << ", " << state.ballYmov << "), paddles ";
+				cout << state.leftPaddleY << " and " << state.rightPaddleY << ", served at ";
+				cout << serveSpeed << ", is off the board" << endl;
+			}
+			violations++;
+			pong.reset(serveSpeed);
+		}
+
+		// a point ends the rally
+		rallyTicks++;
+		if(state.score[0] + state.score[1] != points) {
+			points = state.score[0] + state.score[1];
+			rallyTicks = 0;
+		}
+
+		if(!pong.gameOn() || rallyTicks >= MAX_RALLY_TICKS) {
+			games++;
+			rallyTicks = 0;
+			serveSpeed += SPEED_INCREMENT;
+			if(serveSpeed > MAX_SERVE_SPEED) {
+				serveSpeed = 0;
+			}
+			pong.reset(serveSpeed);
+		}
+		points = pong.getState().score[0] + pong.getState().score[1];
+		double tickUs = (getTickCount() - start) * 1000000.0 / getTickFrequency();
+
+		windowTicks++;
+		windowUs += tickUs;
+		windowMaxUs = std::max(windowMaxUs, tickUs);
+		if(windowTicks == REPORT_TICKS) {
+			uint64_t allocs = AllocCounter::total().count;
+			lastMeanUs = windowUs / windowTicks;
+			if(window == 0) {
+				firstMeanUs = lastMeanUs;
+			}
+			cout << window << "," << windowTicks << "," << games << "," << lastMeanUs << ",";
+			cout << windowMaxUs << "," << residentKb() << ",";
+			cout << (AllocCounter::enabled() ? static_cast<int64_t>(allocs - windowAllocs) : -1);
+			cout << "," << violations << endl;
+
+			window++;
+			windowTicks = 0;
+			windowUs = 0;
+			windowMaxUs = 0;
+			windowAllocs = allocs;
+		}
+	}
+
+	if(window > 1) {
+		cout << "# mean tick drifted from " << firstMeanUs << " us to " << lastMeanUs << " us" << endl;
+	}
+	cout << "# " << games << " games, " << violations << " physics violations" << endl;
+	return(violations == 0 ? 0 : 1);
+}
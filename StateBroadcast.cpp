@@ -0,0 +1,326 @@
+/*
+* StateBroadcast
+*
+* classes which send the state of a game to spectators over UDP and receive it.
+* See StateBroadcast.h for the packet layout.
+*
+*/
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+#include "StateBroadcast.h"
+
+/*
+* toFields
+*
+* preconditions:	none
+* postconditions:	flattens state into fields in packet order
+*/
+void StateCodec::toFields(const GameState &state, int fields[FIELD_COUNT]) {
+	fields[0] = state.ballX;
+	fields[1] = state.ballY;
+	fields[2] = state.ballXmov;
+	fields[3] = state.ballYmov;
+	fields[4] = state.leftPaddleY;
+	fields[5] = state.rightPaddleY;
+	fields[6] = state.score[0];
+	fields[7] = state.score[1];
+	fields[8] = state.gameOn ? 1 : 0;
+}
+
+/*
+* fromFields
+*
+* preconditions:	none
+* postconditions:	sets state from fields in packet order
+*/
+void StateCodec::fromFields(const int fields[FIELD_COUNT], GameState &state) {
+	state.ballX = fields[0];
+	state.ballY = fields[1];
+	state.ballXmov = fields[2];
+	state.ballYmov = fields[3];
+	state.leftPaddleY = fields[4];
+	state.rightPaddleY = fields[5];
+	state.score[0] = fields[6];
+	state.score[1] = fields[7];
+	state.gameOn = fields[8] != 0;
+}
+
+/*
+* encode
+*
+* preconditions:	packet must hold at least MAX_PACKET_SIZE bytes. base must be the
+*					state of the last packet sent, or nullptr for a keyframe.
+* postconditions:	writes the packet of state into packet and returns its length
+*/
+int StateCodec::encode(const GameState &state, const GameState *base, uint16_t seq,
+					   unsigned char *packet) {
+	int fields[FIELD_COUNT];
+	int baseFields[FIELD_COUNT] = {0};
+	toFields(state, fields);
+	if(base != nullptr) {
+		toFields(*base, baseFields);
+	}
+
+	int length = HEADER_SIZE;
+	uint16_t mask = 0;
+	for(int i = 0; i < FIELD_COUNT; i++) {
+		int delta = fields[i] - baseFields[i];
+		if(delta == 0) continue;
+		mask |= 1 << i;
+
+		// zigzag so small negative differences stay small, then 7 bits per byte
+		uint32_t value = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+		while(value >= 0x80) {
+			packet[length++] = static_cast<unsigned char>(value | 0x80);
+			value >>= 7;
+		}
+		packet[length++] = static_cast<unsigned char>(value);
+	}
+
+	packet[0] = PACKET_MAGIC;
+	packet[1] = base == nullptr ? KEYFRAME_FLAG : 0;
+	packet[2] = static_cast<unsigned char>(seq & 0xFF);
+	packet[3] = static_cast<unsigned char>(seq >> 8);
+	packet[4] = static_cast<unsigned char>(mask & 0xFF);
+	packet[5] = static_cast<unsigned char>(mask >> 8);
+	return(length);
+}
+
+/*
+* decode
+*
+* preconditions:	base must be the state of the packet before this one when the
+*					packet is not a keyframe
+* postconditions:	returns false if packet is not a valid packet. otherwise sets state
+*					to the state in the packet, seq to its sequence number and keyframe
+*					to whether it is a keyframe. state is not changed if the packet is
+*					not a keyframe and base is nullptr.
+*/
+bool StateCodec::decode(const unsigned char *packet, int length, const GameState *base,
+						GameState &state, uint16_t &seq, bool &keyframe) {
+	if(length < HEADER_SIZE || packet[0] != PACKET_MAGIC) {
+		return(false);
+	}
+
+	keyframe = (packet[1] & KEYFRAME_FLAG) != 0;
+	seq = static_cast<uint16_t>(packet[2] | (packet[3] << 8));
+	uint16_t mask = static_cast<uint16_t>(packet[4] | (packet[5] << 8));
+
+	int fields[FIELD_COUNT] = {0};
+	if(!keyframe) {
+		if(base == nullptr) return(true);
+		toFields(*base, fields);
+	}
+
+	int pos = HEADER_SIZE;
+	for(int i = 0; i < FIELD_COUNT; i++) {
+		if(!(mask & (1 << i))) continue;
+
+		uint32_t value = 0;
+		int shift = 0;
+		while(true) {
+			if(pos >= length || shift > 28) return(false);
+			unsigned char byte = packet[pos++];
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if(!(byte & 0x80)) break;
+			shift += 7;
+		}
+		int delta = static_cast<int>(value >> 1) ^ -static_cast<int>(value & 1);
+		fields[i] += delta;
+	}
+
+	fromFields(fields, state);
+	return(true);
+}
+
+/*
+* UdpSocket default constructor
+*
+* preconditions:	none
+* postconditions:	opens a UDP socket, isOpen() is false if that failed
+*/
+UdpSocket::UdpSocket() {
+#ifdef _WIN32
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	m_socket = s == INVALID_SOCKET ? -1 : static_cast<intptr_t>(s);
+#else
+	m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#endif
+	if(isOpen()) {
+		// allow publishing to a broadcast address for lobby screens on the LAN
+		int enable = 1;
+		setsockopt(m_socket, SOL_SOCKET, SO_BROADCAST,
+				   reinterpret_cast<const char *>(&enable), sizeof(enable));
+	}
+}
+
+/*
+* UdpSocket destructor
+*
+* preconditions:	none
+* postconditions:	closes the socket
+*/
+UdpSocket::~UdpSocket() {
+	if(!isOpen()) return;
+#ifdef _WIN32
+	closesocket(static_cast<SOCKET>(m_socket));
+	WSACleanup();
+#else
+	close(static_cast<int>(m_socket));
+#endif
+}
+
+bool UdpSocket::isOpen() const {
+	return(m_socket >= 0);
+}
+
+/*
+* bindPort
+*
+* preconditions:	none
+* postconditions:	receives packets sent to port on any address, returns false if
+*					the port could not be bound
+*/
+bool UdpSocket::bindPort(int port) {
+	if(!isOpen()) return(false);
+
+	// several viewers on one machine may listen to the same broadcast
+	int enable = 1;
+	setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR,
+			   reinterpret_cast<const char *>(&enable), sizeof(enable));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(static_cast<unsigned short>(port));
+	return(bind(m_socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+}
+
+/*
+* sendTo
+*
+* preconditions:	host must be a dotted IPv4 address, broadcast addresses included
+* postconditions:	sends length bytes of data to host and port
+*/
+bool UdpSocket::sendTo(const string &host, int port, const unsigned char *data, int length) {
+	if(!isOpen()) return(false);
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = inet_addr(host.c_str());
+	addr.sin_port = htons(static_cast<unsigned short>(port));
+	return(sendto(m_socket, reinterpret_cast<const char *>(data), length, 0,
+				  reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == length);
+}
+
+/*
+* receive
+*
+* preconditions:	the socket must be bound
+* postconditions:	waits at most timeoutMs for a packet and returns its length, or
+*					returns -1 if no packet arrived
+*/
+int UdpSocket::receive(unsigned char *data, int capacity, int timeoutMs) {
+	if(!isOpen()) return(-1);
+
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(m_socket, &readable);
+	timeval timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+	if(select(static_cast<int>(m_socket) + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+		return(-1);
+	}
+	return(static_cast<int>(recv(m_socket, reinterpret_cast<char *>(data), capacity, 0)));
+}
+
+/*
+* StatePublisher constructor
+*
+* preconditions:	host must be a dotted IPv4 address
+* postconditions:	publishes to host and port
+*/
+StatePublisher::StatePublisher(const string &host, int port) {
+	m_host = host;
+	m_port = port;
+	m_seq = 0;
+	m_hasLast = false;
+}
+
+/*
+* publish
+*
+* preconditions:	none
+* postconditions:	sends the changes in state since the last publish, or all of state
+*					when a keyframe is due
+*/
+void StatePublisher::publish(const GameState &state) {
+	unsigned char packet[StateCodec::MAX_PACKET_SIZE];
+	bool keyframe = !m_hasLast || m_seq % KEYFRAME_INTERVAL == 0;
+
+	int length = StateCodec::encode(state, keyframe ? nullptr : &m_last, m_seq, packet);
+	m_socket.sendTo(m_host, m_port, packet, length);
+
+	m_last = state;
+	m_hasLast = true;
+	m_seq++;
+}
+
+/*
+* StateReceiver constructor
+*
+* preconditions:	none
+* postconditions:	listens for packets on port
+*/
+StateReceiver::StateReceiver(int port) {
+	m_open = m_socket.bindPort(port);
+	m_hasState = false;
+	m_seq = 0;
+}
+
+/*
+* receive
+*
+* preconditions:	none
+* postconditions:	waits at most timeoutMs for a packet which can be applied and
+*					returns true with the state of the game in state. Packets which
+*					follow a lost packet are skipped until the next keyframe.
+*/
+bool StateReceiver::receive(GameState &state, int timeoutMs) {
+	unsigned char packet[StateCodec::MAX_PACKET_SIZE];
+	int length = m_socket.receive(packet, sizeof(packet), timeoutMs);
+	if(length <= 0) return(false);
+
+	GameState decoded;
+	uint16_t seq;
+	bool keyframe;
+	if(!StateCodec::decode(packet, length, m_hasState ? &m_state : nullptr, decoded, seq, keyframe)) {
+		return(false);
+	}
+
+	// a difference only applies on top of the packet right before it
+	if(!keyframe && (!m_hasState || seq != static_cast<uint16_t>(m_seq + 1))) {
+		m_hasState = false;
+		return(false);
+	}
+
+	m_state = decoded;
+	m_seq = seq;
+	m_hasState = true;
+	state = m_state;
+	return(true);
+}
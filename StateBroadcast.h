@@ -0,0 +1,197 @@
+/*
+* StateBroadcast
+*
+* classes which send the state of a game to spectators over UDP and receive it. Each
+* tick is one small packet holding only the fields which changed since the last
+* packet, as the difference from their last value. A full keyframe is sent every
+* KEYFRAME_INTERVAL packets so a spectator who joins late or loses a packet catches
+* up within a few seconds.
+*
+* packet layout:
+*		byte 0		PACKET_MAGIC
+*		byte 1		flags (bit 0 set for a keyframe)
+*		bytes 2-3	sequence number, little endian
+*		bytes 4-5	mask of the fields included, little endian
+*		...			one zigzag varint per included field, the difference from the
+*					value in the last packet (or from 0 in a keyframe)
+*
+*/
+#ifndef STATEBROADCAST_H
+#define STATEBROADCAST_H
+#include <stdint.h>
+#include <string>
+#include "GameBoard.h"
+
+const int DEFAULT_BROADCAST_PORT = 47474;
+const string DEFAULT_BROADCAST_HOST = "127.0.0.1";
+
+/*
+* StateCodec
+*
+* encodes and decodes the packets
+*/
+class StateCodec {
+public:
+	static const unsigned char PACKET_MAGIC = 0xC7;
+	static const unsigned char KEYFRAME_FLAG = 0x01;
+	static const int HEADER_SIZE = 6;
+	static const int FIELD_COUNT = 9;
+	// a varint of a 32-bit difference takes at most 5 bytes
+	static const int MAX_PACKET_SIZE = HEADER_SIZE + FIELD_COUNT * 5;
+
+	/*
+	* encode
+	*
+	* preconditions:	packet must hold at least MAX_PACKET_SIZE bytes. base must be the
+	*					state of the last packet sent, or nullptr for a keyframe.
+	* postconditions:	writes the packet of state into packet and returns its length
+	*/
+	static int encode(const GameState &state, const GameState *base, uint16_t seq,
+					  unsigned char *packet);
+
+	/*
+	* decode
+	*
+	* preconditions:	base must be the state of the packet before this one when the
+	*					packet is not a keyframe
+	* postconditions:	returns false if packet is not a valid packet. otherwise sets state
+	*					to the state in the packet, seq to its sequence number and keyframe
+	*					to whether it is a keyframe. state is not changed if the packet is
+	*					not a keyframe and base is nullptr.
+	*/
+	static bool decode(const unsigned char *packet, int length, const GameState *base,
+					   GameState &state, uint16_t &seq, bool &keyframe);
+
+private:
+	static void toFields(const GameState &state, int fields[FIELD_COUNT]);
+	static void fromFields(const int fields[FIELD_COUNT], GameState &state);
+};
+
+/*
+* UdpSocket
+*
+* a minimal UDP socket over winsock or BSD sockets
+*/
+class UdpSocket {
+public:
+	/*
+	* UdpSocket default constructor
+	*
+	* preconditions:	none
+	* postconditions:	opens a UDP socket, isOpen() is false if that failed
+	*/
+	UdpSocket();
+
+	/*
+	* UdpSocket destructor
+	*
+	* preconditions:	none
+	* postconditions:	closes the socket
+	*/
+	~UdpSocket();
+
+	bool isOpen() const;
+
+	/*
+	* bindPort
+	*
+	* preconditions:	none
+	* postconditions:	receives packets sent to port on any address, returns false if
+	*					the port could not be bound
+	*/
+	bool bindPort(int port);
+
+	/*
+	* sendTo
+	*
+	* preconditions:	host must be a dotted IPv4 address, broadcast addresses included
+	* postconditions:	sends length bytes of data to host and port
+	*/
+	bool sendTo(const string &host, int port, const unsigned char *data, int length);
+
+	/*
+	* receive
+	*
+	* preconditions:	the socket must be bound
+	* postconditions:	waits at most timeoutMs for a packet and returns its length, or
+	*					returns -1 if no packet arrived
+	*/
+	int receive(unsigned char *data, int capacity, int timeoutMs);
+
+private:
+	UdpSocket(const UdpSocket &);
+	UdpSocket &operator=(const UdpSocket &);
+
+	intptr_t m_socket;
+};
+
+/*
+* StatePublisher
+*
+* sends one packet per tick to a spectator address
+*/
+class StatePublisher {
+	static const int KEYFRAME_INTERVAL = 30;
+public:
+	/*
+	* StatePublisher constructor
+	*
+	* preconditions:	host must be a dotted IPv4 address
+	* postconditions:	publishes to host and port
+	*/
+	StatePublisher(const string &host = DEFAULT_BROADCAST_HOST, int port = DEFAULT_BROADCAST_PORT);
+
+	/*
+	* publish
+	*
+	* preconditions:	none
+	* postconditions:	sends the changes in state since the last publish, or all of state
+	*					when a keyframe is due
+	*/
+	void publish(const GameState &state);
+
+private:
+	UdpSocket m_socket;
+	string m_host;
+	int m_port;
+	uint16_t m_seq;
+	bool m_hasLast;
+	GameState m_last;
+};
+
+/*
+* StateReceiver
+*
+* receives the packets of a StatePublisher and rebuilds the state of the game
+*/
+class StateReceiver {
+public:
+	/*
+	* StateReceiver constructor
+	*
+	* preconditions:	none
+	* postconditions:	listens for packets on port
+	*/
+	StateReceiver(int port = DEFAULT_BROADCAST_PORT);
+
+	bool isOpen() const {return(m_open);}
+
+	/*
+	* receive
+	*
+	* preconditions:	none
+	* postconditions:	waits at most timeoutMs for a packet which can be applied and
+	*					returns true with the state of the game in state. Packets which
+	*					follow a lost packet are skipped until the next keyframe.
+	*/
+	bool receive(GameState &state, int timeoutMs);
+
+private:
+	UdpSocket m_socket;
+	bool m_open;
+	bool m_hasState;
+	uint16_t m_seq;
+	GameState m_state;
+};
+
+#endif
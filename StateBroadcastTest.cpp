@@ -0,0 +1,131 @@
+#include <iostream>
+#include <string>
+#include "StateBroadcast.h"
+using namespace std;
+
+// the test talks to itself over loopback, away from the port a real game uses
+const int TEST_PORT = DEFAULT_BROADCAST_PORT + 1;
+const int TEST_TICKS = 100;
+
+/*
+* sameState
+*
+* preconditions:	none
+* postconditions:	returns true if every field of a and b is equal
+*/
+bool sameState(const GameState &a, const GameState &b) {
+	return(a.ballX == b.ballX && a.ballY == b.ballY &&
+		   a.ballXmov == b.ballXmov && a.ballYmov == b.ballYmov &&
+		   a.leftPaddleY == b.leftPaddleY && a.rightPaddleY == b.rightPaddleY &&
+		   a.score[0] == b.score[0] && a.score[1] == b.score[1] &&
+		   a.gameOn == b.gameOn);
+}
+
+/*
+* stateOfTick
+*
+* preconditions:	none
+* postconditions:	returns a made up state of the game at tick in which the ball
+*					bounces, the paddles move both ways and the score changes
+*/
+GameState stateOfTick(int tick) {
+	GameState state;
+	state.ballXmov = (tick / 20) % 2 == 0 ? 7 : -7;
+	state.ballYmov = (tick / 13) % 2 == 0 ? 5 : -5;
+	state.ballX = 100 + (tick % 20) * state.ballXmov;
+	state.ballY = 300 + (tick % 13) * state.ballYmov;
+	state.leftPaddleY = 200 + (tick * 37) % 400 - 150;
+	state.rightPaddleY = 600 - (tick * 11) % 500;
+	state.score[0] = tick / 40;
+	state.score[1] = tick / 55;
+	state.gameOn = tick < TEST_TICKS - 1;
+	return(state);
+}
+
+/*
+* testCodec
+*
+* preconditions:	none
+* postconditions:	returns true if every packet of a game decodes to the state it was
+*					encoded from, chaining the differences the way a spectator does
+*/
+bool testCodec() {
+	unsigned char packet[StateCodec::MAX_PACKET_SIZE];
+	GameState last;
+	GameState decoded;
+	for(int tick = 0; tick < TEST_TICKS; tick++) {
+		GameState state = stateOfTick(tick);
+		bool isKeyframe = tick % 30 == 0;
+		int length = StateCodec::encode(state, isKeyframe ? nullptr : &last,
+										static_cast<uint16_t>(tick), packet);
+
+		uint16_t seq;
+		bool keyframe;
+		if(length <= 0 || length > StateCodec::MAX_PACKET_SIZE ||
+		   !StateCodec::decode(packet, length, isKeyframe ? nullptr : &decoded, decoded, seq, keyframe) ||
+		   seq != tick || keyframe != isKeyframe || !sameState(decoded, state)) {
+			cout << "codec: tick " << tick << " did not decode to the state encoded" << endl;
+			return(false);
+		}
+		last = state;
+	}
+
+	// a packet which is not ours is refused
+	packet[0] = 0;
+	uint16_t seq;
+	bool keyframe;
+	if(StateCodec::decode(packet, StateCodec::HEADER_SIZE, nullptr, decoded, seq, keyframe)) {
+		cout << "codec: a packet without the magic byte was decoded" << endl;
+		return(false);
+	}
+	return(true);
+}
+
+/*
+* testLoopback
+*
+* preconditions:	nothing else may be bound to TEST_PORT
+* postconditions:	returns true if a receiver rebuilds every state a publisher sends
+*					it over loopback
+*/
+bool testLoopback() {
+	StateReceiver receiver(TEST_PORT);
+	if(!receiver.isOpen()) {
+		cout << "loopback: could not listen on port " << TEST_PORT << endl;
+		return(false);
+	}
+	StatePublisher publisher(DEFAULT_BROADCAST_HOST, TEST_PORT);
+
+	// one packet in flight at a time, so loopback has no reason to drop any
+	for(int tick = 0; tick < TEST_TICKS; tick++) {
+		GameState sent = stateOfTick(tick);
+		publisher.publish(sent);
+
+		GameState received;
+		if(!receiver.receive(received, 1000)) {
+			cout << "loopback: tick " << tick << " was not received" << endl;
+			return(false);
+		}
+		if(!sameState(received, sent)) {
+			cout << "loopback: tick " << tick << " was received wrong" << endl;
+			return(false);
+		}
+	}
+	return(true);
+}
+
+/*
+* main
+*
+* checks that game states survive encoding and decoding, and the trip from a
+* StatePublisher to a StateReceiver over loopback
+*
+* usage: statebroadcasttest
+*
+*/
+int main() {
+	bool passed = testCodec();
+	passed = testLoopback() && passed;
+	cout << (passed ? "passed" : "FAILED") << endl;
+	return(passed ? 0 : 1);
+}
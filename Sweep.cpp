@@ -0,0 +1,373 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "MotionPaddleDetector.h"
+#include "ColorPaddleDetector.h"
+#include "RawFrameFile.h"
+using namespace std;
+
+/*
+* Label
+*
+* the ground truth paddle positions of one frame of a recording. A position of
+* -1 means the paddle was not labeled in that frame.
+*/
+struct Label {
+	int leftPos;
+	int rightPos;
+};
+
+/*
+* SweepResult
+*
+* the accuracy and cost of one configuration of the grid
+*/
+struct SweepResult {
+	DetectorSettings settings;
+	double meanError;
+	double cpuMsPerFrame;
+	int framesScored;
+	bool pareto;
+};
+
+/*
+* readLabels
+*
+* reads a labels file. Each line of the file is "frame,leftY,rightY" where frame
+* is the index of the frame in the recording. Lines starting with '#' are skipped.
+*
+* preconditions:	none
+* postconditions:	returns the labels indexed by frame, unlabeled frames are -1
+*/
+vector<Label> readLabels(const string &path) {
+	vector<Label> labels;
+	ifstream in(path.c_str());
+	string line;
+
+	while(getline(in, line)) {
+		if(line.empty() || line[0] == '#') {
+			continue;
+		}
+		int frame, left, right;
+		char comma;
+		istringstream fields(line);
+		if(!(fields >> frame >> comma >> left >> comma >> right) || frame < 0) {
+			continue;
+		}
+		if(frame >= static_cast<int>(labels.size())) {
+			Label none = {-1, -1};
+			labels.resize(frame + 1, none);
+		}
+		labels[frame].leftPos = left;
+		labels[frame].rightPos = right;
+	}
+	return(labels);
+}
+
+/*
+* buildGrid
+*
+* preconditions:	tracking must be MPD_FLAG or CPD_FLAG
+* postconditions:	returns every combination of the parameters that the detector
+*					selected by tracking uses
+*/
+vector<DetectorSettings> buildGrid(const string &tracking) {
+	const int sensitivities[] = {10, 20, 30, 40};
+	const int blurSizes[] = {5, 10, 15};
+	const int areaThresholds[] = {2500, 5000, 10000, 20000};
+	const int gaussSizes[] = {3, 5, 7};
+	const double gaussSigmas[] = {1, 2, 3};
+	const double scales[] = {1.0, 0.75, 0.5};
+
+	vector<DetectorSettings> grid;
+	DetectorSettings settings;
+
+	for(size_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++) {
+		settings.scale = scales[s];
+		if(tracking == CPD_FLAG) {
+			for(size_t a = 0; a < sizeof(areaThresholds) / sizeof(areaThresholds[0]); a++) {
+				for(size_t g = 0; g < sizeof(gaussSizes) / sizeof(gaussSizes[0]); g++) {
+					for(size_t m = 0; m < sizeof(gaussSigmas) / sizeof(gaussSigmas[0]); m++) {
+						settings.areaThres = areaThresholds[a];
+						settings.gaussSize = gaussSizes[g];
+						settings.gaussSigma = gaussSigmas[m];
+						grid.push_back(settings);
+					}
+				}
+			}
+		} else {
+			for(size_t t = 0; t < sizeof(sensitivities) / sizeof(sensitivities[0]); t++) {
+				for(size_t b = 0; b < sizeof(blurSizes) / sizeof(blurSizes[0]); b++) {
+					settings.thresholdSensitivity = sensitivities[t];
+					settings.blurSize = blurSizes[b];
+					grid.push_back(settings);
+				}
+			}
+		}
+	}
+	return(grid);
+}
+
+/*
+* threadCpuUs
+*
+* preconditions:	none
+* postconditions:	returns the CPU time the calling thread has used, in microseconds.
+*					Other threads running at the same time do not add to it.
+*/
+int64_t threadCpuUs() {
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+	uint64_t kernelTicks = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+	uint64_t userTicks = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+	// FILETIME counts 100 ns ticks
+	return(static_cast<int64_t>((kernelTicks + userTicks) / 10));
+#else
+	timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return(static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000);
+#endif
+}
+
+/*
+* scoreFrame
+*
+* preconditions:	none
+* postconditions:	adds the error of the detected positions against the label of
+*					frameIndex to error and the number of paddles scored to scored
+*/
+void scoreFrame(const vector<Label> &labels, int frameIndex, PaddleDetector *detector,
+				double &error, int &scored) {
+	if(frameIndex >= static_cast<int>(labels.size())) {
+		return;
+	}
+	const Label &label = labels[frameIndex];
+	if(label.leftPos >= 0) {
+		error += abs(detector->getLeftPaddleLoc() - label.leftPos);
+		scored++;
+	}
+	if(label.rightPos >= 0) {
+		error += abs(detector->getRightPaddleLoc() - label.rightPos);
+		scored++;
+	}
+}
+
+/*
+* loadRecording
+*
+* decodes the whole recording up front, so the sweep times the detectors and not
+* the decoder. Reading stops at the first frame which can not be read, whatever
+* frame count the container claims. A raw frame file is not decoded at all, its
+* frames are views into the mapping of raw, the Y plane of YUV frames when grayOnly
+* is set.
+*
+* preconditions:	raw must be the open reader of recording if it is a raw frame file,
+*					otherwise nullptr
+* postconditions:	returns the frames of recording in order, none if it could not be
+*					opened
+*/
+vector<Mat> loadRecording(const string &recording, const RawFrameReader *raw, bool grayOnly) {
+	vector<Mat> frames;
+	if(raw != nullptr) {
+		for(uint64_t i = 0; i < raw->getFrameCount(); i++) {
+			Mat converted;
+			frames.push_back(raw->detectable(i, grayOnly, converted));
+		}
+		return(frames);
+	}
+
+	VideoCapture cap(recording);
+	Mat frame;
+	while(cap.isOpened() && cap.read(frame) && !frame.empty()) {
+		frames.push_back(frame.clone());
+	}
+	return(frames);
+}
+
+/*
+* runConfiguration
+*
+* replays the recording through a detector using settings
+*
+* preconditions:	frames must be the consecutive frames of the recording, grayscale
+*					only when tracking is MPD_FLAG. the color profile must exist when
+*					tracking is CPD_FLAG.
+* postconditions:	returns the mean position error against labels and the mean CPU
+*					time the calling thread spent detecting each frame
+*/
+SweepResult runConfiguration(const vector<Mat> &frames, const string &tracking,
+							 const string &profile, const vector<Label> &labels,
+							 const DetectorSettings &settings) {
+	SweepResult result;
+	result.settings = settings;
+	result.meanError = 0;
+	result.cpuMsPerFrame = 0;
+	result.framesScored = 0;
+	result.pareto = false;
+
+	// the detectors only see the frames they are given, there is no capture
+	VideoCapture noCapture;
+	PaddleDetector *detector;
+	if(tracking == CPD_FLAG) {
+		detector = new ColorPaddleDetector(&noCapture, profile);
+	} else {
+		// each frame is compared with the frame before it
+		detector = new MotionPaddleDetector();
+	}
+	detector->setSettings(settings);
+
+	Mat frame;
+	double error = 0;
+	int scored = 0;
+	int64_t cpuUs = 0;
+
+	bool readsOnly = detector->readsOnly();
+	for(size_t i = 0; i < frames.size(); i++) {
+		// the other detectors mirror and mark the frame they are given, copy it untimed
+		if(!readsOnly) {
+			frames[i].copyTo(frame);
+		}
+		int64_t start = threadCpuUs();
+		if(readsOnly) {
+			detector->detectFrame(frames[i]);
+		} else {
+			detector->processFrame(frame);
+		}
+		cpuUs += threadCpuUs() - start;
+		scoreFrame(labels, static_cast<int>(i), detector, error, scored);
+	}
+
+	delete detector;
+
+	if(!frames.empty()) {
+		result.cpuMsPerFrame = cpuUs / 1000.0 / frames.size();
+	}
+	if(scored > 0) {
+		result.meanError = error / scored;
+	}
+	result.framesScored = scored;
+	return(result);
+}
+
+/*
+* markParetoFront
+*
+* preconditions:	none
+* postconditions:	sorts results by cost and marks the results which no other result
+*					beats on both error and cost
+*/
+void markParetoFront(vector<SweepResult> &results) {
+	sort(results.begin(), results.end(), [](const SweepResult &a, const SweepResult &b) {
+		return(a.cpuMsPerFrame < b.cpuMsPerFrame ||
+			   (a.cpuMsPerFrame == b.cpuMsPerFrame && a.meanError < b.meanError));
+	});
+
+	double bestError = HUGE_VAL;
+	for(size_t i = 0; i < results.size(); i++) {
+		if(results[i].framesScored > 0 && results[i].meanError < bestError) {
+			results[i].pareto = true;
+			bestError = results[i].meanError;
+		}
+	}
+}
+
+/*
+* main
+*
+* replays a labeled recording through the motion or color detector for every
+* configuration in a grid of detector settings and prints the position error and
+* CPU time per frame of each configuration as CSV. The recording is decoded once up
+* front, or mapped if it ends in RAW_EXTENSION. The configurations run in parallel,
+* one per core. Each detector runs on its worker thread alone and is timed by that
+* thread's CPU time, which the other workers do not change.
+*
+* usage: sweep <recording> <labels.csv> <move|color> [profile]
+*
+*/
+int main(int argc, char *argv[]) {
+	if(argc < 4) {
+		cout << "usage: sweep <recording> <labels.csv> <move|color> [profile]" << endl;
+		return(-1);
+	}
+
+	string recording = argv[1];
+	vector<Label> labels = readLabels(argv[2]);
+	string tracking = argv[3] == CPD_FLAG ? CPD_FLAG : MPD_FLAG;
+	string profile = argc > 4 ? argv[4] : "default";
+
+	if(labels.empty()) {
+		cout << "No labels were read from " << argv[2] << endl;
+		return(-1);
+	}
+
+	// the sweep can not stop for calibration, the profile has to be saved already
+	if(tracking == CPD_FLAG && !ifstream((profile + PROFILE_EXTENSION).c_str()).good()) {
+		cout << "No color profile \"" << profile << "\", calibrate it by playing first." << endl;
+		return(-1);
+	}
+
+	RawFrameReader *raw = nullptr;
+	if(isRawFrameFile(recording)) {
+		raw = new RawFrameReader(recording);
+		if(!raw->isOpen()) {
+			delete raw;
+			raw = nullptr;
+		}
+	}
+
+	// the motion detector only reads the grayscale image
+	vector<Mat> frames = loadRecording(recording, raw, tracking == MPD_FLAG);
+	if(frames.empty()) {
+		delete raw;
+		cout << "Could not read any frames from " << recording << endl;
+		return(-1);
+	}
+
+	// the detectors' own parallel loops would run part of a configuration on threads
+	// other than its worker, hiding that part from the worker's CPU time
+	setNumThreads(1);
+
+	vector<DetectorSettings> grid = buildGrid(tracking);
+	vector<SweepResult> results(grid.size());
+	atomic<size_t> next(0);
+	vector<thread> workers(max(1u, thread::hardware_concurrency()));
+	for(size_t w = 0; w < workers.size(); w++) {
+		workers[w] = thread([&]() {
+			for(size_t i = next++; i < grid.size(); i = next++) {
+				results[i] = runConfiguration(frames, tracking, profile, labels, grid[i]);
+			}
+		});
+	}
+	for(size_t w = 0; w < workers.size(); w++) {
+		workers[w].join();
+	}
+
+	markParetoFront(results);
+
+	cout << "thresholdSensitivity,blurSize,areaThres,gaussSize,gaussSigma,scale,"
+		 << "meanError,cpuMsPerFrame,framesScored,pareto" << endl;
+	for(size_t i = 0; i < results.size(); i++) {
+		const DetectorSettings &s = results[i].settings;
+		cout << s.thresholdSensitivity << "," << s.blurSize << "," << s.areaThres << ","
+			 << s.gaussSize << "," << s.gaussSigma << "," << s.scale << ","
+			 << results[i].meanError << "," << results[i].cpuMsPerFrame << ","
+			 << results[i].framesScored << "," << (results[i].pareto ? 1 : 0) << endl;
+	}
+
+	// the frames may be views into the mapping, they are released before it
+	frames.clear();
+	delete raw;
+	return(0);
+}
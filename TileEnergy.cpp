@@ -0,0 +1,112 @@
+/*
+* TileEnergy class
+*
+* measures the motion energy of a pair of sequential grayscale images tile by tile:
+* the sum of absolute differences (SAD) of each tile, summed with SSE2 psadbw where
+* it is available while the difference image itself is written. Tiles whose energy
+* is above a threshold are active, and only the active tiles need the rest of the
+* motion detection.
+*
+*/
+#include "TileEnergy.h"
+#ifdef CVPONG_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+* compute
+*
+* preconditions:	gray and gray2 must be single channel 8-bit images of the same size
+* postconditions:	sets diff to the absolute difference of gray and gray2 and replaces
+*					the energy of every tile with the SAD of gray and gray2 in that
+*					tile. tiles on the right and bottom edges may be smaller.
+*/
+void TileEnergy::compute(const Mat &gray, const Mat &gray2, Mat &diff) {
+	int tilesX = (gray.cols + m_tileSize - 1) / m_tileSize;
+	int tilesY = (gray.rows + m_tileSize - 1) / m_tileSize;
+	m_size = gray.size();
+	m_energy.create(tilesY, tilesX, CV_32S);
+	m_energy.setTo(Scalar(0));
+	diff.create(gray.size(), CV_8UC1);
+
+	for(int y = 0; y < gray.rows; y++) {
+		const uchar *a = gray.ptr<uchar>(y);
+		const uchar *b = gray2.ptr<uchar>(y);
+		uchar *d = diff.ptr<uchar>(y);
+		int *energy = m_energy.ptr<int>(y / m_tileSize);
+
+		for(int tx = 0; tx < tilesX; tx++) {
+			int x = tx * m_tileSize;
+			int width = std::min(m_tileSize, gray.cols - x);
+			energy[tx] += static_cast<int>(diffRow(a + x, b + x, d + x, width));
+		}
+	}
+}
+
+/*
+* getActiveRuns
+*
+* joins the active tiles of each row of tiles into runs, so neighbouring active
+* tiles are processed together.
+*
+* preconditions:	compute must have been called
+* postconditions:	replaces runs with the rectangles, in pixels, covered by each run
+*					of tiles whose mean absolute difference per pixel is greater than
+*					meanDiff
+*/
+void TileEnergy::getActiveRuns(int meanDiff, vector<Rect> &runs) const {
+	runs.clear();
+	int threshold = meanDiff * m_tileSize * m_tileSize;
+
+	for(int ty = 0; ty < m_energy.rows; ty++) {
+		const int *energy = m_energy.ptr<int>(ty);
+		int tx = 0;
+		while(tx < m_energy.cols) {
+			if(energy[tx] <= threshold) {
+				tx++;
+				continue;
+			}
+
+			int start = tx;
+			while(tx < m_energy.cols && energy[tx] > threshold) tx++;
+
+			// clip the run to the image, the last tiles of a row or column may be smaller
+			Rect run(start * m_tileSize, ty * m_tileSize, (tx - start) * m_tileSize, m_tileSize);
+			runs.push_back(run & Rect(0, 0, m_size.width, m_size.height));
+		}
+	}
+}
+
+/*
+* diffRow
+*
+* preconditions:	a, b and diff must point to at least length pixels
+* postconditions:	sets diff to the absolute differences of a and b and returns their
+*					sum
+*/
+unsigned int TileEnergy::diffRow(const uchar *a, const uchar *b, uchar *diff, int length) {
+	int i = 0;
+	unsigned int sum = 0;
+
+#ifdef CVPONG_SSE2
+	// the saturated differences both ways round, one of which is 0, make the absolute
+	// difference. psadbw against 0 then sums each half of its 16 pixels into a 64-bit lane
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sums = _mm_setzero_si128();
+	for(; i + 16 <= length; i += 16) {
+		__m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		__m128i pd = _mm_or_si128(_mm_subs_epu8(pa, pb), _mm_subs_epu8(pb, pa));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(diff + i), pd);
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(pd, zero));
+	}
+	sum = static_cast<unsigned int>(_mm_cvtsi128_si32(sums)) +
+		  static_cast<unsigned int>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+#endif
+
+	for(; i < length; i++) {
+		diff[i] = static_cast<uchar>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+		sum += diff[i];
+	}
+	return(sum);
+}
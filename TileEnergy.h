@@ -0,0 +1,79 @@
+/*
+* TileEnergy class
+*
+* measures the motion energy of a pair of sequential grayscale images tile by tile:
+* the sum of absolute differences (SAD) of each tile, summed with SSE2 psadbw where
+* it is available while the difference image itself is written. Tiles whose energy
+* is above a threshold are active, and only the active tiles need the rest of the
+* motion detection.
+*
+*/
+#ifndef TILEENERGY_H
+#define TILEENERGY_H
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+#if !defined(CVPONG_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CVPONG_SSE2 1
+#endif
+
+const int DEFAULT_TILE_SIZE = 16;
+
+class TileEnergy {
+public:
+	/*
+	* TileEnergy constructor
+	*
+	* preconditions:	tileSize must be greater than 0
+	* postconditions:	creates a measure of tiles tileSize pixels square
+	*/
+	TileEnergy(int tileSize = DEFAULT_TILE_SIZE) : m_tileSize(tileSize) {}
+
+	/*
+	* compute
+	*
+	* preconditions:	gray and gray2 must be single channel 8-bit images of the same size
+	* postconditions:	sets diff to the absolute difference of gray and gray2 and replaces
+	*					the energy of every tile with the SAD of gray and gray2 in that
+	*					tile. tiles on the right and bottom edges may be smaller.
+	*/
+	void compute(const Mat &gray, const Mat &gray2, Mat &diff);
+
+	/*
+	* getActiveRuns
+	*
+	* joins the active tiles of each row of tiles into runs, so neighbouring active
+	* tiles are processed together.
+	*
+	* preconditions:	compute must have been called
+	* postconditions:	replaces runs with the rectangles, in pixels, covered by each run
+	*					of tiles whose mean absolute difference per pixel is greater than
+	*					meanDiff
+	*/
+	void getActiveRuns(int meanDiff, vector<Rect> &runs) const;
+
+	/*
+	* getEnergy
+	*
+	* preconditions:	compute must have been called
+	* postconditions:	returns the energy of every tile, one CV_32S value per tile
+	*/
+	const Mat &getEnergy() const {return(m_energy);}
+
+	/*
+	* diffRow
+	*
+	* preconditions:	a, b and diff must point to at least length pixels
+	* postconditions:	sets diff to the absolute differences of a and b and returns their
+	*					sum
+	*/
+	static unsigned int diffRow(const uchar *a, const uchar *b, uchar *diff, int length);
+
+private:
+	int m_tileSize;
+	Size m_size;
+	Mat m_energy;
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+* Trace class
+*
+* records timed events of the stages of the game loop and writes them out as a
+* Chrome trace
+*
+*/
+#include "Trace.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+// events reserved up front in each thread's buffer
+static const size_t INITIAL_EVENTS = 4096;
+
+/*
+* TraceEvent
+*
+* one recorded event
+*/
+struct TraceEvent {
+	const char *name;
+	double startUs;
+	double durationUs;
+	uint64_t frameId;
+};
+
+/*
+* ThreadTrace
+*
+* the events recorded by one thread. Only the thread itself adds to them, the lock
+* is only contended while the trace is written or cleared.
+*/
+struct ThreadTrace {
+	int tid;
+	const char *name;
+	std::mutex mutex;
+	vector<TraceEvent> events;
+	uint64_t dropped;
+};
+
+// the buffers of every thread which recorded, kept after their thread exits so
+// its events are still written
+static std::mutex s_threadsMutex;
+static vector<ThreadTrace *> s_threads;
+
+static thread_local ThreadTrace *t_trace = nullptr;
+static thread_local uint64_t t_frame = NO_TRACE_FRAME;
+
+/*
+* threadTrace
+*
+* preconditions:	none
+* postconditions:	returns the buffer of the calling thread, creating it on first use
+*/
+static ThreadTrace &threadTrace() {
+	if(t_trace == nullptr) {
+		ThreadTrace *trace = new ThreadTrace();
+		trace->name = nullptr;
+		trace->dropped = 0;
+		trace->events.reserve(INITIAL_EVENTS);
+
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		trace->tid = static_cast<int>(s_threads.size()) + 1;
+		s_threads.push_back(trace);
+		t_trace = trace;
+	}
+	return(*t_trace);
+}
+
+/*
+* enabled
+*
+* preconditions:	none
+* postconditions:	returns true if tracing was built in with CVPONG_TRACE
+*/
+bool Trace::enabled() {
+#ifdef CVPONG_TRACE
+	return(true);
+#else
+	return(false);
+#endif
+}
+
+/*
+* nowUs
+*
+* preconditions:	none
+* postconditions:	returns the microseconds since the first trace event, on the
+*					same clock on every thread
+*/
+double Trace::nowUs() {
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+/*
+* setFrame
+*
+* preconditions:	none
+* postconditions:	tags the events the calling thread records from now on with frameId
+*/
+void Trace::setFrame(uint64_t frameId) {
+	t_frame = frameId;
+}
+
+/*
+* getFrame
+*
+* preconditions:	none
+* postconditions:	returns the frame id the calling thread tags its events with
+*/
+uint64_t Trace::getFrame() {
+	return(t_frame);
+}
+
+/*
+* setThreadName
+*
+* preconditions:	name must be a string which outlives the program, a literal
+* postconditions:	names the calling thread in the timeline
+*/
+void Trace::setThreadName(const char *name) {
+	ThreadTrace &trace = threadTrace();
+	std::lock_guard<std::mutex> lock(trace.mutex);
+	trace.name = name;
+}
+
+/*
+* record
+*
+* preconditions:	name must be a string which outlives the program, a literal
+* postconditions:	records an event of the calling thread named name, which ran from
+*					startUs for durationUs, tagged with the frame of the thread
+*/
+void Trace::record(const char *name, double startUs, double durationUs) {
+	ThreadTrace &trace = threadTrace();
+	std::lock_guard<std::mutex> lock(trace.mutex);
+	if(trace.events.size() >= static_cast<size_t>(MAX_TRACE_EVENTS)) {
+		trace.dropped++;
+		return;
+	}
+	TraceEvent event = {name, startUs, durationUs, t_frame};
+	trace.events.push_back(event);
+}
+
+/*
+* write
+*
+* preconditions:	none
+* postconditions:	writes every event recorded so far to path as a Chrome trace and
+*					returns true, or returns false if path could not be written
+*/
+bool Trace::write(const string &path) {
+	ofstream out(path.c_str());
+	if(!out.good()) return(false);
+
+	out << fixed << setprecision(3);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+
+	std::lock_guard<std::mutex> threadsLock(s_threadsMutex);
+	for(size_t t = 0; t < s_threads.size(); t++) {
+		ThreadTrace &trace = *s_threads[t];
+		std::lock_guard<std::mutex> lock(trace.mutex);
+
+		// name the thread's row of the timeline
+		out << (first ? "" : ",") << "\n";
+		out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << trace.tid;
+		out << ", \"args\": {\"name\": \"" << (trace.name != nullptr ? trace.name : "thread");
+		out << " " << trace.tid << "\"}}";
+		first = false;
+
+		// complete events, which carry their own duration
+		for(size_t i = 0; i < trace.events.size(); i++) {
+			const TraceEvent &event = trace.events[i];
+			out << ",\n{\"ph\": \"X\", \"cat\": \"cvpong\", \"name\": \"" << event.name << "\"";
+			out << ", \"pid\": 1, \"tid\": " << trace.tid;
+			out << ", \"ts\": " << event.startUs << ", \"dur\": " << event.durationUs;
+			if(event.frameId != NO_TRACE_FRAME) {
+				out << ", \"args\": {\"frame\": " << event.frameId << "}";
+			}
+			out << "}";
+		}
+
+		if(trace.dropped > 0) {
+			out << ",\n{\"ph\": \"i\", \"s\": \"t\", \"name\": \"dropped " << trace.dropped << " events\"";
+			out << ", \"pid\": 1, \"tid\": " << trace.tid << ", \"ts\": " << nowUs() << "}";
+		}
+	}
+
+	out << "\n]}" << endl;
+	return(out.good());
+}
+
+/*
+* clear
+*
+* preconditions:	none
+* postconditions:	forgets every event recorded so far
+*/
+void Trace::clear() {
+	std::lock_guard<std::mutex> threadsLock(s_threadsMutex);
+	for(size_t t = 0; t < s_threads.size(); t++) {
+		std::lock_guard<std::mutex> lock(s_threads[t]->mutex);
+		s_threads[t]->events.clear();
+		s_threads[t]->dropped = 0;
+	}
+}
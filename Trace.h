@@ -0,0 +1,138 @@
+/*
+* Trace class
+*
+* records timed events of the stages of the game loop, tagged with the frame they
+* worked on and the thread they ran on, and writes them out as a Chrome trace which
+* chrome://tracing and Perfetto display as a timeline per thread. Tracing is only
+* built in with CVPONG_TRACE defined. Without it the TRACE_SCOPE macro compiles to
+* nothing and nothing is recorded.
+*
+* Each thread records into its own buffer, so recording an event takes no lock
+* which another thread holds for long.
+*
+*/
+#ifndef TRACE_H
+#define TRACE_H
+#include <string>
+#include <stdint.h>
+
+using namespace std;
+
+// events recorded per thread before further events are dropped
+const int MAX_TRACE_EVENTS = 1 << 18;
+// the frame id of events recorded outside of any frame
+const uint64_t NO_TRACE_FRAME = ~static_cast<uint64_t>(0);
+
+class Trace {
+public:
+	/*
+	* enabled
+	*
+	* preconditions:	none
+	* postconditions:	returns true if tracing was built in with CVPONG_TRACE
+	*/
+	static bool enabled();
+
+	/*
+	* nowUs
+	*
+	* preconditions:	none
+	* postconditions:	returns the microseconds since the first trace event, on the
+	*					same clock on every thread
+	*/
+	static double nowUs();
+
+	/*
+	* setFrame
+	*
+	* preconditions:	none
+	* postconditions:	tags the events the calling thread records from now on with frameId
+	*/
+	static void setFrame(uint64_t frameId);
+
+	/*
+	* getFrame
+	*
+	* preconditions:	none
+	* postconditions:	returns the frame id the calling thread tags its events with
+	*/
+	static uint64_t getFrame();
+
+	/*
+	* setThreadName
+	*
+	* preconditions:	name must be a string which outlives the program, a literal
+	* postconditions:	names the calling thread in the timeline
+	*/
+	static void setThreadName(const char *name);
+
+	/*
+	* record
+	*
+	* preconditions:	name must be a string which outlives the program, a literal
+	* postconditions:	records an event of the calling thread named name, which ran from
+	*					startUs for durationUs, tagged with the frame of the thread
+	*/
+	static void record(const char *name, double startUs, double durationUs);
+
+	/*
+	* write
+	*
+	* preconditions:	none
+	* postconditions:	writes every event recorded so far to path as a Chrome trace and
+	*					returns true, or returns false if path could not be written
+	*/
+	static bool write(const string &path);
+
+	/*
+	* clear
+	*
+	* preconditions:	none
+	* postconditions:	forgets every event recorded so far
+	*/
+	static void clear();
+};
+
+/*
+* TraceScope class
+*
+* records an event from its construction to its destruction
+*
+*/
+class TraceScope {
+public:
+	/*
+	* TraceScope constructor
+	*
+	* preconditions:	name must be a string which outlives the program, a literal
+	* postconditions:	starts timing the event
+	*/
+	explicit TraceScope(const char *name) : m_name(name), m_startUs(Trace::nowUs()) {}
+
+	/*
+	* TraceScope destructor
+	*
+	* preconditions:	none
+	* postconditions:	records the event
+	*/
+	~TraceScope() {Trace::record(m_name, m_startUs, Trace::nowUs() - m_startUs);}
+
+private:
+	TraceScope(const TraceScope &);
+	TraceScope &operator=(const TraceScope &);
+
+	const char *m_name;
+	double m_startUs;
+};
+
+#define TRACE_SCOPE_CONCAT2(a, b) a##b
+#define TRACE_SCOPE_CONCAT(a, b) TRACE_SCOPE_CONCAT2(a, b)
+
+#ifdef CVPONG_TRACE
+// records an event from here to the end of the enclosing block
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "GameBoard.h"
+#include "MotionPaddleDetector.h"
+#include "ColorPaddleDetector.h"
+#include "HybridPaddleDetector.h"
+#include "OpticalFlowPaddleDetector.h"
+#include "PlayerStreams.h"
+#include "Trace.h"
+using namespace std;
+
+// where the timeline of the game is written in a build with CVPONG_TRACE defined
+const string TRACE_FILE = "cvpong.versus.trace.json";
+
+/*
+* main
+*
+* plays a game of cvpong with a frame source for each player rather than one camera
+* split down the middle. A source is a camera index, a video file or a raw frame
+* file, so a game can be played on two cameras or replayed from two recordings.
+* Each player is detected on their own thread, by the same kind of detector
+* tracking the whole of their frame, and the board shows the two players side by
+* side. A replay keeps the pace of its recordings and waits for every detection, so
+* the same recordings always play the same game. Color tracking needs a profile
+* calibrated by playing first.
+*
+* usage: versus <move|color|hybrid|flow> <left source> <right source> [profile]
+*
+*/
+int main(int argc, char *argv[]) {
+	if(argc < 4) {
+		cout << "usage: versus <move|color|hybrid|flow> <left source> <right source> [profile]" << endl;
+		return(-1);
+	}
+
+	string tracking = argv[1];
+	string profile = argc > 4 ? argv[4] : "default";
+
+	// the detectors only see the frames they are given, there is no camera to calibrate on
+	bool color = tracking == CPD_FLAG || tracking == HPD_FLAG;
+	if(color && !ifstream((profile + PROFILE_EXTENSION).c_str()).good()) {
+		cout << "No color profile \"" << profile << "\", calibrate it by playing first." << endl;
+		return(-1);
+	}
+
+	VideoCapture noCapture;
+	PaddleDetector *prototype;
+	if(tracking == CPD_FLAG) {
+		prototype = new ColorPaddleDetector(&noCapture, profile);
+	} else if(tracking == HPD_FLAG) {
+		prototype = new HybridPaddleDetector(&noCapture, profile);
+	} else if(tracking == OFPD_FLAG) {
+		prototype = new OpticalFlowPaddleDetector();
+	} else {
+		prototype = new MotionPaddleDetector();
+	}
+
+	PlayerStreams players(argv[2], argv[3], *prototype);
+	delete prototype;
+	if(!players.isOpen()) {
+		cout << "Could not open " << argv[2] << " and " << argv[3] << " for " << tracking << " tracking." << endl;
+		return(-1);
+	}
+
+	Presenter *presenter = createPresenter("cvpong");
+	GameBoard pong(presenter);
+
+	Trace::setThreadName("game");
+	while(pong.gameOn()) {
+		uint64_t tick = pong.getTick();
+		Trace::setFrame(tick);
+		if(!players.capture(tick)) break;
+
+		// the detections of earlier ticks which came in while capturing
+		players.apply(pong);
+		{
+			TRACE_SCOPE("play");
+			pong.advance();
+			pong.render(players.background());
+		}
+
+		int key = presenter->pollKey();
+		if(key == 27) { break; } // If 'esc' key is pressed we'll quit
+	}
+
+	if(Trace::enabled() && Trace::write(TRACE_FILE)) {
+		cout << "Wrote the timeline of the game to " << TRACE_FILE << endl;
+	}
+
+	// hold window until key press
+	presenter->pollKey(-1);
+	delete presenter;
+	return(0);
+}
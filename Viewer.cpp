@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "StateBroadcast.h"
+using namespace std;
+
+/*
+* render
+*
+* preconditions:	board must be a DEFAULT_Y by DEFAULT_X CV_8UC3 image
+* postconditions:	draws the ball, paddles and score of state on a black board
+*/
+void render(Mat &board, const GameState &state) {
+	// the score is only rendered again when it changes, as on the gameboard
+	static int scoreShown[2] = {-1, -1};
+	static Mat scoreMask;
+	static Rect scoreRect;
+
+	board.setTo(Scalar(0, 0, 0));
+
+	// the paddles sit at the same columns as on the gameboard. the state may put the
+	// ball partly off the board, which GameBoard::fillRect does not allow
+	Rect bounds(0, 0, board.cols, board.rows);
+	int leftX = BOARDER_WIDTH * 2;
+	int rightX = DEFAULT_X - PADDLE_X - (BOARDER_WIDTH * 2) - 1;
+	GameBoard::fillRect(board, Rect(leftX, state.leftPaddleY, PADDLE_X, PADDLE_Y) & bounds, L_PADDLE_COLOR);
+	GameBoard::fillRect(board, Rect(rightX, state.rightPaddleY, PADDLE_X, PADDLE_Y) & bounds, R_PADDLE_COLOR);
+	GameBoard::fillRect(board, Rect(state.ballX, state.ballY, BALL_SIZE, BALL_SIZE) & bounds, BALL_COLOR);
+
+	if(state.score[0] != scoreShown[0] || state.score[1] != scoreShown[1]) {
+		scoreShown[0] = state.score[0];
+		scoreShown[1] = state.score[1];
+		GameBoard::renderScore(scoreShown, scoreMask, scoreRect);
+	}
+	GameBoard::blendScore(board, scoreMask, scoreRect);
+}
+
+/*
+* main
+*
+* a lightweight spectator view of a game of cvpong. It renders the game from the
+* state packets broadcast by the game instead of mirroring the game's video.
+*
+* usage: viewer [port]
+*
+*/
+int main(int argc, char *argv[]) {
+	int port = argc > 1 ? atoi(argv[1]) : DEFAULT_BROADCAST_PORT;
+
+	StateReceiver receiver(port);
+	if(!receiver.isOpen()) {
+		cout << "Could not listen on port " << port << endl;
+		return(-1);
+	}
+	cout << "Watching cvpong on port " << port << " ... press esc to quit" << endl;
+
+	Mat board = Mat::zeros(DEFAULT_Y, DEFAULT_X, CV_8UC3);
+	GameState state;
+	Presenter *presenter = createPresenter("cvpong spectator");
+
+	while(true) {
+		// only redraw when a new state arrived, keep the window responsive otherwise
+		if(receiver.receive(state, 30)) {
+			render(board, state);
+			presenter->present(board);
+		}
+		int key = presenter->pollKey();
+		if(key == 27) { break; } // If 'esc' key is pressed we'll quit
+	}
+	delete presenter;
+	return(0);
+}
@@ -0,0 +1,304 @@
+/*
+* X11ShmPresenter class
+*
+* a presenter which shows the gameboard through the X11 MIT shared memory
+* extension. The frame is converted once, straight into an image shared with the X
+* server, which then reads it from there without the frame being sent over the
+* connection. Events are pumped without waiting, so presenting never sleeps.
+*
+*/
+#ifdef CVPONG_X11
+#include <sys/ipc.h>
+#include <sys/select.h>
+#include <sys/shm.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "X11ShmPresenter.h"
+
+static const int ESC_KEY = 27;
+
+// set by trapAttachError when the X server refuses to attach to a shared segment
+static bool s_attachFailed = false;
+
+/*
+* trapAttachError
+*
+* Xlib's default error handler ends the process. A display which can not reach our
+* shared memory, such as one on another machine, fails XShmAttach asynchronously,
+* so the error is trapped while attaching instead.
+*/
+static int trapAttachError(Display *, XErrorEvent *) {
+	s_attachFailed = true;
+	return(0);
+}
+
+/*
+* X11ShmPresenter constructor
+*
+* preconditions:	none
+* postconditions:	connects to the display named by DISPLAY. isOpen() is false if
+*					there is no display, it does not support shared memory images, it
+*					can not attach to our shared memory (a display on another machine)
+*					or it is not a 24-bit true color display.
+*/
+X11ShmPresenter::X11ShmPresenter(const string &title) {
+	m_title = title;
+	m_window = 0;
+	m_gc = 0;
+	m_image = nullptr;
+	m_pending = false;
+	m_shm.shmaddr = nullptr;
+
+	m_display = XOpenDisplay(NULL);
+	if(m_display == nullptr) return;
+
+	// frames are converted to BGRX, which is the pixel layout of 24-bit true color
+	int screen = DefaultScreen(m_display);
+	Visual *visual = DefaultVisual(m_display, screen);
+	if(!XShmQueryExtension(m_display) || DefaultDepth(m_display, screen) != 24 ||
+	   visual->red_mask != 0xFF0000 || visual->green_mask != 0xFF00 || visual->blue_mask != 0xFF) {
+		XCloseDisplay(m_display);
+		m_display = nullptr;
+		return;
+	}
+
+	// the extension is reported over remote connections too, only attaching a
+	// segment shows whether the X server can reach our memory
+	XShmSegmentInfo probeShm;
+	XImage *probe = XShmCreateImage(m_display, visual, 24, ZPixmap, NULL, &probeShm, 1, 1);
+	bool attached = probe != nullptr && attachShared(probe, probeShm);
+	if(attached) {
+		XShmDetach(m_display, &probeShm);
+		XSync(m_display, False);
+		shmdt(probeShm.shmaddr);
+	}
+	if(probe != nullptr) {
+		probe->data = nullptr;
+		XDestroyImage(probe);
+	}
+	if(!attached) {
+		XCloseDisplay(m_display);
+		m_display = nullptr;
+		return;
+	}
+
+	m_completionType = XShmGetEventBase(m_display) + ShmCompletion;
+	m_deleteWindow = XInternAtom(m_display, "WM_DELETE_WINDOW", False);
+}
+
+/*
+* X11ShmPresenter destructor
+*
+* preconditions:	none
+* postconditions:	frees the shared image, closes the window and disconnects
+*/
+X11ShmPresenter::~X11ShmPresenter() {
+	if(m_display == nullptr) return;
+
+	destroyImage();
+	if(m_window != 0) {
+		XFreeGC(m_display, m_gc);
+		XDestroyWindow(m_display, m_window);
+	}
+	XCloseDisplay(m_display);
+}
+
+/*
+* present
+*
+* preconditions:	isOpen() must be true. frame must be a BGR image.
+* postconditions:	converts frame into the shared image and asks the X server to
+*					show it. the window is created, or resized, to the size of frame.
+*/
+void X11ShmPresenter::present(const Mat &frame) {
+	if(m_image == nullptr || m_image->width != frame.cols || m_image->height != frame.rows) {
+		if(!createImage(frame.cols, frame.rows)) return;
+	}
+
+	// the X server may still be reading the last frame out of the shared image
+	waitForCompletion();
+
+	// the only copy of the frame: straight into the memory the X server reads. The
+	// gameboard is drawn over the BGR camera frame, so handing the game this BGRX
+	// image to draw into would only move the conversion, not save it, while every
+	// drawing routine would have to learn the four channel layout
+	Mat target(frame.rows, frame.cols, CV_8UC4, m_image->data, m_image->bytes_per_line);
+	cvtColor(frame, target, COLOR_BGR2BGRA);
+
+	XShmPutImage(m_display, m_window, m_gc, m_image, 0, 0, 0, 0, frame.cols, frame.rows, True);
+	XFlush(m_display);
+	m_pending = true;
+}
+
+/*
+* pollKey
+*
+* preconditions:	isOpen() must be true
+* postconditions:	handles the window's pending events and returns the key pressed,
+*					or -1 if none was. waits up to waitMs for a key, 0 does not wait
+*					and a negative waitMs waits until a key is pressed. closing the
+*					window counts as pressing esc.
+*/
+int X11ShmPresenter::pollKey(int waitMs) {
+	bool waited = false;
+
+	while(true) {
+		while(XPending(m_display) > 0) {
+			XEvent event;
+			XNextEvent(m_display, &event);
+			handleEvent(event);
+		}
+
+		if(!m_keys.empty()) {
+			int key = m_keys.front();
+			m_keys.pop_front();
+			return(key);
+		}
+		if(waitMs == 0 || (waited && waitMs > 0)) return(-1);
+
+		// sleep on the connection until the X server sends something or time runs out
+		int fd = ConnectionNumber(m_display);
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+		timeval timeout;
+		timeout.tv_sec = waitMs / 1000;
+		timeout.tv_usec = (waitMs % 1000) * 1000;
+		select(fd + 1, &fds, NULL, NULL, waitMs < 0 ? NULL : &timeout);
+		waited = true;
+	}
+}
+
+/*
+* createImage
+*
+* preconditions:	cols and rows must be greater than 0
+* postconditions:	creates the window if there is none yet and sizes it to cols by rows,
+*					then replaces the shared image with one of cols by rows. returns
+*					false if the shared memory could not be created.
+*/
+bool X11ShmPresenter::createImage(int cols, int rows) {
+	int screen = DefaultScreen(m_display);
+
+	if(m_window == 0) {
+		m_window = XCreateSimpleWindow(m_display, RootWindow(m_display, screen), 0, 0, cols, rows, 0,
+									   BlackPixel(m_display, screen), BlackPixel(m_display, screen));
+		XStoreName(m_display, m_window, m_title.c_str());
+		XSelectInput(m_display, m_window, KeyPressMask | StructureNotifyMask);
+		XSetWMProtocols(m_display, m_window, &m_deleteWindow, 1);
+		m_gc = XCreateGC(m_display, m_window, 0, NULL);
+		XMapWindow(m_display, m_window);
+	} else {
+		XResizeWindow(m_display, m_window, cols, rows);
+	}
+
+	destroyImage();
+
+	m_image = XShmCreateImage(m_display, DefaultVisual(m_display, screen), 24, ZPixmap, NULL,
+							  &m_shm, cols, rows);
+	if(m_image == nullptr) return(false);
+
+	if(!attachShared(m_image, m_shm)) {
+		m_image->data = nullptr;
+		XDestroyImage(m_image);
+		m_image = nullptr;
+		return(false);
+	}
+	return(true);
+}
+
+/*
+* attachShared
+*
+* preconditions:	image must have been created by XShmCreateImage with shm
+* postconditions:	creates the shared memory of image and attaches the X server to
+*					it. returns false, with nothing left attached or allocated, if the
+*					memory could not be created or the X server could not attach.
+*/
+bool X11ShmPresenter::attachShared(XImage *image, XShmSegmentInfo &shm) {
+	shm.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+	if(shm.shmid < 0) return(false);
+
+	void *address = shmat(shm.shmid, NULL, 0);
+	if(address == reinterpret_cast<void *>(-1)) {
+		shmctl(shm.shmid, IPC_RMID, NULL);
+		return(false);
+	}
+	shm.shmaddr = image->data = static_cast<char *>(address);
+	shm.readOnly = False;
+
+	// the errors of earlier requests are not ours to trap, flush them first
+	XSync(m_display, False);
+	s_attachFailed = false;
+	XErrorHandler previous = XSetErrorHandler(trapAttachError);
+	Status status = XShmAttach(m_display, &shm);
+	XSync(m_display, False);
+	XSetErrorHandler(previous);
+
+	// the segment is freed once both we and the X server have detached from it,
+	// even if the game crashes
+	shmctl(shm.shmid, IPC_RMID, NULL);
+
+	if(!status || s_attachFailed) {
+		shmdt(address);
+		shm.shmaddr = image->data = nullptr;
+		return(false);
+	}
+	return(true);
+}
+
+/*
+* destroyImage
+*
+* preconditions:	none
+* postconditions:	detaches and frees the shared image if there is one
+*/
+void X11ShmPresenter::destroyImage() {
+	if(m_image == nullptr) return;
+
+	waitForCompletion();
+	XShmDetach(m_display, &m_shm);
+	XSync(m_display, False);
+	XDestroyImage(m_image);
+	shmdt(m_shm.shmaddr);
+	m_image = nullptr;
+	m_shm.shmaddr = nullptr;
+}
+
+/*
+* waitForCompletion
+*
+* preconditions:	none
+* postconditions:	returns once the X server has finished reading the shared image.
+*					keys pressed meanwhile are kept for pollKey.
+*/
+void X11ShmPresenter::waitForCompletion() {
+	while(m_pending) {
+		XEvent event;
+		XNextEvent(m_display, &event);
+		handleEvent(event);
+	}
+}
+
+/*
+* handleEvent
+*
+* preconditions:	none
+* postconditions:	queues the key of a key press or esc for a closed window, and marks
+*					the shared image free when the X server has finished reading it
+*/
+void X11ShmPresenter::handleEvent(XEvent &event) {
+	if(event.type == m_completionType) {
+		m_pending = false;
+	} else if(event.type == KeyPress) {
+		char text[8];
+		KeySym sym;
+		if(XLookupString(&event.xkey, text, sizeof(text), &sym, NULL) > 0) {
+			m_keys.push_back(static_cast<unsigned char>(text[0]));
+		}
+	} else if(event.type == ClientMessage &&
+			  static_cast<Atom>(event.xclient.data.l[0]) == m_deleteWindow) {
+		m_keys.push_back(ESC_KEY);
+	}
+}
+
+#endif
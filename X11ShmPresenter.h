@@ -0,0 +1,87 @@
+/*
+* X11ShmPresenter class
+*
+* a presenter which shows the gameboard through the X11 MIT shared memory
+* extension. The frame is converted once, straight into an image shared with the X
+* server, which then reads it from there without the frame being sent over the
+* connection. Events are pumped without waiting, so presenting never sleeps.
+*
+* Only built with CVPONG_X11 defined, linking against libX11 and libXext.
+*
+*/
+#ifndef X11SHMPRESENTER_H
+#define X11SHMPRESENTER_H
+#ifdef CVPONG_X11
+#include <deque>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include "Presenter.h"
+
+class X11ShmPresenter : public Presenter {
+public:
+	/*
+	* X11ShmPresenter constructor
+	*
+	* preconditions:	none
+	* postconditions:	connects to the display named by DISPLAY. isOpen() is false if
+	*					there is no display, it does not support shared memory images, it
+	*					can not attach to our shared memory (a display on another machine)
+	*					or it is not a 24-bit true color display.
+	*/
+	X11ShmPresenter(const string &title);
+
+	/*
+	* X11ShmPresenter destructor
+	*
+	* preconditions:	none
+	* postconditions:	frees the shared image, closes the window and disconnects
+	*/
+	~X11ShmPresenter();
+
+	bool isOpen() const {return(m_display != nullptr);}
+
+	/*
+	* present
+	*
+	* preconditions:	isOpen() must be true. frame must be a BGR image.
+	* postconditions:	converts frame into the shared image and asks the X server to
+	*					show it. the window is created, or resized, to the size of frame.
+	*/
+	void present(const Mat &frame);
+
+	/*
+	* pollKey
+	*
+	* preconditions:	isOpen() must be true
+	* postconditions:	handles the window's pending events and returns the key pressed,
+	*					or -1 if none was. waits up to waitMs for a key, 0 does not wait
+	*					and a negative waitMs waits until a key is pressed. closing the
+	*					window counts as pressing esc.
+	*/
+	int pollKey(int waitMs = 0);
+
+private:
+	X11ShmPresenter(const X11ShmPresenter &);
+	X11ShmPresenter &operator=(const X11ShmPresenter &);
+
+	bool createImage(int cols, int rows);
+	bool attachShared(XImage *image, XShmSegmentInfo &shm);
+	void destroyImage();
+	void waitForCompletion();
+	void handleEvent(XEvent &event);
+
+	string m_title;
+	Display *m_display;
+	Window m_window;
+	GC m_gc;
+	Atom m_deleteWindow;
+	int m_completionType;
+	XImage *m_image;
+	XShmSegmentInfo m_shm;
+	bool m_pending;		// the X server may still be reading the shared image
+	deque<int> m_keys;
+};
+
+#endif
+#endif
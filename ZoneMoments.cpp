@@ -0,0 +1,142 @@
+/*
+* ZoneMoments class
+*
+* accumulates the area and first order moments (m00, m10, m01) of any number of
+* zones of a mask in a single pass over the mask. Only the three sums the detectors
+* use are computed, and the rows are summed with SSE2 where it is available.
+*
+*/
+#include "ZoneMoments.h"
+#ifdef CVPONG_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+* setZones
+*
+* preconditions:	none
+* postconditions:	the moments of each rectangle in zones are accumulated from now on.
+*					zones which overlap are each accumulated in full.
+*/
+void ZoneMoments::setZones(const vector<Rect> &zones) {
+	m_zones = zones;
+	m_moments.resize(zones.size());
+}
+
+/*
+* accumulate
+*
+* preconditions:	mask must be a single channel 8-bit image containing every zone
+* postconditions:	replaces the moments of every zone with those of mask
+*/
+void ZoneMoments::accumulate(const Mat &mask) {
+	for(size_t z = 0; z < m_moments.size(); z++) {
+		m_moments[z].m00 = 0;
+		m_moments[z].m10 = 0;
+		m_moments[z].m01 = 0;
+	}
+
+	// walk the mask once, row by row, adding each row to the zones it crosses
+	for(int y = 0; y < mask.rows; y++) {
+		const uchar *row = mask.ptr<uchar>(y);
+		for(size_t z = 0; z < m_zones.size(); z++) {
+			const Rect &zone = m_zones[z];
+			if(y < zone.y || y >= zone.y + zone.height) continue;
+
+			uint64 sum, sumX;
+			sumRow(row + zone.x, zone.width, sum, sumX);
+
+			m_moments[z].m00 += static_cast<double>(sum);
+			m_moments[z].m10 += static_cast<double>(sumX);
+			m_moments[z].m01 += static_cast<double>(sum) * (y - zone.y);
+		}
+	}
+}
+
+/*
+* accumulate
+*
+* preconditions:	mask must contain every zone
+* postconditions:	replaces the moments of every zone with those of mask, weighing
+*					each pixel set as 255 like the 8-bit masks
+*/
+void ZoneMoments::accumulate(const BitMask &mask) {
+	for(size_t z = 0; z < m_moments.size(); z++) {
+		m_moments[z].m00 = 0;
+		m_moments[z].m10 = 0;
+		m_moments[z].m01 = 0;
+	}
+
+	for(int y = 0; y < mask.rows(); y++) {
+		for(size_t z = 0; z < m_zones.size(); z++) {
+			const Rect &zone = m_zones[z];
+			if(y < zone.y || y >= zone.y + zone.height) continue;
+
+			uint64 count, sumX;
+			mask.sumRow(y, zone.x, zone.width, count, sumX);
+
+			m_moments[z].m00 += 255.0 * count;
+			m_moments[z].m10 += 255.0 * sumX;
+			m_moments[z].m01 += 255.0 * count * (y - zone.y);
+		}
+	}
+}
+
+/*
+* sumRow
+*
+* preconditions:	row must point to at least length pixels
+* postconditions:	returns the sum of the pixels in sum and the sum of each pixel
+*					weighed by its index in sumX
+*/
+void ZoneMoments::sumRow(const uchar *row, int length, uint64 &sum, uint64 &sumX) {
+	int i = 0;
+	sum = 0;
+	sumX = 0;
+
+#ifdef CVPONG_SSE2
+	// each block of 16 pixels is summed with psadbw and weighed by its index in the
+	// block (0 - 15) with pmaddwd. The offset of the block in the row is added from
+	// the running block sums: summing the running sum after every block counts each
+	// block once for every block after it, which gives the blocks' weights backwards.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i weightsLo = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m128i weightsHi = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i running = zero;
+	__m128i runningSums = zero;
+	__m128i weighted = zero;
+	int blocks = length / 16;
+
+	for(int b = 0; b < blocks; b++) {
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + b * 16));
+		running = _mm_add_epi64(running, _mm_sad_epu8(pixels, zero));
+		runningSums = _mm_add_epi64(runningSums, running);
+
+		__m128i lo = _mm_unpacklo_epi8(pixels, zero);
+		__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+		weighted = _mm_add_epi32(weighted, _mm_add_epi32(_mm_madd_epi16(lo, weightsLo),
+														 _mm_madd_epi16(hi, weightsHi)));
+	}
+
+	uint64 lanes64[2];
+	unsigned int lanes32[4];
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes64), running);
+	uint64 blockSum = lanes64[0] + lanes64[1];
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes64), runningSums);
+	uint64 blockRunningSum = lanes64[0] + lanes64[1];
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes32), weighted);
+	uint64 inBlock = static_cast<uint64>(lanes32[0]) + lanes32[1] + lanes32[2] + lanes32[3];
+
+	sum = blockSum;
+	sumX = 16 * (blocks * blockSum - blockRunningSum) + inBlock;
+	i = blocks * 16;
+#endif
+
+	for(; i < length; i++) {
+		sum += row[i];
+		sumX += static_cast<uint64>(row[i]) * i;
+	}
+}
@@ -0,0 +1,99 @@
+/*
+* ZoneMoments class
+*
+* accumulates the area and first order moments (m00, m10, m01) of any number of
+* zones of a mask in a single pass over the mask. Only the three sums the detectors
+* use are computed, and the rows are summed with SSE2 where it is available.
+*
+*/
+#ifndef ZONEMOMENTS_H
+#define ZONEMOMENTS_H
+#include <opencv2/core/core.hpp>
+#include "BitMask.h"
+
+using namespace cv;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CVPONG_SSE2 1
+#endif
+
+/*
+* ZoneMoment
+*
+* the moments of one zone, in the same units as the Moments returned by moments()
+* on the zone: every pixel is weighed by its value and x and y are measured from
+* the top left corner of the zone.
+*/
+struct ZoneMoment {
+	double m00;
+	double m10;
+	double m01;
+};
+
+class ZoneMoments {
+public:
+	/*
+	* ZoneMoments default constructor
+	*
+	* preconditions:	none
+	* postconditions:	creates an accumulator with no zones
+	*/
+	ZoneMoments() {}
+
+	/*
+	* setZones
+	*
+	* preconditions:	none
+	* postconditions:	the moments of each rectangle in zones are accumulated from now on.
+	*					zones which overlap are each accumulated in full.
+	*/
+	void setZones(const vector<Rect> &zones);
+
+	/*
+	* getZones
+	*
+	* preconditions:	none
+	* postconditions:	returns the zones being accumulated
+	*/
+	const vector<Rect> &getZones() const {return(m_zones);}
+
+	/*
+	* accumulate
+	*
+	* preconditions:	mask must be a single channel 8-bit image containing every zone
+	* postconditions:	replaces the moments of every zone with those of mask
+	*/
+	void accumulate(const Mat &mask);
+
+	/*
+	* accumulate
+	*
+	* preconditions:	mask must contain every zone
+	* postconditions:	replaces the moments of every zone with those of mask, weighing
+	*					each pixel set as 255 like the 8-bit masks
+	*/
+	void accumulate(const BitMask &mask);
+
+	/*
+	* getMoment
+	*
+	* preconditions:	zone must be the index of a zone
+	* postconditions:	returns the moments of zone from the last accumulate()
+	*/
+	const ZoneMoment &getMoment(int zone) const {return(m_moments[zone]);}
+
+	/*
+	* sumRow
+	*
+	* preconditions:	row must point to at least length pixels
+	* postconditions:	returns the sum of the pixels in sum and the sum of each pixel
+	*					weighed by its index in sumX
+	*/
+	static void sumRow(const uchar *row, int length, uint64 &sum, uint64 &sumX);
+
+private:
+	vector<Rect> m_zones;
+	vector<ZoneMoment> m_moments;
+};
+
+#endif